@@ -33,6 +33,15 @@ public class BeatTracker : MonoBehaviour {
 	[DllImport("AudioPlugin_LoopbackAudioSource")]
 	public extern static int GetWindowSize();
 
+	[DllImport("AudioPlugin_LoopbackAudioSource")]
+	public extern static int GetFeatureHistory(int feature, float seconds, int width, float[] minimum, float[] maximum, float[] mean);
+
+	// 履歴を何秒分、何列で描くか
+	public float historySeconds = 60.0f;
+	public int historyWidth = 400;
+	private float[] historyMinimum;
+	private float[] historyMaximum;
+
 	// Use this for initialization
 	void Start () {
 		// Initializeは複数回呼んでもかまわない
@@ -93,25 +102,32 @@ public class BeatTracker : MonoBehaviour {
 			}
 		}
 
-		var window_size = GetWindowSize();
-		for (var i = 0; i < window_size - 1; ++i) {
-			// Draw VU amplitude history
-			Debug.DrawLine(
-				new Vector3(i / 120.0f, GetBPMVU(window_size - 1 - i) * 10.0f + 2.0f, 0),
-				new Vector3((i + 1) / 120.0f, GetBPMVU(window_size - 1 - (i + 1)) * 10.0f + 2.0f, 0),
-				Color.green);
-
-			// Draw RMS
-			Debug.DrawLine(
-				new Vector3(i / 120.0f, GetRMS(window_size - 1 - i) * 10.0f + 6.0f, 0),
-				new Vector3((i + 1) / 120.0f, GetRMS(window_size - 1 - (i + 1)) * 10.0f + 6.0f, 0),
-				Color.magenta);
+		// VUとRMSの履歴を表示幅にまとめて取得し、列毎の最小から最大までを描く
+		if (historyMinimum == null || historyMinimum.Length != historyWidth) {
+			historyMinimum = new float[historyWidth];
+			historyMaximum = new float[historyWidth];
 		}
+		DrawHistory(0, 2.0f, Color.green);
+		DrawHistory(1, 6.0f, Color.magenta);
 
 		GetComponent<Text>().text += "Next Beat: " + GetMillisecondsToNextBeat().ToString("N3") + " ms\n";
 #endif
 	}
 
+	void DrawHistory(int feature, float offset, Color color)
+	{
+		var valid = GetFeatureHistory(feature, historySeconds, historyWidth, historyMinimum, historyMaximum, null);
+		var scale = 2000.0f / 120.0f / historyWidth;
+		for (var i = historyWidth - valid; i < historyWidth; ++i) {
+			// 新しい列が左に来るよう反転する
+			var x = (historyWidth - 1 - i) * scale;
+			Debug.DrawLine(
+				new Vector3(x, historyMinimum[i] * 10.0f + offset, 0),
+				new Vector3(x, historyMaximum[i] * 10.0f + offset, 0),
+				color);
+		}
+	}
+
 	IEnumerator BeatPulser()
 	{
 		for (;;) {
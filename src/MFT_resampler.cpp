@@ -11,13 +11,35 @@
 #pragma comment(lib, "mfuuid")
 #pragma comment(lib, "wmcodecdspuuid")
 
+namespace
+{
+const int half_filter_lengths[MFT_resampler::num_quality_tiers] = { 60, 32, 16, 8 };
+}
+
+int MFT_resampler::get_half_filter_length(int quality_tier)
+{
+  return half_filter_lengths[quality_tier < 0 ? 0 : quality_tier >= num_quality_tiers ? num_quality_tiers - 1 : quality_tier];
+}
+
+int MFT_resampler::get_delay_frames(int quality_tier, int input_sampling_rate, int output_sampling_rate)
+{
+  // ш͒Ⴂ̃[gŐ؂̂ŁAtB^̎Ԓ̃[gŌ܂
+  const int lower_rate = input_sampling_rate < output_sampling_rate ? input_sampling_rate : output_sampling_rate;
+  if (lower_rate <= 0) {
+    return 0;
+  }
+  return (get_half_filter_length(quality_tier) * output_sampling_rate + lower_rate / 2) / lower_rate;
+}
+
 MFT_resampler::MFT_resampler(
   int block_align,
   int channel_mask,
   int input_bytes_per_sec,
   int input_sampling_rate,
-  int output_sampling_rate
+  int output_sampling_rate,
+  int quality_tier
 )
+  : quality_tier(quality_tier < 0 ? 0 : quality_tier >= num_quality_tiers ? num_quality_tiers - 1 : quality_tier)
 {
   auto hr = MFStartup(MF_VERSION, MFSTARTUP_NOSOCKET);
   if (FAILED(hr)) {
@@ -39,8 +61,8 @@ MFT_resampler::MFT_resampler(
     throw std::runtime_error("Failed to get property store of Audio Resampler DSP.");
   }
 
-  // Tvōiɐݒ
-  hr = properties->SetHalfFilterLength(60);
+  // i0ōiBׂԂ͒ZtB^Ōy
+  hr = properties->SetHalfFilterLength(get_half_filter_length(this->quality_tier));
   if (FAILED(hr)) {
     throw std::runtime_error("Failed to set quality of Audio Resampler DSP.");
   }
@@ -141,6 +163,21 @@ MFT_resampler::MFT_resampler(
   }
 
   hr = MFCreateMemoryBuffer(1024 * 10, &input_media_buffer);
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to create media buffer.");
+  }
+
+  // pPbgMFCreateSampleȂ悤A̓Tvg񂷁B
+  // read_bufferŏo͂f؂Ă玟̂ŁAMFTO̓͂ێĂ邱Ƃ͂Ȃ
+  hr = MFCreateSample(&input_sample);
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to create MF sample.");
+  }
+
+  hr = input_sample->AddBuffer(input_media_buffer.Get());
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to add buffer to MF sample.");
+  }
 }
 
 MFT_resampler::~MFT_resampler()
@@ -148,6 +185,11 @@ MFT_resampler::~MFT_resampler()
   MFShutdown();
 }
 
+int MFT_resampler::get_quality_tier()
+{
+  return quality_tier;
+}
+
 void MFT_resampler::write_buffer(BYTE * buffer, DWORD byte_length)
 {
   BYTE *media_buffer_data;
@@ -168,20 +210,9 @@ void MFT_resampler::write_buffer(BYTE * buffer, DWORD byte_length)
     throw std::runtime_error("Failed to set current length of buffer.");
   }
 
-  Microsoft::WRL::ComPtr<IMFSample> sample;
-  hr = MFCreateSample(&sample);
-  if (FAILED(hr)) {
-    throw std::runtime_error("Failed to create MF sample.");
-  }
-
-  hr = sample->AddBuffer(input_media_buffer.Get());
-  if (FAILED(hr)) {
-    throw std::runtime_error("Failed to add buffer to MF sample.");
-  }
-
   hr = resampler->ProcessMessage(MFT_MESSAGE_NOTIFY_START_OF_STREAM, NULL);
 
-  hr = resampler->ProcessInput(input_stream_id, sample.Get(), 0);
+  hr = resampler->ProcessInput(input_stream_id, input_sample.Get(), 0);
   if (FAILED(hr)) {
     throw std::runtime_error("Failed to process input.");
   }
@@ -7,14 +7,23 @@
 class MFT_resampler
 {
 public:
+  // i̒i̐B0ōiŁAiオقǃtB^Zy
+  static const int num_quality_tiers = 4;
+  // iSetHalfFilterLength̒l
+  static int get_half_filter_length(int quality_tier);
+  // ĩtB^̒x̌ς [o̓t[]BtB^̕Б̒AႢ̃[g̎Ő
+  static int get_delay_frames(int quality_tier, int input_sampling_rate, int output_sampling_rate);
+
   MFT_resampler(
     int block_align,
     int channel_mask,
     int input_bytes_per_sec,
     int input_sampling_rate,
-    int output_sampling_rate
+    int output_sampling_rate,
+    int quality_tier = 0
   );
   ~MFT_resampler();
+  int get_quality_tier();
 
   void write_buffer(BYTE* buffer, DWORD byte_length);
   void read_buffer(std::vector<BYTE>& output);
@@ -24,6 +33,8 @@ private:
   Microsoft::WRL::ComPtr<IWMResamplerProps> properties;
   Microsoft::WRL::ComPtr<IMFSample> output_sample;
   Microsoft::WRL::ComPtr<IMFMediaBuffer> input_media_buffer;
+  Microsoft::WRL::ComPtr<IMFSample> input_sample;
   std::vector<BYTE> output_fragment_buffer;
   DWORD input_stream_id, output_stream_id;
+  int quality_tier;
 };
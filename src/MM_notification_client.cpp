@@ -51,6 +51,10 @@ HRESULT MM_notification_client::QueryInterface(REFIID riid, VOID ** ppvInterface
 
 HRESULT MM_notification_client::OnDefaultDeviceChanged(EDataFlow flow, ERole role, LPCWSTR pwstrDeviceId)
 {
-  audio_device->request_reinitialize(audio_device->get_sampling_rate());
+  // ^Ă̂eRender/eConsole̊foCXȂ̂ŁA̖̒ʒm͖B
+  // Đ~߂Ȃ悤AŐVfoCXJĂ芷
+  if (flow == eRender && role == eConsole) {
+    audio_device->request_migration();
+  }
   return S_OK;
 }
@@ -0,0 +1,108 @@
+#include "WASAPI_capture_backend.h"
+#include <stdexcept>
+#include <cassert>
+
+WASAPI_capture_backend::WASAPI_capture_backend(
+  Microsoft::WRL::ComPtr<IMMDevice> device,
+  int buffer_length_millisec)
+{
+  auto hr = device->Activate(
+    __uuidof(IAudioClient),
+    CLSCTX_ALL,
+    nullptr,
+    &audio_client
+  );
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to activate audio device.");
+  }
+
+  WAVEFORMATEX *mix_format = nullptr;
+  hr = audio_client->GetMixFormat(&mix_format);
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to get mix format.");
+  }
+
+  format.sampling_rate = mix_format->nSamplesPerSec;
+  format.num_channels = mix_format->nChannels;
+  format.bit_per_sample = mix_format->wBitsPerSample;
+  format.block_align = mix_format->nBlockAlign;
+  format.avg_bytes_per_sec = mix_format->nAvgBytesPerSec;
+
+  hr = audio_client->Initialize(
+    AUDCLNT_SHAREMODE_SHARED,
+    AUDCLNT_STREAMFLAGS_LOOPBACK,
+    buffer_length_millisec * 10000,
+    0,
+    mix_format,
+    nullptr
+  );
+  CoTaskMemFree(mix_format);
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to initialize audio client.");
+  }
+
+  hr = audio_client->GetBufferSize(&buffer_frame_count);
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to get buffer size.");
+  }
+
+  hr = audio_client->GetService(
+    IID_PPV_ARGS(&capture_client)
+  );
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed get capture client.");
+  }
+
+  hr = audio_client->Start();
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to start recording.");
+  }
+}
+
+capture_format WASAPI_capture_backend::get_format()
+{
+  return format;
+}
+
+UINT32 WASAPI_capture_backend::get_buffer_frame_count()
+{
+  return buffer_frame_count;
+}
+
+UINT32 WASAPI_capture_backend::get_next_packet_size()
+{
+  UINT32 packet_length;
+  auto hr = capture_client->GetNextPacketSize(&packet_length);
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to get next packet size.");
+  }
+  return packet_length;
+}
+
+void WASAPI_capture_backend::get_buffer(BYTE** fragment, UINT32* num_frames_available, DWORD* flags, UINT64* device_position, UINT64* qpc_position)
+{
+  auto hr = capture_client->GetBuffer(
+    fragment,
+    num_frames_available,
+    flags,
+    device_position,
+    qpc_position
+  );
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to get buffer.");
+  }
+  assert(hr != AUDCLNT_S_BUFFER_EMPTY);
+}
+
+void WASAPI_capture_backend::release_buffer(UINT32 num_frames)
+{
+  auto hr = capture_client->ReleaseBuffer(num_frames);
+  if (FAILED(hr)) {
+    throw std::runtime_error("Failed to release buffer.");
+  }
+}
+
+void WASAPI_capture_backend::stop()
+{
+  audio_client->Stop();
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include "capture_backend.h"
+#include <wrl/client.h>
+#include <mmdeviceapi.h>
+#include <Audioclient.h>
+
+// WASAPĨ[vobN^
+class WASAPI_capture_backend : public capture_backend
+{
+public:
+  WASAPI_capture_backend(
+    Microsoft::WRL::ComPtr<IMMDevice> device,
+    int buffer_length_millisec);
+
+  capture_format get_format() override;
+  UINT32 get_buffer_frame_count() override;
+  UINT32 get_next_packet_size() override;
+  void get_buffer(BYTE** fragment, UINT32* num_frames_available, DWORD* flags, UINT64* device_position, UINT64* qpc_position) override;
+  void release_buffer(UINT32 num_frames) override;
+  void stop() override;
+
+private:
+  Microsoft::WRL::ComPtr<IAudioClient> audio_client;
+  Microsoft::WRL::ComPtr<IAudioCaptureClient> capture_client;
+  capture_format format;
+  UINT32 buffer_frame_count;
+};
@@ -0,0 +1,102 @@
+#include "allocation_guard.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace allocation_guard
+{
+namespace
+{
+std::atomic<bool> armed(false);
+std::atomic<long long> violations(0);
+thread_local bool in_scope = false;
+
+void check()
+{
+  if (in_scope && armed.load(std::memory_order_relaxed)) {
+    violations.fetch_add(1, std::memory_order_relaxed);
+  }
+}
+}
+
+void arm()
+{
+  violations = 0;
+  armed = true;
+}
+
+void disarm()
+{
+  armed = false;
+}
+
+long long get_violations()
+{
+#ifdef LOOPBACK_ALLOCATION_GUARD
+  return violations;
+#else
+  return -1;
+#endif
+}
+
+scope::scope()
+  : previous(in_scope)
+{
+  in_scope = true;
+}
+
+scope::~scope()
+{
+  in_scope = previous;
+}
+}
+
+#ifdef LOOPBACK_ALLOCATION_GUARD
+// DLL̊mۂւBmێ̂͒ʏʂsAᔽ𐔂邾ɂ
+void* operator new(size_t size)
+{
+  allocation_guard::check();
+  void* pointer = malloc(size == 0 ? 1 : size);
+  if (!pointer) {
+    throw std::bad_alloc();
+  }
+  return pointer;
+}
+
+void* operator new[](size_t size)
+{
+  return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  allocation_guard::check();
+  return malloc(size == 0 ? 1 : size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  allocation_guard::check();
+  return malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+  free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+  free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+  free(pointer);
+}
+#endif
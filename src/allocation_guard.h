@@ -0,0 +1,25 @@
+#pragma once
+#include <windows.h>
+
+// ^XbhƃI[fBIXbhŁAEH[AbvɃq[vmۂNĂȂ𒲂ׂB
+// LOOPBACK_ALLOCATION_GUARD`ărhoperator newւĐB
+// `ȂꍇscopeŁAget_violations-1Ԃ
+namespace allocation_guard
+{
+// ȍ~Ascopeł̊mۂᔽƂĐ
+void arm();
+void disarm();
+// ᔽ񐔁Bvgݍ܂ĂȂ-1
+long long get_violations();
+
+// mۂĂ͂Ȃ
+class scope
+{
+public:
+  scope();
+  ~scope();
+
+private:
+  bool previous;
+};
+}
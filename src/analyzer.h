@@ -1,35 +1,52 @@
 #pragma once
-#include <deque>
+#include "beat_analyzer.h"
+#include "feature_graph.h"
+#include <vector>
 #include <array>
 
 class AudioDevice;
 
+// ^foCX̉̓obt@ǂ݁AwǂĂʂfeature_graphŌvZ
 class Analyzer
 {
 public:
-  static const int packet_size = 256;
-  static const int window_size = 2000;
-  static const int min_interval = 45;
-  static const int max_interval = 180;
+  static const int packet_size = beat_analyzer::packet_size;
+  static const int window_size = beat_analyzer::window_size;
+  static const int min_interval = beat_analyzer::min_interval;
+  static const int max_interval = beat_analyzer::max_interval;
 
-  Analyzer(AudioDevice* device, int sampling_rate);
+  // sampling_rate͘^foCXJo̓[gBanalysis_sampling_rateŉ͂ʂ̃[gɂłA0Ȃo̓[gƓ
+  Analyzer(AudioDevice* device, int sampling_rate, int analysis_sampling_rate = 0);
+  ~Analyzer();
+  int get_output_sampling_rate();
+  int get_sampling_rate();
   float get_bpm();
   float get_bpm_vu(int index);
   float get_bpm_score(int index);
   float get_rms(int index);
   float get_milliseconds_to_next_beat();
+  float get_onset();
+  float get_band_level(int band);
+  float get_loudness();
+  // oȂ̐؂ւ̉񐔁BResetAnalyzerł͖߂Ȃ
+  unsigned long long get_track_changes();
+  size_t get_history(Feature feature, float seconds, size_t width, float* minimum, float* maximum, float* mean);
+  // ŏsubscribe܂ł́A]APIVU/RMS/e|/̈ʒuƋȂ̐؂ւwǂĂ
+  void subscribe(Feature feature);
+  void unsubscribe(Feature feature);
+  float get_feature_cost(Feature feature);
   void reset();
   void update();
 
 private:
   AudioDevice* device;
-  std::deque<float> vu_bin;
-  std::deque<float> rms_bin;
-  std::array<double, max_interval - min_interval + 1> bpm_score;
-  std::array<double, max_interval - min_interval + 1> bpm_score_frame;
-  float bpm;
-  float milliseconds_to_next_beat;
+  feature_graph analysis;
+  std::array<std::vector<float>, 2> analyzer_data;
+  int output_sampling_rate;
+  // ͂̃[g
   int sampling_rate;
+  // ܂SubscribeFeatureĂ΂Ă炸A̓ʂwǂĂ邩
+  bool default_subscription;
 };
 
 extern Analyzer* analyzer;
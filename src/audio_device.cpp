@@ -1,7 +1,16 @@
 #include "audio_device.h"
 #include "loopback_audio_source.h"
+#include "WASAPI_capture_backend.h"
+#include "synthetic_capture_backend.h"
+#include "metrics.h"
+#include "trace.h"
+#include "allocation_guard.h"
 #include <windows.h>
+#include <intrin.h>
+#include <functiondiscoverykeys_devpkey.h>
 #include <stdexcept>
+#include <algorithm>
+#include <cstdlib>
 #include <chrono>
 #include <cassert>
 
@@ -9,9 +18,82 @@ using namespace Microsoft::WRL;
 
 AudioDevice* device;
 
+namespace
+{
+std::atomic<bool> synthetic_capture_requested(false);
+}
+
+namespace
+{
+std::wstring to_wide(const std::string& text)
+{
+  const int length = MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, nullptr, 0);
+  std::wstring result(length > 0 ? length - 1 : 0, L'\0');
+  if (length > 1) {
+    MultiByteToWideChar(CP_UTF8, 0, text.c_str(), -1, &result[0], length);
+  }
+  return result;
+}
+
+std::string to_utf8(const wchar_t* text)
+{
+  const int length = WideCharToMultiByte(CP_UTF8, 0, text, -1, nullptr, 0, nullptr, nullptr);
+  std::string result(length > 0 ? length - 1 : 0, '\0');
+  if (length > 1) {
+    WideCharToMultiByte(CP_UTF8, 0, text, -1, &result[0], length, nullptr, nullptr);
+  }
+  return result;
+}
+}
+
 AudioDevice::AudioDevice()
   : status(Status::Constructed)
+  , sampling_rate(0)
+  , sampling_rate_reinitialize(0)
+  , num_channels(0)
+  , bit_per_sample(0)
+  , buffer_frame_count(0)
+  , buffer(max_buffer_size)
+  , output_sampling_rate(0)
+  , silent_input_frames(0)
+  , silent_output_remainder(0)
+  , active_tap(nullptr)
+  , active_shared_export(nullptr)
+  , tap_in_use(false)
+  , last_recorded_frames(0)
+  , shared_export_sampling_rate(0)
+  , analyzer_sampling_rate(0)
+  , migration_requested(false)
+  , migration_running(false)
+  , pipeline_ready(false)
+  , migration_crossfade_pending(false)
+  , awaiting_first_packet(false)
+  , migration_switch_time(0)
+  , self_reference(65536)
+  , self_output_canceller(self_reference)
+  , self_output_cancellation(false)
+  , self_output_cancellation_active(false)
+  , resampler_tier(0)
+  , resampler_format()
+  , prepared_generation(0)
+  , resampler_ready(false)
+  , quality_build_failed(false)
+  , quality_worker_done(false)
+  , quality_controller(MFT_resampler::num_quality_tiers)
+  , quality_pending_tier(-1)
+  , quality_generation(0)
+  , quality_build_requested(false)
+  , next_primed_frames(0)
+  , quality_crossfade_position(0)
+  , quality_current_delay(0)
+  , quality_next_delay(0)
+  , load_thread_cycles(0)
+  , load_timestamp_cycles(0)
   , recorder(&AudioDevice::run, this)
+{
+}
+
+void AudioDevice::create_enumerator()
 {
   auto hr = CoCreateInstance(
     __uuidof(MMDeviceEnumerator),
@@ -27,103 +109,391 @@ AudioDevice::AudioDevice()
   enumerator->RegisterEndpointNotificationCallback(notification_client.get());
 }
 
+void AudioDevice::use_synthetic_capture(bool enabled)
+{
+  synthetic_capture_requested = enabled;
+}
+
+void AudioDevice::start(int output_sampling_rate)
+{
+  // foCX̗񋓂MFStartupATv̍쐬͏d̂ŁAĂяo(CXbhI[fBIXbh)ł͍sȂ
+  Status expected = Status::Constructed;
+  sampling_rate_reinitialize = output_sampling_rate;
+  status.compare_exchange_strong(expected, Status::Reinitializing);
+}
+
 void AudioDevice::initialize(
   int buffer_length_millisec,
   int output_sampling_rate)
 {
-  auto hr = enumerator->GetDefaultAudioEndpoint(
-    eRender,
-    eConsole,
-    &device
-  );
-  if (FAILED(hr)) {
-    throw std::runtime_error("Failed to get default audio endpoint.");
+  if (!enumerator) {
+    create_enumerator();
+  }
+  if (backend) {
+    backend->stop();
+    backend.reset();
   }
 
-  hr = device->Activate(
-    __uuidof(IAudioClient),
-    CLSCTX_ALL,
-    nullptr,
-    &audio_client
-  );
-  if (FAILED(hr)) {
-    throw std::runtime_error("Failed to activate audio device.");
+  auto pipeline = create_pipeline(buffer_length_millisec, output_sampling_rate, "");
+  adopt_pipeline(*pipeline);
+  {
+    // o̓[gς邩Ȃ̂ŁAǉ̃foCX蒼
+    std::lock_guard<std::mutex> lock(endpoints_mutex);
+    for (auto& endpoint : endpoints) {
+      try {
+        endpoint = std::make_unique<endpoint_mixer>(
+          endpoint->get_id(),
+          create_pipeline(buffer_length_millisec, output_sampling_rate, endpoint->get_id()),
+          max_buffer_size,
+          endpoint->get_gain());
+      } catch (const std::exception&) {
+        // ȂfoCX͎~܂܂܎cA̍ďłx
+      }
+    }
+  }
+  {
+    // 蒼̂ŁAŏĂ؂ւ͎gȂ
+    std::lock_guard<std::mutex> lock(migration_mutex);
+    prepared_pipeline.reset();
+    pipeline_ready = false;
   }
 
-  WAVEFORMATEX *mix_format = nullptr;
-  hr = audio_client->GetMixFormat(&mix_format);
-  if (FAILED(hr)) {
-    throw std::runtime_error("Failed to get mix format.");
+  this->output_sampling_rate = output_sampling_rate;
+  reserve_work_buffers();
+  // o̓[g痘pҖ̃[gւ̎}蒼B1pPbg͘^obt@Ɏ܂
+  fanout.configure(output_sampling_rate, num_channels, max_buffer_size);
+  // foCXςƎQƂ^܂ł̒xς
+  self_output_canceller.reset();
+
+  buffer.start(output_sampling_rate, num_channels);
+  status = Status::Running;
+}
+
+std::unique_ptr<capture_pipeline> AudioDevice::create_pipeline(int buffer_length_millisec, int output_sampling_rate, const std::string& endpoint_id)
+{
+  static const std::string synthetic_prefix = "synthetic:";
+  auto pipeline = std::make_unique<capture_pipeline>();
+  if (endpoint_id.compare(0, synthetic_prefix.size(), synthetic_prefix) == 0) {
+    // ǉfoCX̖͋[B̋^^ƕ悤ςAwppmNbN炷
+    const double clock_ppm = atof(endpoint_id.c_str() + synthetic_prefix.size());
+    pipeline->backend = std::make_unique<synthetic_capture_backend>(output_sampling_rate, buffer_length_millisec, 660.0f, 90.0f, clock_ppm);
+  } else if (!endpoint_id.empty()) {
+    auto hr = enumerator->GetDevice(to_wide(endpoint_id).c_str(), &pipeline->device);
+    if (FAILED(hr)) {
+      throw std::runtime_error("Failed to get audio endpoint.");
+    }
+    pipeline->backend = std::make_unique<WASAPI_capture_backend>(pipeline->device, buffer_length_millisec);
+  } else if (synthetic_capture_requested) {
+    pipeline->backend = std::make_unique<synthetic_capture_backend>(output_sampling_rate, buffer_length_millisec);
+  } else {
+    auto hr = enumerator->GetDefaultAudioEndpoint(
+      eRender,
+      eConsole,
+      &pipeline->device
+    );
+    if (FAILED(hr)) {
+      throw std::runtime_error("Failed to get default audio endpoint.");
+    }
+    pipeline->backend = std::make_unique<WASAPI_capture_backend>(pipeline->device, buffer_length_millisec);
   }
 
-  sampling_rate = mix_format->nSamplesPerSec;
-  num_channels = mix_format->nChannels;
-  bit_per_sample = mix_format->wBitsPerSample;
+  pipeline->format = pipeline->backend->get_format();
+  pipeline->buffer_frame_count = pipeline->backend->get_buffer_frame_count();
+  pipeline->output_sampling_rate = output_sampling_rate;
 
-  resampler = std::make_unique<MFT_resampler>(
-    mix_format->nBlockAlign,
+  pipeline->resampler = std::make_unique<MFT_resampler>(
+    pipeline->format.block_align,
     SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT,
-    mix_format->nAvgBytesPerSec,
-    mix_format->nSamplesPerSec,
-    output_sampling_rate
+    pipeline->format.avg_bytes_per_sec,
+    pipeline->format.sampling_rate,
+    output_sampling_rate,
+    resampler_tier
     );
+  return pipeline;
+}
 
-  hr = audio_client->Initialize(
-    AUDCLNT_SHAREMODE_SHARED,
-    AUDCLNT_STREAMFLAGS_LOOPBACK,
-    buffer_length_millisec * 10000,
-    0,
-    mix_format,
-    nullptr
-  );
-  CoTaskMemFree(mix_format);
-  if (FAILED(hr)) {
-    throw std::runtime_error("Failed to initialize audio client.");
+void AudioDevice::adopt_pipeline(capture_pipeline& pipeline)
+{
+  if (pipeline.device) {
+    // get_default_device()̓CXbhǂ
+    std::lock_guard<std::mutex> lock(migration_mutex);
+    device = pipeline.device;
   }
+  backend = std::move(pipeline.backend);
+  resampler = std::move(pipeline.resampler);
+  sampling_rate = pipeline.format.sampling_rate;
+  num_channels = pipeline.format.num_channels;
+  bit_per_sample = pipeline.format.bit_per_sample;
+  buffer_frame_count = pipeline.buffer_frame_count;
+  // VTv͖ʂIĂȂ
+  silent_input_frames = 0;
+  silent_output_remainder = 0;
 
-  hr = audio_client->GetBufferSize(&buffer_frame_count);
-  if (FAILED(hr)) {
-    throw std::runtime_error("Failed to get buffer size.");
+  // i̐؂ւȂAfoCXɍ̒i͎gȂ
+  resampler_format = pipeline.format;
+  resampler_tier = resampler->get_quality_tier();
+  ++quality_generation;
+  quality_pending_tier = -1;
+  quality_build_requested = false;
+  next_resampler.reset();
+  quality_current_frames.clear();
+  quality_next_frames.clear();
+  quality_controller.reset(resampler_tier);
+  metrics::set(metrics::Gauge::ResamplerTier, resampler_tier);
+}
+
+void AudioDevice::reserve_work_buffers()
+{
+  // ȍ~̘^[vŊmۂȂ悤AőʂŊmۂĂB
+  // Tvo͂1pPbgŃobt@ŜĂ܂悤Ao̓[gZŗ]T
+  const size_t max_output_frames = static_cast<size_t>(buffer_frame_count) * output_sampling_rate / sampling_rate + 1024;
+  for (size_t channel = 0; channel < max_channels; ++channel) {
+    deinterleave_buffer[channel].reserve(max_output_frames);
+  }
+  resampler_result.reserve(max_output_frames * num_channels * sizeof(float));
+  next_resampler_result.reserve(max_output_frames * num_channels * sizeof(float));
+  // i̐؂ւŎźA1pPbg̏o͂ɒx̍Ƃ𑫂Ă܂悤ɂ
+  quality_current_frames.reserve((max_output_frames + 1024) * num_channels);
+  quality_next_frames.reserve((max_output_frames + 1024) * num_channels);
+}
+
+void AudioDevice::request_migration()
+{
+  if (!is_initialized() || status == Status::Reinitializing || output_sampling_rate == 0) {
+    // ܂ĂȂΒʏ̏ɔC
+    return;
+  }
+
+  std::lock_guard<std::mutex> lock(migration_mutex);
+  migration_requested = true;
+  if (migration_running) {
+    // 쐬̃[J[I莟Ax蒼
+    return;
+  }
+  if (migration_worker.joinable()) {
+    migration_worker.join();
+  }
+  migration_running = true;
+  migration_worker = std::thread(&AudioDevice::build_migration_pipeline, this);
+}
+
+void AudioDevice::build_migration_pipeline()
+{
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  for (;;) {
+    {
+      std::lock_guard<std::mutex> lock(migration_mutex);
+      if (!migration_requested || status >= Status::Stopped) {
+        migration_running = false;
+        break;
+      }
+      migration_requested = false;
+    }
+
+    // ĂԂɘ^XbhςĂApCvCƓ[gg
+    const int rate = output_sampling_rate;
+    try {
+      TRACE_SCOPE("build pipeline");
+      const UINT64 start = metrics::now_microseconds();
+      auto pipeline = create_pipeline(32, rate, "");
+      metrics::record(metrics::Histogram::MigrationBuildTime, metrics::now_microseconds() - start);
+
+      std::lock_guard<std::mutex> lock(migration_mutex);
+      prepared_pipeline = std::move(pipeline);
+      pipeline_ready = true;
+    } catch (const std::exception&) {
+      request_reinitialize(rate);
+    }
   }
+  CoUninitialize();
+}
 
-  hr = audio_client->GetService(
-    IID_PPV_ARGS(&capture_client)
+void AudioDevice::add_endpoint(const std::string& id, float gain)
+{
+  const int rate = output_sampling_rate;
+  if (!is_initialized() || rate == 0) {
+    throw std::runtime_error("Failed to add endpoint before initialization.");
+  }
+  if (id.empty()) {
+    throw std::runtime_error("Failed to add endpoint without id.");
+  }
+  {
+    std::lock_guard<std::mutex> lock(endpoints_mutex);
+    for (auto& endpoint : endpoints) {
+      if (endpoint->get_id() == id && !endpoint->has_failed()) {
+        endpoint->set_gain(gain);
+        return;
+      }
+    }
+  }
+
+  // foCXĴ͌ĂяõXbhōsA^Xbh~߂Ȃ
+  auto mixer = std::make_unique<endpoint_mixer>(id, create_pipeline(32, rate, id), max_buffer_size, gain);
+  std::unique_ptr<endpoint_mixer> previous;
+  {
+    std::lock_guard<std::mutex> lock(endpoints_mutex);
+    auto found = std::find_if(endpoints.begin(), endpoints.end(), [&](const std::unique_ptr<endpoint_mixer>& endpoint) { return endpoint->get_id() == id; });
+    if (found != endpoints.end()) {
+      previous = std::move(*found);
+      *found = std::move(mixer);
+    } else {
+      endpoints.push_back(std::move(mixer));
+    }
+  }
+}
+
+void AudioDevice::remove_endpoint(const std::string& id)
+{
+  std::unique_ptr<endpoint_mixer> removed;
+  {
+    std::lock_guard<std::mutex> lock(endpoints_mutex);
+    auto found = std::find_if(endpoints.begin(), endpoints.end(), [&](const std::unique_ptr<endpoint_mixer>& endpoint) { return endpoint->get_id() == id; });
+    if (found == endpoints.end()) {
+      return;
+    }
+    removed = std::move(*found);
+    endpoints.erase(found);
+  }
+  // ^̒~̓bN̊Oōs
+}
+
+float AudioDevice::get_endpoint_drift(const std::string& id)
+{
+  std::lock_guard<std::mutex> lock(endpoints_mutex);
+  for (auto& endpoint : endpoints) {
+    if (endpoint->get_id() == id) {
+      return endpoint->get_drift_ppm();
+    }
+  }
+  return 0.0f;
+}
+
+std::string AudioDevice::list_render_endpoints()
+{
+  ComPtr<IMMDeviceEnumerator> device_enumerator;
+  auto hr = CoCreateInstance(
+    __uuidof(MMDeviceEnumerator),
+    nullptr,
+    CLSCTX_ALL,
+    IID_PPV_ARGS(&device_enumerator)
   );
   if (FAILED(hr)) {
-    throw std::runtime_error("Failed get capture client.");
+    throw std::runtime_error("Failed to create IMMDeviceEnumerator.");
   }
 
-  hr = audio_client->Start();
+  ComPtr<IMMDeviceCollection> collection;
+  hr = device_enumerator->EnumAudioEndpoints(eRender, DEVICE_STATE_ACTIVE, &collection);
   if (FAILED(hr)) {
-    throw std::runtime_error("Failed to start recording.");
+    throw std::runtime_error("Failed to enumerate audio endpoints.");
   }
+  UINT count = 0;
+  collection->GetCount(&count);
+
+  std::string result;
+  for (UINT index = 0; index < count; ++index) {
+    ComPtr<IMMDevice> endpoint;
+    if (FAILED(collection->Item(index, &endpoint))) {
+      continue;
+    }
+    LPWSTR id = nullptr;
+    if (FAILED(endpoint->GetId(&id))) {
+      continue;
+    }
+    result += to_utf8(id);
+    CoTaskMemFree(id);
 
-  for (size_t channel = 0; channel < num_channels; ++channel) {
-    recording_data.emplace_back();
-    deinterleave_buffer[channel].resize(buffer_frame_count);
+    result += '\t';
+    ComPtr<IPropertyStore> properties;
+    if (SUCCEEDED(endpoint->OpenPropertyStore(STGM_READ, &properties))) {
+      PROPVARIANT name;
+      PropVariantInit(&name);
+      if (SUCCEEDED(properties->GetValue(PKEY_Device_FriendlyName, &name)) && name.vt == VT_LPWSTR) {
+        result += to_utf8(name.pwszVal);
+      }
+      PropVariantClear(&name);
+    }
+    result += '\n';
   }
-  // Unity1024TvŎɗ
-  pass_buffer.resize(1024);
-  zero_buffer.assign(1024, 0.0f);
+  return result;
+}
+
+void AudioDevice::push_reference(const float* interleaved, size_t num_frames, int input_channels)
+{
+  self_reference.push(interleaved, num_frames, input_channels);
+}
+
+void AudioDevice::set_self_output_cancellation(bool enabled)
+{
+  self_output_cancellation = enabled;
+}
 
-  status = Status::Preparing;
+long long AudioDevice::get_self_output_delay()
+{
+  return self_output_canceller.get_delay();
+}
+
+float AudioDevice::get_self_output_erle()
+{
+  return self_output_canceller.get_erle_db();
+}
+
+void AudioDevice::switch_pipeline()
+{
+  std::unique_ptr<capture_pipeline> next;
+  {
+    std::lock_guard<std::mutex> lock(migration_mutex);
+    next = std::move(prepared_pipeline);
+    pipeline_ready = false;
+  }
+  if (!next || next->output_sampling_rate != output_sampling_rate) {
+    // ɏo̓[gςĂ̂Ă
+    return;
+  }
+
+  TRACE_SCOPE("switch pipeline");
+  // foCX̎c͒O̎œfoς݂Ȃ̂ŁAubNEɂȂB
+  // o̓[g͕ςȂ̂ŁAĐ͏ɖ߂炸̂܂ܑ
+  backend->stop();
+  capture_pipeline previous;
+  previous.backend = std::move(backend);
+  previous.resampler = std::move(resampler);
+  adopt_pipeline(*next);
+  reserve_work_buffers();
+  self_output_canceller.reset();
+
+  migration_crossfade_pending = true;
+  awaiting_first_packet = true;
+  migration_switch_time = metrics::now_microseconds();
+  metrics::increment(metrics::Counter::Migrations);
 }
 
 void AudioDevice::Finalize()
 {
   // ^Xbh~
   status = Status::Stopped;
+  buffer.stop();
   if (recorder.joinable()) {
     recorder.join();
   }
-  if (audio_client) {
-    audio_client->Stop();
+  {
+    std::lock_guard<std::mutex> lock(migration_mutex);
+    migration_requested = false;
+  }
+  if (migration_worker.joinable()) {
+    migration_worker.join();
+  }
+  if (quality_worker.joinable()) {
+    quality_worker.join();
+  }
+  if (backend) {
+    backend->stop();
   }
 }
 
 void AudioDevice::request_reinitialize(int sampling_rate)
 {
   status = Status::Reinitializing;
+  buffer.stop();
   sampling_rate_reinitialize = sampling_rate;
 }
 
@@ -144,217 +514,605 @@ int AudioDevice::get_num_channels()
 
 Microsoft::WRL::ComPtr<IMMDevice> AudioDevice::get_default_device()
 {
+  std::lock_guard<std::mutex> lock(migration_mutex);
   return device;
 }
 
-float* AudioDevice::get_buffer(int request_channel, int length)
+bool AudioDevice::read_source(int channel, bool enabled, capture_buffer::reader& source, float* output, int length)
 {
-  if (pass_buffer.size() < length || zero_buffer.size() < length) {
-    pass_buffer.resize(length);
-    zero_buffer.resize(length);
+  if (length <= 0 || static_cast<size_t>(length) > max_buffer_size) {
+    return false;
   }
+  return buffer.read_source(channel, enabled, source, output, length);
+}
 
-  size_t recording_data_size;
-  {
-    std::lock_guard<std::mutex> lock(recording_data_mutex);
-    recording_data_size = recording_data[request_channel].size();
+void AudioDevice::get_buffer(int request_channel, capture_buffer::reader& source, float* output, int length)
+{
+  buffer.get_buffer(request_channel, source, output, length);
+}
+
+size_t AudioDevice::get_analyzer_data(size_t alignment, std::array<std::vector<float>, max_channels>& result, bool* silent)
+{
+  return buffer.get_analyzer_data(alignment, result, silent);
+}
+
+void AudioDevice::catch_up(int request_channel)
+{
+  buffer.catch_up(request_channel);
+}
+
+void AudioDevice::reset_buffer()
+{
+  buffer.reset_buffer();
+}
+
+void AudioDevice::hold_standby()
+{
+  buffer.hold_standby();
+}
+
+void AudioDevice::set_warm_standby(bool enabled)
+{
+  buffer.set_warm_standby(enabled);
+}
+
+void AudioDevice::reset_analyzer_data()
+{
+  buffer.reset_analyzer_data();
+}
+
+void AudioDevice::set_concealment_mode(underrun_concealer::Mode mode)
+{
+  buffer.set_concealment_mode(mode);
+}
+
+void AudioDevice::set_target_buffer_size(size_t samples)
+{
+  buffer.set_target_buffer_size(samples);
+}
+
+void AudioDevice::start_recording(const std::string& path, int sampling_rate, SampleFormat format)
+{
+  std::lock_guard<std::mutex> lock(tap_mutex);
+  stop_recording_locked();
+  if (output_sampling_rate == 0 || num_channels == 0) {
+    throw std::runtime_error("Failed to start recording before initialization.");
+  }
+  const int rate = sampling_rate != 0 ? sampling_rate : output_sampling_rate.load();
+  fanout.acquire(rate);
+  try {
+    stream_tap = std::make_unique<stream_recorder>(path, rate, num_channels, format);
+  } catch (const std::exception&) {
+    fanout.release(rate);
+    throw;
   }
+  active_tap = stream_tap.get();
+}
 
-  // ^obt@ɏ\ȉf[^W܂܂Ŗ𗬂đҋ@
-  switch (status) {
-  case Status::Preparing:
-    if (recording_data_size < prepare_buffer_size) {
-      return zero_buffer.data();
-    } else {
-      status = Status::Playing;
-    }
-    // Đ֑Jڂ̂break̂܂܎s
-  case Status::Playing:
-    if (recording_data_size < length) {
-      // ^ԂɍĂȂBr؂ꔭB
-      return zero_buffer.data();
-    }
-    {
-      std::lock_guard<std::mutex> lock(recording_data_mutex);
-      std::copy(recording_data[request_channel].begin(), recording_data[request_channel].begin() + length, pass_buffer.begin());
-      for (size_t i = 0; i < length; ++i) {
-        recording_data[request_channel].pop_front();
-      }
+void AudioDevice::stop_recording()
+{
+  std::lock_guard<std::mutex> lock(tap_mutex);
+  stop_recording_locked();
+}
+
+void AudioDevice::stop_recording_locked()
+{
+  active_tap = nullptr;
+  wait_for_taps();
+  if (stream_tap) {
+    stream_tap->close();
+    last_recorded_frames = stream_tap->get_written_frames();
+    fanout.release(stream_tap->get_sampling_rate());
+    stream_tap.reset();
+  }
+}
+
+void AudioDevice::start_shared_export(const std::string& name, int sampling_rate)
+{
+  std::lock_guard<std::mutex> lock(tap_mutex);
+  stop_shared_export_locked();
+  if (sampling_rate != 0) {
+    fanout.acquire(sampling_rate);
+  }
+  try {
+    shared_export = std::make_unique<shared_capture_export>(name);
+  } catch (const std::exception&) {
+    if (sampling_rate != 0) {
+      fanout.release(sampling_rate);
     }
-    return pass_buffer.data();
-  default:
-    return zero_buffer.data();
+    throw;
   }
+  shared_export_sampling_rate = sampling_rate;
+  active_shared_export = shared_export.get();
 }
 
-std::array<std::vector<float>, AudioDevice::max_channels> AudioDevice::get_analyzer_data(size_t alignment)
+void AudioDevice::stop_shared_export()
 {
-  std::array<std::vector<float>, max_channels> result;
+  std::lock_guard<std::mutex> lock(tap_mutex);
+  stop_shared_export_locked();
+}
 
-  // \ȉf[^W܂܂ŃXLbv
-  if (analyzer_data[0].size() < alignment) {
-    return result;
+void AudioDevice::stop_shared_export_locked()
+{
+  active_shared_export = nullptr;
+  wait_for_taps();
+  if (shared_export && shared_export_sampling_rate != 0) {
+    fanout.release(shared_export_sampling_rate);
   }
+  shared_export_sampling_rate = 0;
+  shared_export.reset();
+}
 
-  {
-    std::lock_guard<std::mutex> lock(analyzer_data_mutex);
-    // e`l̂ŏ̃ACς݃TCYvZ
-    size_t result_size = INT_MAX;
-    for (size_t channel = 0; channel < max_channels; ++channel) {
-      size_t size = analyzer_data[channel].size() - (analyzer_data[channel].size() % alignment);
-      if (size < result_size) {
-        result_size = size;
-      }
+void AudioDevice::publish_analyzer(const shared_capture::analyzer_snapshot& snapshot)
+{
+  // ͌ʂ̏͂̊֐Ȃ̂ŁAtap_mutexŒ񉻂ΒPꃉC^[ɂȂ
+  std::lock_guard<std::mutex> lock(tap_mutex);
+  if (shared_export) {
+    auto stamped = snapshot;
+    stamped.sample_position = shared_export->get_write_frame();
+    shared_export->publish_analyzer(stamped);
+  }
+}
+
+void AudioDevice::set_analyzer_sampling_rate(int rate)
+{
+  if (rate == analyzer_sampling_rate) {
+    return;
+  }
+  // V}Ă؂ւAÂ}
+  if (rate != 0) {
+    fanout.acquire(rate);
+  }
+  buffer.set_analyzer_sampling_rate(rate);
+  if (analyzer_sampling_rate != 0) {
+    fanout.release(analyzer_sampling_rate);
+  }
+  analyzer_sampling_rate = rate;
+}
+
+std::string AudioDevice::describe_rate_fanout()
+{
+  return fanout.describe();
+}
+
+void AudioDevice::wait_for_taps()
+{
+  // ^Xbh擾ς݂̃|C^gI܂ő҂
+  while (tap_in_use) {
+    std::this_thread::yield();
+  }
+}
+
+UINT64 AudioDevice::get_recorded_frames()
+{
+  std::lock_guard<std::mutex> lock(tap_mutex);
+  return stream_tap ? stream_tap->get_written_frames() : last_recorded_frames;
+}
+
+UINT64 AudioDevice::get_recording_dropped_frames()
+{
+  std::lock_guard<std::mutex> lock(tap_mutex);
+  return stream_tap ? stream_tap->get_dropped_frames() : 0;
+}
+
+UINT64 AudioDevice::get_sample_position()
+{
+  return buffer.get_sample_position();
+}
+
+float AudioDevice::get_latency(LatencyConsumer consumer)
+{
+  return buffer.get_latency(consumer);
+}
+
+int AudioDevice::get_latency_histogram(LatencyConsumer consumer, int* buckets, int length)
+{
+  return buffer.get_latency_histogram(consumer, buckets, length);
+}
+
+void AudioDevice::reset_latency()
+{
+  buffer.reset_latency();
+}
+
+void AudioDevice::publish_to_consumers(bool silent)
+{
+  size_t num_frames;
+  tap_in_use = true;
+  if (auto tap = active_tap.load()) {
+    if (auto data = fanout.get_output(tap->get_sampling_rate(), &num_frames)) {
+      tap->push(data, num_frames);
     }
-    assert(result_size % alignment == 0);
-
-    for (size_t channel = 0; channel < max_channels; ++channel) {
-      result[channel].resize(result_size);
-      std::copy(analyzer_data[channel].begin(),
-                analyzer_data[channel].begin() + result_size,
-                result[channel].begin());
-      for (size_t i = 0; i < result_size; ++i) {
-        analyzer_data[channel].pop_front();
-      }
+  }
+  if (auto exporter = active_shared_export.load()) {
+    const int rate = shared_export_sampling_rate != 0 ? shared_export_sampling_rate.load() : output_sampling_rate.load();
+    if (auto data = fanout.get_output(rate, &num_frames)) {
+      exporter->publish_audio(data, num_frames, rate, num_channels);
+    }
+  }
+  tap_in_use = false;
+
+  // ͂o̓[gȂbuffer.push
+  const int analyzer_rate = buffer.get_analyzer_sampling_rate();
+  if (analyzer_rate != output_sampling_rate) {
+    if (auto data = fanout.get_output(analyzer_rate, &num_frames)) {
+      buffer.push_analyzer(silent ? nullptr : data, num_frames, num_channels);
     }
   }
-  return result;
 }
 
-void AudioDevice::catch_up(int request_channel)
+void AudioDevice::start_quality_worker()
 {
-  std::lock_guard<std::mutex> lock(recording_data_mutex);
-  auto min_size = recording_data[0].size();
-  for (auto& recording_channel : recording_data) {
-    auto size = recording_channel.size();
-    if (size < min_size) {
-      min_size = size;
+  if (quality_build_failed.exchange(false)) {
+    // ȂB̒iɗ܂Af蒼
+    quality_pending_tier = -1;
+    quality_controller.reset(resampler_tier);
+  }
+  if (!quality_build_requested) {
+    return;
+  }
+  if (quality_worker.joinable()) {
+    if (!quality_worker_done.load(std::memory_order_acquire)) {
+      // O̍쐬܂IĂȂB˗͎cĎ̋Nł蒼
+      return;
     }
+    quality_worker.join();
   }
+  quality_build_requested = false;
+  quality_worker_done.store(false, std::memory_order_relaxed);
+  quality_worker = std::thread(&AudioDevice::build_quality_resampler, this, quality_pending_tier, quality_generation, resampler_format, output_sampling_rate.load());
+}
 
-  while (recording_data[request_channel].size() > min_size) {
-    recording_data[request_channel].pop_front();
+void AudioDevice::build_quality_resampler(int tier, int generation, capture_format format, int output_sampling_rate)
+{
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  try {
+    TRACE_SCOPE("build resampler");
+    auto created = std::make_unique<MFT_resampler>(
+      format.block_align,
+      SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT,
+      format.avg_bytes_per_sec,
+      format.sampling_rate,
+      output_sampling_rate,
+      tier
+      );
+    std::lock_guard<std::mutex> lock(quality_mutex);
+    prepared_resampler = std::move(created);
+    prepared_generation = generation;
+    resampler_ready = true;
+  } catch (const std::exception&) {
+    quality_build_failed = true;
   }
+  CoUninitialize();
+  quality_worker_done.store(true, std::memory_order_release);
 }
 
-void AudioDevice::reset_buffer()
+void AudioDevice::begin_quality_switch()
 {
+  std::unique_ptr<MFT_resampler> created;
+  int generation;
   {
-    std::lock_guard<std::mutex> lock(recording_data_mutex);
-    for (auto& recording_channel : recording_data) {
-      recording_channel.clear();
+    std::lock_guard<std::mutex> lock(quality_mutex);
+    created = std::move(prepared_resampler);
+    generation = prepared_generation;
+    resampler_ready = false;
+  }
+  if (!created || generation != quality_generation || quality_pending_tier < 0) {
+    // ĂԂɘ^̑gւ
+    return;
+  }
+  // tB^܂܂ŋTvƓ͂ʂĂdˎn߂
+  next_resampler = std::move(created);
+  next_primed_frames = 0;
+  quality_crossfade_position = 0;
+  // x̒Z̕x点BV̕ZΗオ̏o̖͂A̕Z΋̏o̖͂Ă
+  const int current_delay = MFT_resampler::get_delay_frames(resampler_tier, resampler_format.sampling_rate, output_sampling_rate);
+  const int next_delay = MFT_resampler::get_delay_frames(quality_pending_tier, resampler_format.sampling_rate, output_sampling_rate);
+  quality_current_delay = static_cast<size_t>(current_delay < next_delay ? next_delay - current_delay : 0);
+  quality_next_delay = static_cast<size_t>(next_delay < current_delay ? current_delay - next_delay : 0);
+  quality_current_frames.clear();
+  quality_next_frames.clear();
+}
+
+void AudioDevice::blend_quality_switch(size_t num_input_frames)
+{
+  const auto next = reinterpret_cast<const float*>(next_resampler_result.data());
+  quality_next_frames.insert(quality_next_frames.end(), next, next + next_resampler_result.size() / sizeof(float));
+  if (next_primed_frames < resampler_flush_frames) {
+    // オ̏o͎͂̂ĂBV̕x点镪c
+    next_primed_frames += num_input_frames;
+    const size_t keep = quality_next_delay * num_channels;
+    if (quality_next_frames.size() > keep) {
+      quality_next_frames.erase(quality_next_frames.begin(), quality_next_frames.end() - keep);
+    }
+    if (next_primed_frames >= resampler_flush_frames) {
+      // ̕x点镪́ÃpPbg̋̏o̖͂oɎĂ
+      const size_t current_size = resampler_result.size() / sizeof(float);
+      const size_t withheld = (std::min)(quality_current_delay * num_channels, current_size);
+      const auto current = reinterpret_cast<const float*>(resampler_result.data());
+      quality_current_frames.assign(current + current_size - withheld, current + current_size);
+      resampler_result.resize((current_size - withheld) * sizeof(float));
+    }
+    return;
+  }
+
+  // ̏o͂͒x点Ă镪cďoBo͂̃pPbg̋̏o͂Ɠ
+  const auto current_output = reinterpret_cast<const float*>(resampler_result.data());
+  const size_t current_size = resampler_result.size() / sizeof(float);
+  quality_current_frames.insert(quality_current_frames.end(), current_output, current_output + current_size);
+  const size_t num_frames = current_size / num_channels;
+  memcpy(resampler_result.data(), quality_current_frames.data(), current_size * sizeof(float));
+  quality_current_frames.erase(quality_current_frames.begin(), quality_current_frames.begin() + current_size);
+
+  // V̏o͂Ȃ͋̂܂܏oAV̎c͎̃pPbg֎z
+  const auto current = reinterpret_cast<float*>(resampler_result.data());
+  const size_t next_frames = quality_next_frames.size() / num_channels;
+  const size_t blend_frames = num_frames < next_frames ? num_frames : next_frames;
+  for (size_t frame = 0; frame < blend_frames; ++frame) {
+    const size_t position = quality_crossfade_position + frame + 1;
+    const float gain = position < quality_crossfade_frames ? static_cast<float>(position) / quality_crossfade_frames : 1.0f;
+    for (size_t channel = 0; channel < num_channels; ++channel) {
+      const size_t index = frame * num_channels + channel;
+      current[index] += (quality_next_frames[index] - current[index]) * gain;
     }
   }
-  status = Status::Preparing;
+  quality_next_frames.erase(quality_next_frames.begin(), quality_next_frames.begin() + blend_frames * num_channels);
+  quality_crossfade_position += blend_frames;
+  if (quality_crossfade_position < quality_crossfade_frames) {
+    return;
+  }
+
+  // 芷BV̏o͂̂܂oĂȂ́AdˏȊȂ̂ł̃pPbǧɕtB
+  // ̎Ă͐V̏o͂ƓȂ̂Ŏ̂ĂBTv̔j͊mۂ̋鎟̋N̓ōs
+  const auto carried = reinterpret_cast<const BYTE*>(quality_next_frames.data());
+  resampler_result.insert(resampler_result.end(), carried, carried + quality_next_frames.size() * sizeof(float));
+  quality_next_frames.clear();
+  quality_current_frames.clear();
+
+  metrics::resampler_switch event;
+  event.time_us = metrics::now_microseconds();
+  event.from_tier = resampler_tier;
+  event.to_tier = quality_pending_tier;
+  event.reason = resampler_quality_controller::get_name(quality_controller.get_reason());
+  event.load_percent = static_cast<int>(quality_controller.get_load() + 0.5f);
+  metrics::record_resampler_switch(event);
+
+  retired_resampler = std::move(resampler);
+  resampler = std::move(next_resampler);
+  resampler_tier = quality_pending_tier;
+  quality_pending_tier = -1;
+  metrics::set(metrics::Gauge::ResamplerTier, resampler_tier);
 }
 
-void AudioDevice::reset_analyzer_data()
+void AudioDevice::update_resampler_quality(size_t fill_at_wake, bool measure)
 {
-  std::lock_guard<std::mutex> lock(analyzer_data_mutex);
-  for (auto& channel : analyzer_data) {
-    channel.clear();
+  // ׂ͑Ő؂肩炱̃XbhgCPUTCNAԂɐi񂾃^CX^vJE^ŊČB
+  // ̃XbhɊ荞܂đ҂Ԃ͊܂܂Ȃ̂ŁACPU̎荇ł͉Ȃ
+  ULONG64 thread_cycles = 0;
+  QueryThreadCycleTime(GetCurrentThread(), &thread_cycles);
+  const UINT64 timestamp_cycles = __rdtsc();
+  const UINT64 busy = thread_cycles - load_thread_cycles;
+  const UINT64 elapsed = timestamp_cycles - load_timestamp_cycles;
+  const bool first = load_timestamp_cycles == 0;
+  load_thread_cycles = thread_cycles;
+  load_timestamp_cycles = timestamp_cycles;
+  if (!measure || first) {
+    return;
+  }
+
+  const UINT64 now = metrics::now_microseconds();
+  const size_t target = buffer.get_state() == capture_buffer::State::Playing ? buffer.get_target_buffer_size() : 0;
+  const int desired = quality_controller.update(now, busy, elapsed, fill_at_wake, target);
+  metrics::set(metrics::Gauge::CaptureLoad, static_cast<long long>(quality_controller.get_load() + 0.5f));
+  if (desired != resampler_tier && quality_pending_tier < 0) {
+    // 쐬͎̋N̓ŗ̃Xbhֈ˗
+    quality_pending_tier = desired;
+    ++quality_generation;
+    quality_build_requested = true;
   }
 }
 
 void AudioDevice::run()
 {
+  trace::set_thread_name("capture");
+  // ̃XbhōŝŁACOM͂ŏ
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  UINT64 previous_wake = 0;
   while (status < Status::Stopped) { 
-    // obt@1/2҂
-    std::this_thread::sleep_for(std::chrono::microseconds(static_cast<size_t>((double)buffer_frame_count / sampling_rate / 2.0 * 1000.0 * 1000.0)));
-    if (status == Status::Constructed) {
+    if (sampling_rate > 0) {
+      // obt@1/2҂
+      std::this_thread::sleep_for(std::chrono::microseconds(static_cast<size_t>((double)buffer_frame_count / sampling_rate / 2.0 * 1000.0 * 1000.0)));
+    }
+    if (status == Status::Constructed || (status == Status::Reinitializing && sampling_rate_reinitialize == 0)) {
       std::this_thread::sleep_for(std::chrono::milliseconds(33));
       continue;
     }
 
+    const UINT64 wake = metrics::now_microseconds();
+    if (previous_wake != 0) {
+      metrics::record(metrics::Histogram::CaptureWakeInterval, wake - previous_wake);
+    }
+    previous_wake = wake;
+    metrics::increment(metrics::Counter::CaptureWakes);
+
+    TRACE_SCOPE("capture loop");
     try {
+      // ď؂ւŃAԂ𕉉ׂƂĐȂ
+      bool maintenance = true;
       if (status == Status::Reinitializing) {
         initialize(32, sampling_rate_reinitialize);
+      } else if (pipeline_ready) {
+        switch_pipeline();
+      } else if (resampler_ready) {
+        begin_quality_switch();
+      } else {
+        maintenance = false;
       }
+      // i؂ւTv̔jƁA̒i̍쐬̈˗mۂ𔺂̂łōs
+      retired_resampler.reset();
+      start_quality_worker();
+      // ďƐ؂ւȊO̘^[vł͊mۂȂ
+      allocation_guard::scope no_allocation;
+      const size_t fill_at_wake = buffer.get_size(0);
 
-      UINT32 total_frames = 0;
-      UINT32 packet_length;
-      auto hr = capture_client->GetNextPacketSize(&packet_length);
-      if (FAILED(hr)) {
-        throw std::runtime_error("Failed to get next packet size.");
+      // ǉ̃foCX͐ɓǂłAfoCX̊epPbg֎𑵂đ
+      std::lock_guard<std::mutex> endpoints_lock(endpoints_mutex);
+      for (auto& endpoint : endpoints) {
+        endpoint->capture();
       }
+      std::lock_guard<std::mutex> fanout_lock(fanout.get_mutex());
+
+      UINT32 total_frames = 0;
+      UINT64 num_packets = 0;
+      UINT32 packet_length = backend->get_next_packet_size();
       BYTE *fragment;
       UINT32 num_frames_available;
       DWORD flags;
+      UINT64 device_position;
+      UINT64 qpc_position;
       while (packet_length != 0) {
-        hr = capture_client->GetBuffer(
-          &fragment,
-          &num_frames_available,
-          &flags,
-          nullptr,
-          nullptr
-        );
-        if (FAILED(hr)) {
-          throw std::runtime_error("Failed to get buffer.");
+        {
+          TRACE_SCOPE("GetBuffer");
+          backend->get_buffer(&fragment, &num_frames_available, &flags, &device_position, &qpc_position);
         }
-        assert(hr != AUDCLNT_S_BUFFER_EMPTY);
         total_frames += num_frames_available;
+        ++num_packets;
 
-        if (flags & AUDCLNT_BUFFERFLAGS_SILENT) {
+        // ̃pPbgoĂ郊TṽTvɘ^RtB
+        // Tv̂̒x͂邪ATvxȂ̂Ŗ
+        if (flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) {
+          qpc_position = qpc_now_100ns();
+        }
+        buffer.push_timestamp(qpc_position);
+
+        // ăTv̒̉o؂ATvƏʂɖƂďށB
+        // ǉ̃foCX鎞Ɛ؂ւ̃NXtF[h͒ʏʂ菈
+        const bool silent = (flags & AUDCLNT_BUFFERFLAGS_SILENT) != 0;
+        if (silent && silent_input_frames >= resampler_flush_frames && endpoints.empty() &&
+            !self_output_cancellation && !migration_crossfade_pending && !next_resampler) {
+          {
+            TRACE_SCOPE("ReleaseBuffer");
+            backend->release_buffer(num_frames_available);
+          }
+          self_output_cancellation_active = false;
+          // TvʂƓo͂B[͎̃pPbg֎z
+          const UINT64 scaled = static_cast<UINT64>(num_frames_available) * output_sampling_rate + silent_output_remainder;
+          const size_t num_output_frames = static_cast<size_t>(scaled / sampling_rate);
+          silent_output_remainder = scaled % sampling_rate;
+          // ϊ̎}ϊɁAꂼ̃[gł̖̒o
+          fanout.process_silence(num_output_frames);
+          publish_to_consumers(true);
+          buffer.push_silence(num_output_frames, num_channels);
+          metrics::increment(metrics::Counter::SilentPackets);
+          packet_length = backend->get_next_packet_size();
+          continue;
+        }
+        if (silent) {
           ZeroMemory(fragment, sizeof(BYTE) * bit_per_sample / 8 * num_frames_available * num_channels);
+          silent_input_frames += num_frames_available;
+        } else {
+          silent_input_frames = 0;
+          silent_output_remainder = 0;
         }
 
+        const UINT64 resampler_start = metrics::now_microseconds();
         // Tv֓
-        resampler->write_buffer(fragment, sizeof(BYTE) * bit_per_sample / 8 * num_frames_available * num_channels);
+        {
+          TRACE_SCOPE("resampler write");
+          resampler->write_buffer(fragment, sizeof(BYTE) * bit_per_sample / 8 * num_frames_available * num_channels);
+          if (next_resampler) {
+            // i̐؂ւ́A̒ĩTvɂ͂ʂ
+            next_resampler->write_buffer(fragment, sizeof(BYTE) * bit_per_sample / 8 * num_frames_available * num_channels);
+          }
+        }
 
-        hr = capture_client->ReleaseBuffer(num_frames_available);
-        if (FAILED(hr)) {
-          throw std::runtime_error("Failed to release buffer.");
+        {
+          TRACE_SCOPE("ReleaseBuffer");
+          backend->release_buffer(num_frames_available);
         }
 
         // Tvo͂ƂĂ
         resampler_result.clear();
-        resampler->read_buffer(resampler_result);
-
-        for (size_t channel = 0; channel < num_channels; ++channel) {
-          deinterleave_buffer[channel].resize(resampler_result.size() / sizeof(float) * sizeof(BYTE) / num_channels);
-          for (size_t sample = channel; sample < deinterleave_buffer[channel].size() * num_channels; sample += num_channels) {
-            deinterleave_buffer[channel][sample / num_channels] = reinterpret_cast<float*>(resampler_result.data())[sample];
+        {
+          TRACE_SCOPE("resampler read");
+          resampler->read_buffer(resampler_result);
+          if (next_resampler) {
+            next_resampler_result.clear();
+            next_resampler->read_buffer(next_resampler_result);
+            blend_quality_switch(num_frames_available);
           }
+        }
+        metrics::record(metrics::Histogram::ResamplerTime, metrics::now_microseconds() - resampler_start);
 
-          {
-            std::lock_guard<std::mutex> lock(recording_data_mutex);
-            std::copy(deinterleave_buffer[channel].begin(), deinterleave_buffer[channel].end(), std::back_inserter(recording_data[channel]));
-
-            // Âf[^͎̂ĂBĐɎsƉr؂ꂷ
-            if (recording_data[channel].size() > max_buffer_size) {
-              for (size_t i = 0; i < recording_data[channel].size() - max_buffer_size; ++i) {
-                recording_data[channel].pop_front();
-              }
-            }
+        const size_t num_output_frames = resampler_result.size() / sizeof(float) / num_channels;
+        if (awaiting_first_packet && num_output_frames > 0) {
+          // ؂ւĂVfoCX̉oĂ܂ł̎
+          metrics::record(metrics::Histogram::MigrationGap, metrics::now_microseconds() - migration_switch_time);
+          awaiting_first_packet = false;
+        }
+        // ؂ւ̍ŏ̏o͂́AfoCX̖Əd˂ăNXtF[h
+        const bool crossfade = migration_crossfade_pending && num_output_frames > 0;
+        migration_crossfade_pending = migration_crossfade_pending && !crossfade;
+
+        const auto interleaved_output = reinterpret_cast<float*>(resampler_result.data());
+        for (size_t channel = 0; channel < num_channels; ++channel) {
+          deinterleave_buffer[channel].resize(num_output_frames);
+          for (size_t frame = 0; frame < num_output_frames; ++frame) {
+            deinterleave_buffer[channel][frame] = interleaved_output[frame * num_channels + channel];
           }
-          {
-            std::lock_guard<std::mutex> lock(analyzer_data_mutex);
-
-            // ͗pɃRs[
-            std::copy(deinterleave_buffer[channel].begin(),
-                      deinterleave_buffer[channel].end(),
-                      std::back_inserter(analyzer_data[channel]));
-            // Âf[^͎̂Ă
-            if (analyzer_data[channel].size() > max_buffer_size) {
-              for (size_t i = 0; i < analyzer_data[channel].size() - max_buffer_size; ++i) {
-                analyzer_data[channel].pop_front();
-              }
+        }
+        for (auto& endpoint : endpoints) {
+          endpoint->mix_into(deinterleave_buffer.data(), num_channels, qpc_position);
+        }
+        const bool cancel = self_output_cancellation.load();
+        if (cancel && !self_output_cancellation_active) {
+          self_output_canceller.reset();
+        }
+        self_output_cancellation_active = cancel;
+        if (cancel) {
+          metrics::scoped_timer timer(metrics::Histogram::EchoCancellerTime);
+          self_output_canceller.process(deinterleave_buffer.data(), num_channels);
+        }
+        if (!endpoints.empty() || cancel) {
+          // ^bvƋLɂĎ菜ʂn
+          for (size_t channel = 0; channel < num_channels; ++channel) {
+            for (size_t frame = 0; frame < num_output_frames; ++frame) {
+              interleaved_output[frame * num_channels + channel] = deinterleave_buffer[channel][frame];
             }
           }
         }
-        hr = capture_client->GetNextPacketSize(&packet_length);
-        if (FAILED(hr)) {
-          throw std::runtime_error("Failed to get next packet size.");
-        }
+
+        // o̓[ĝ܂܁Ap҂߂e[g֕ϊēnB[g̗p҂1̕ϊL
+        fanout.process(reinterpret_cast<const float*>(resampler_result.data()), num_output_frames);
+        publish_to_consumers(false);
+
+        buffer.push(deinterleave_buffer.data(), num_channels, crossfade);
+        packet_length = backend->get_next_packet_size();
       }
+      update_resampler_quality(fill_at_wake, !maintenance);
+      metrics::record(metrics::Histogram::PacketsPerWake, num_packets);
+      metrics::increment(metrics::Counter::CapturePackets, num_packets);
+      metrics::increment(metrics::Counter::CaptureFrames, total_frames);
     } catch (const std::exception&) {
-      request_reinitialize(sampling_rate);
+      metrics::increment(metrics::Counter::Reinitializations);
+      if (status == Status::Reinitializing) {
+        // ̂̂ɎsBfoCX߂܂ŏ҂ē[gł蒼
+        std::this_thread::sleep_for(std::chrono::milliseconds(33));
+      } else {
+        // o͑̃[gۂ܂܍蒼
+        request_reinitialize(output_sampling_rate);
+      }
     }
   }
+  CoUninitialize();
 }
 
 AudioDevice::~AudioDevice()
 {
+  stop_recording();
+  stop_shared_export();
   Finalize();
-  enumerator->UnregisterEndpointNotificationCallback(notification_client.get());
+  if (enumerator) {
+    enumerator->UnregisterEndpointNotificationCallback(notification_client.get());
+  }
 }
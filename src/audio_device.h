@@ -1,14 +1,23 @@
 #pragma once
 #include "MFT_resampler.h"
+#include "capture_buffer.h"
 #include "MM_notification_client.h"
+#include "capture_backend.h"
+#include "capture_pipeline.h"
+#include "endpoint_mixer.h"
+#include "stream_recorder.h"
+#include "shared_capture_export.h"
+#include "echo_canceller.h"
+#include "rate_fanout.h"
+#include "resampler_quality.h"
 #include <wrl/client.h>
 #include <mmdeviceapi.h>
 #include <Audioclient.h>
 #include <memory>
 #include <vector>
+#include <string>
 #include <array>
 #include <thread>
-#include <deque>
 #include <mutex>
 #include <atomic>
 
@@ -16,62 +25,196 @@ class AudioDevice
 {
 public:
   static const size_t max_channels = 2;
+  static const size_t max_buffer_size = 1024 * 10;
+  // pPbgTv֓ꂸɍς܂OɁAtB^ɎcoߒʂĂt[
+  static const size_t resampler_flush_frames = 1024;
+  // Tv̕i؂ւ鎞ɁAV̏o͂d˂钷
+  static const size_t quality_crossfade_frames = 1024;
 
   AudioDevice();
+  static void use_synthetic_capture(bool enabled);
   ~AudioDevice();
-  void initialize(
-    int buffer_length_millisec,
-    int output_sampling_rate);
+  // ^Xbhֈ˗Ă߂Bς݂˗ς݂Ȃ牽Ȃ
+  void start(int output_sampling_rate);
   void Finalize();
   void request_reinitialize(int sampling_rate);
+  // foCX̕ύXɌĂԁBĐ~߂ɗŐVfoCXJAubNEŐ؂ւ
+  void request_migration();
   bool is_initialized();
   int get_sampling_rate();
   int get_num_channels();
   Microsoft::WRL::ComPtr<IMMDevice> get_default_device();
-  float* get_buffer(int request_channel, int length);
-  std::array<std::vector<float>, max_channels> get_analyzer_data(size_t alignment);
+  // ProcessCallback 1񕪂̘^\[Xoutput֓ǂށBenabledłȂAlengthmax_buffer_size𒴂false
+  bool read_source(int channel, bool enabled, capture_buffer::reader& source, float* output, int length);
+  void get_buffer(int request_channel, capture_buffer::reader& source, float* output, int length);
+  // result͌ĂяoŊmۂĂBeʓŋlߑւ̂ŒԂł͊mۂȂ
+  size_t get_analyzer_data(size_t alignment, std::array<std::vector<float>, max_channels>& result, bool* silent = nullptr);
   void catch_up(int request_channel);
   void reset_buffer();
+  // S\[XȊԁAR[obNɌĂԁBҋ@^𑱂Ȃ璼߂̕c
+  void hold_standby();
+  void set_warm_standby(bool enabled);
   void reset_analyzer_data();
+  UINT64 get_sample_position();
+  float get_latency(LatencyConsumer consumer);
+  int get_latency_histogram(LatencyConsumer consumer, int* buckets, int length);
+  void reset_latency();
+  void set_concealment_mode(underrun_concealer::Mode mode);
+  void set_target_buffer_size(size_t samples);
+  // sampling_rate0Ȃo̓[gBo̓[gŕςĂA^͂Ō߂[ĝ܂ܑ
+  void start_recording(const std::string& path, int sampling_rate = 0, SampleFormat format = SampleFormat::Float32);
+  void stop_recording();
+  UINT64 get_recorded_frames();
+  UINT64 get_recording_dropped_frames();
+  // sampling_rate0Ȃo̓[gɏ]
+  void start_shared_export(const std::string& name, int sampling_rate = 0);
+  void stop_shared_export();
+  void publish_analyzer(const shared_capture::analyzer_snapshot& snapshot);
+  // ̓obt@̃[gBo̓[gƈႦΕϊ̎}珑ށB0ŉBAnalyzer̃XbhĂ
+  void set_analyzer_sampling_rate(int rate);
+  // o̓[gƂĂϊ̎}"rate <- parent method users\n"̌`ŕׂ
+  std::string describe_rate_fanout();
+  // foCXƓɘ^ĐfoCXǉBidIMMDevice::GetIdUTF-8A"synthetic:<ppm>"ŋ^^B
+  // ^𑵂ĊfoCX̉ɑ
+  void add_endpoint(const std::string& id, float gain);
+  void remove_endpoint(const std::string& id);
+  float get_endpoint_drift(const std::string& id);
+  // ĐfoCXIDƖO"id\tname\n"̌`ŕׂ
+  static std::string list_render_endpoints();
+  // Q[g̏o͂QƐMƂēnBI[fBIXbhĂ
+  void push_reference(const float* interleaved, size_t num_frames, int input_channels);
+  // ^Q[g̏o͂菜BLɂƒx̐ƊwK蒼
+  void set_self_output_cancellation(bool enabled);
+  long long get_self_output_delay();
+  float get_self_output_erle();
 
 private:
   enum class Status
   {
     Reinitializing,
     Constructed,
-    Preparing,
-    Playing,
+    Running,
     Stopped,
   };
 
   void run();
+  void initialize(
+    int buffer_length_millisec,
+    int output_sampling_rate);
+  void create_enumerator();
+  // endpoint_idȂfoCX
+  std::unique_ptr<capture_pipeline> create_pipeline(int buffer_length_millisec, int output_sampling_rate, const std::string& endpoint_id);
+  void adopt_pipeline(capture_pipeline& pipeline);
+  void reserve_work_buffers();
+  void build_migration_pipeline();
+  void switch_pipeline();
+  void stop_recording_locked();
+  void stop_shared_export_locked();
+  void wait_for_taps();
+  // i̐؂ւB쐬͗̃XbhōsAł狌TvƕĂNXtF[hŏ芷
+  void start_quality_worker();
+  void build_quality_resampler(int tier, int generation, capture_format format, int output_sampling_rate);
+  void begin_quality_switch();
+  void blend_quality_switch(size_t num_input_frames);
+  // N̏IɖĂԁBmeasurefalse̋N(ď؂ւ)ׂ͕̌v̋؂ɂg
+  void update_resampler_quality(size_t fill_at_wake, bool measure);
+  // fanout֗ɌĂсAõ^bvƋLAʃ[g̉̓obt@ւꂼ̃[g̉n
+  void publish_to_consumers(bool silent);
 
   Microsoft::WRL::ComPtr<IMMDeviceEnumerator> enumerator;
   Microsoft::WRL::ComPtr<IMMDevice> device;
-  Microsoft::WRL::ComPtr<IAudioClient> audio_client;
-  Microsoft::WRL::ComPtr<IAudioCaptureClient> capture_client;
+  std::unique_ptr<capture_backend> backend;
   std::unique_ptr<MM_notification_client> notification_client;
   std::atomic<Status> status;
   int sampling_rate;
-  int sampling_rate_reinitialize;
+  std::atomic<int> sampling_rate_reinitialize;
   int num_channels;
   int bit_per_sample;
   UINT32 buffer_frame_count;
-  std::vector<std::deque<float>> recording_data;
-  std::mutex recording_data_mutex;
-
-  // Đrbg[g肪܂ł́A̓obt@ʂɎB
-  std::array<std::deque<float>, max_channels> analyzer_data;
-  std::mutex analyzer_data_mutex;
+  // ^obt@ƍĐJn̑ҋ@Bo̓[gƘ^Ŏ
+  capture_buffer buffer;
+  // initializeŘ^XbhAڍs̃[J[add_endpoinťĂяoǂ
+  std::atomic<int> output_sampling_rate;
 
-  std::vector<float> pass_buffer;
-  std::vector<float> zero_buffer;
   std::vector<BYTE> resampler_result;
 
-  static const size_t max_buffer_size = 1024 * 10;
-  static const size_t prepare_buffer_size = 1024 * 3;
   std::array<std::vector<float>, max_channels> deinterleave_buffer;
 
+  // pPbg̏ȗBăTv֓ꂽ̃t[ƁAȗ̏o̓t[̒[
+  UINT64 silent_input_frames;
+  UINT64 silent_output_remainder;
+
+  // ^Xbhactive_tap/active_shared_exportB~tap_in_usê҂Ăj
+  std::unique_ptr<stream_recorder> stream_tap;
+  std::unique_ptr<shared_capture_export> shared_export;
+  std::mutex tap_mutex;
+  std::atomic<stream_recorder*> active_tap;
+  std::atomic<shared_capture_export*> active_shared_export;
+  std::atomic<bool> tap_in_use;
+  UINT64 last_recorded_frames;
+  // 0Ȃo̓[g
+  std::atomic<int> shared_export_sampling_rate;
+
+  // pҖ̃[gւ̕ϊB^Xbh1̋N̊fanout.get_mutex()
+  rate_fanout fanout;
+  // set_analyzer_sampling_rateŗṽ[g
+  int analyzer_sampling_rate;
+
+  // foCX؂ւBmigration_mutexprepared_pipelineƉ2̃tOی삷
+  std::mutex migration_mutex;
+  std::thread migration_worker;
+  bool migration_requested;
+  bool migration_running;
+  std::unique_ptr<capture_pipeline> prepared_pipeline;
+  std::atomic<bool> pipeline_ready;
+  // ȉ͘^XbhG
+  bool migration_crossfade_pending;
+  bool awaiting_first_packet;
+  UINT64 migration_switch_time;
+
+  // ǉŘ^foCXB^Xbh1̋N̊endpoints_mutex
+  std::mutex endpoints_mutex;
+  std::vector<std::unique_ptr<endpoint_mixer>> endpoints;
+
+  // ȏo͂̏Becho_canceller͘^XbhG
+  reference_ring self_reference;
+  echo_canceller self_output_canceller;
+  std::atomic<bool> self_output_cancellation;
+  bool self_output_cancellation_active;
+
+  // Tv̕iBresampler_tier͍̃Tv̒iŁAV^̑g̒iō
+  std::atomic<int> resampler_tier;
+  capture_format resampler_format;
+  // quality_mutexprepared_resamplerprepared_generationی삷
+  std::mutex quality_mutex;
+  std::thread quality_worker;
+  std::unique_ptr<MFT_resampler> prepared_resampler;
+  int prepared_generation;
+  std::atomic<bool> resampler_ready;
+  std::atomic<bool> quality_build_failed;
+  // [J[Ō܂Ői񂾂trueB^Xbh͂ĂjoinA쐬̃[J[҂Ȃ
+  std::atomic<bool> quality_worker_done;
+  // ȉ͘^XbhG
+  resampler_quality_controller quality_controller;
+  // 쐬̒iB-1Ȃ؂ւĂȂBgeneration͘^̑gւƈ˗ɐi߁AÂ˗̌ʂ̂Ă
+  int quality_pending_tier;
+  int quality_generation;
+  bool quality_build_requested;
+  std::unique_ptr<MFT_resampler> next_resampler;
+  std::unique_ptr<MFT_resampler> retired_resampler;
+  std::vector<BYTE> next_resampler_result;
+  UINT64 next_primed_frames;
+  size_t quality_crossfade_position;
+  // iɃtB^̒xႤ̂ŁAx̒Z̏o͂̍x点Ăd˂B
+  // ȉ2͂܂oĂȂƐV̏o(C^[[u)ŁAx点Ă镪ƁAV̏o͂̒̂z
+  std::vector<float> quality_current_frames;
+  std::vector<float> quality_next_frames;
+  size_t quality_current_delay;
+  size_t quality_next_delay;
+  // ׂ̌v̋؂B^XbhCPUTCNƃ^CX^vJE^̒l
+  UINT64 load_thread_cycles;
+  UINT64 load_timestamp_cycles;
+
   std::thread recorder;
   std::unique_ptr<MFT_resampler> resampler;
 };
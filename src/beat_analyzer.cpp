@@ -0,0 +1,290 @@
+#include "beat_analyzer.h"
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+
+namespace dsp
+{
+void merge_channel(
+  std::vector<float>& left,
+  const std::vector<float>& right)
+{
+  assert(left.size() == right.size());
+  for (size_t i = 0; i < left.size(); ++i) {
+    left[i] += right[i];
+    left[i] /= 2.0f;
+  }
+}
+
+float vu_amp(const float* begin,
+             const float* end)
+{
+  auto max_amp = -1.0f;
+  auto min_amp = 1.0f;
+  for (auto iter = begin; iter != end; ++iter) {
+    if (*iter > max_amp) {
+      max_amp = *iter;
+    }
+    if (*iter < min_amp) {
+      min_amp = *iter;
+    }
+  }
+  return max_amp - min_amp;
+}
+
+// Œ蒷̑1炵ĖvalueBdequeƈႢmۂȂ
+void shift_in(std::vector<float>& window, float value)
+{
+  std::copy(window.begin() + 1, window.end(), window.begin());
+  window.back() = value;
+}
+
+float rms(const float* begin,
+          const float* end)
+{
+  auto result = 0.0f;
+  for (auto iter = begin; iter != end; ++iter) {
+    result += powf(*iter, 2.0f);
+  }
+  return sqrtf(result / (float)std::distance(begin, end));
+}
+
+}
+
+beat_analyzer::beat_analyzer(int sampling_rate)
+  : bpm(0.0f)
+  , milliseconds_to_next_beat(0.0f)
+  , sampling_rate(sampling_rate)
+  , beat_interval((float)min_interval)
+  , bpm_changed(false)
+  , silent_vu(0)
+  , silent_rms(0)
+{
+  vu_bin.resize(window_size);
+  rms_bin.resize(window_size);
+  bpm_score.fill(0.0);
+  bpm_score_frame.fill(0.0);
+}
+
+float beat_analyzer::get_bpm()
+{
+  return bpm;
+}
+
+float beat_analyzer::get_bpm_vu(int index)
+{
+  return vu_bin[index];
+}
+
+float beat_analyzer::get_bpm_score(int index)
+{
+  return (float)bpm_score[index];
+}
+
+float beat_analyzer::get_rms(int index)
+{
+  return rms_bin[index];
+}
+
+float beat_analyzer::get_milliseconds_to_next_beat()
+{
+  return milliseconds_to_next_beat;
+}
+
+int beat_analyzer::get_sampling_rate()
+{
+  return sampling_rate;
+}
+
+void beat_analyzer::reset()
+{
+  std::fill(vu_bin.begin(), vu_bin.end(), 0.0f);
+  std::fill(bpm_score.begin(), bpm_score.end(), 0.0);
+  bpm = 0.0f;
+  silent_vu = 0;
+  silent_rms = 0;
+}
+
+void beat_analyzer::rebase(size_t keep_packets)
+{
+  // ŐȂVU0ɂB0͑SĂ̊ԊũXRAقړŉ邾Ȃ̂ŁAcVU̔I΂
+  const size_t keep = keep_packets < vu_bin.size() ? keep_packets : vu_bin.size();
+  std::fill(vu_bin.begin(), vu_bin.end() - keep, 0.0f);
+  std::fill(bpm_score.begin(), bpm_score.end(), 0.0);
+  update_score();
+  update_tempo();
+  update_phase(0, true);
+}
+
+void beat_analyzer::process(const std::vector<float>& left, const std::vector<float>& right)
+{
+  assert(left.size() == right.size() && left.size() % packet_size == 0);
+  if (left.empty()) {
+    return;
+  }
+
+  for (size_t head = 0; head < left.size(); head += packet_size) {
+    push_vu(measure_vu(left.data() + head, right.data() + head));
+    push_rms(measure_rms(left.data() + head, right.data() + head));
+    update_score();
+  }
+  update_tempo();
+  update_phase(left.size(), false);
+}
+
+void beat_analyzer::process_silence(size_t num_samples)
+{
+  assert(num_samples % packet_size == 0);
+  if (num_samples == 0) {
+    return;
+  }
+
+  for (size_t head = 0; head < num_samples && (silent_vu < window_size || silent_rms < window_size); head += packet_size) {
+    push_vu(0.0f);
+    push_rms(0.0f);
+    update_score();
+  }
+  update_tempo();
+  update_phase(num_samples, false);
+}
+
+float beat_analyzer::measure_vu(const float* left, const float* right)
+{
+  return (dsp::vu_amp(left, left + packet_size) + dsp::vu_amp(right, right + packet_size)) / 4.0f;
+}
+
+float beat_analyzer::measure_rms(const float* left, const float* right)
+{
+  return (dsp::rms(left, left + packet_size) + dsp::rms(right, right + packet_size)) / 2.0f;
+}
+
+void beat_analyzer::push_vu(float vu)
+{
+  silent_vu = vu == 0.0f ? silent_vu + 1 : 0;
+  dsp::shift_in(vu_bin, vu);
+  assert(vu_bin.size() == window_size);
+}
+
+void beat_analyzer::push_rms(float rms)
+{
+  silent_rms = rms == 0.0f ? silent_rms + 1 : 0;
+  dsp::shift_in(rms_bin, rms);
+  assert(rms_bin.size() == window_size);
+}
+
+void beat_analyzer::update_score()
+{
+  int max_score_index = 0;
+  auto max_score = 0.0;
+  auto min_score = (double)INFINITY;
+  for (int interval = min_interval;
+       interval <= max_interval;
+       ++interval) {
+    auto score = 0.0;
+    auto count = 0.0;
+    for (int index = window_size - 1;
+         index >= 0;
+         index -= interval) {
+      score += vu_bin[index];
+      count++;
+    }
+    assert(count > 0.0);
+    score /= count;
+    bpm_score_frame[interval - min_interval] = score;
+    if (score > max_score) {
+      max_score_index = interval - min_interval;
+      max_score = score;
+    }
+    if (score < min_score) {
+      min_score = score;
+    }
+  }
+
+  if (max_score - min_score <= 1.0e-5) {
+    // ꍇ̓Zbg
+    std::fill(bpm_score_frame.begin(),
+              bpm_score_frame.end(),
+              0.0);
+    std::fill(bpm_score.begin(),
+              bpm_score.end(),
+              0.0);
+  } else {
+    // bpm_score_frame[0.0, 1.0]͈̔͂ɕϊ
+    // bpm_score_frame = (bpm_score_frame - min_score) / (max_score - min_score);
+    std::transform(bpm_score_frame.begin(),
+                   bpm_score_frame.end(),
+                   bpm_score_frame.begin(),
+                   [=](double x) { return (x - min_score) / -(max_score - min_score); });
+
+    // Z͈͐˗͐ݒ
+    if (max_score_index - 2 >= 0) {
+      bpm_score_frame[max_score_index - 2] = 0.0;
+    }
+    if (max_score_index - 1 >= 0) {
+      bpm_score_frame[max_score_index - 1] = 0.0;
+    }
+    if (max_score_index + 1 < bpm_score_frame.size()) {
+      bpm_score_frame[max_score_index + 1] = 0.0;
+    }
+    if (max_score_index + 2 < bpm_score_frame.size()) {
+      bpm_score_frame[max_score_index + 2] = 0.0;
+    }
+
+    // bpm_score += bpm_score_frame;
+    std::transform(bpm_score_frame.begin(),
+                   bpm_score_frame.end(),
+                   bpm_score.begin(),
+                   bpm_score.begin(),
+                   [](double x, double y) { return x + y * 0.999; });
+  }
+}
+
+void beat_analyzer::update_tempo()
+{
+  size_t max_index = 0;
+  for (size_t index = 0; index < bpm_score.size(); ++index) {
+    if (bpm_score[index] > bpm_score[max_index]) {
+      max_index = index;
+    }
+  }
+
+  beat_interval = (float)max_index + min_interval;
+  const float packet_per_minute = sampling_rate / (float)packet_size * 60.0f;
+  const float new_bpm = packet_per_minute / beat_interval;
+  bpm_changed = new_bpm != bpm;
+  bpm = new_bpm;
+}
+
+void beat_analyzer::update_phase(size_t elapsed_samples, bool relocate)
+{
+  const float max_score_interval = beat_interval;
+
+  // ŏ̔
+  if (bpm_changed || relocate) {
+    size_t max_first_beat_score_offset = 0;
+    double max_first_beat_score = 0.0;
+    for (size_t offset = 0; offset < max_score_interval; ++offset) {
+      double score = 0.0;
+      for (size_t index = offset; index < window_size; index += (size_t)max_score_interval) {
+        score += vu_bin[index];
+      }
+      if (score > max_first_beat_score) {
+        max_first_beat_score = score;
+        max_first_beat_score_offset = offset;
+      }
+    }
+    const float sample_to_next_beat = (float)max_first_beat_score_offset * packet_size;
+    milliseconds_to_next_beat = sample_to_next_beat / (float)sampling_rate * 1000.0f;
+  } else {
+    const float previous_milliseconds_to_next_beat = milliseconds_to_next_beat;
+    const float previous_samples_to_next_beat = previous_milliseconds_to_next_beat * (float)sampling_rate / 1000.0f;
+    float samples_to_next_beat = previous_samples_to_next_beat - (float)elapsed_samples;
+    const float bpm_interval_milliseconds = 1.0f / (bpm / 60.0f / 1000.0f);
+    const float bpm_interval_samples = bpm_interval_milliseconds * (float)sampling_rate / 1000.0f;
+    while (samples_to_next_beat < 0.0) {
+      samples_to_next_beat += bpm_interval_samples;
+    }
+    milliseconds_to_next_beat = samples_to_next_beat / (float)sampling_rate * 1000.0f;
+  }
+}
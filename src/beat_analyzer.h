@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <array>
+
+// VU/RMS̗BPMƎ̔܂ł̎Ԃ߂͕B
+// ^foCXɂ͈ˑApacket_size̔{̃XeIMɓnΓʂɂȂ̂ŁAItC͂g
+class beat_analyzer
+{
+public:
+  static const int packet_size = 256;
+  static const int window_size = 2000;
+  static const int min_interval = 45;
+  static const int max_interval = 180;
+
+  explicit beat_analyzer(int sampling_rate);
+  float get_bpm();
+  float get_bpm_vu(int index);
+  float get_bpm_score(int index);
+  float get_rms(int index);
+  float get_milliseconds_to_next_beat();
+  int get_sampling_rate();
+  void reset();
+  // Ȃ؂ւɌĂԁBkeep_packetsÂVUBPMXRÂāAcVUŃXRAtĔT
+  void rebase(size_t keep_packets);
+  // left/rightpacket_size̔{̒B[͌ĂяoŎ֎z
+  void process(const std::vector<float>& left, const std::vector<float>& right);
+  // num_samples(packet_size̔{)̖procesŝƓʂɂB
+  // Ŗ܂͏ԂςȂ̂ŁÄʒui߂ĎcȂ
+  void process_silence(size_t num_samples);
+
+  // 1pPbg(packet_size)VURMS
+  static float measure_vu(const float* left, const float* right);
+  static float measure_rms(const float* left, const float* right);
+  // ȉfeature_graphʖɕČĂԁBprocess͊epPbgpush_vu, push_rms, update_scoreA
+  // Ōupdate_tempo, update_phaseĂԂ̂Ɠ
+  void push_vu(float vu);
+  void push_rms(float rms);
+  // ŐVVȖBPMXRAXV
+  void update_score();
+  // BPMXRABPM߂
+  void update_tempo();
+  // elapsed_samplesi񂾌̎̔܂ł̎Ԃ߂BBPMςrelocateȂAVU̗甏̈ʒuT
+  void update_phase(size_t elapsed_samples, bool relocate);
+
+private:
+  // window_sizeŒBÂɕсAŐV
+  std::vector<float> vu_bin;
+  std::vector<float> rms_bin;
+  std::array<double, max_interval - min_interval + 1> bpm_score;
+  std::array<double, max_interval - min_interval + 1> bpm_score_frame;
+  float bpm;
+  float milliseconds_to_next_beat;
+  int sampling_rate;
+  // Oupdate_tempoŌ߂̊Ԋu[pPbg]ƁABPMς
+  float beat_interval;
+  bool bpm_changed;
+  // ēVURMS̐
+  int silent_vu;
+  int silent_rms;
+};
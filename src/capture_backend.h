@@ -0,0 +1,26 @@
+#pragma once
+#include <windows.h>
+
+struct capture_format
+{
+  int sampling_rate;
+  int num_channels;
+  int bit_per_sample;
+  int block_align;
+  int avg_bytes_per_sec;
+};
+
+// ^̒ہBAudioDevice::run()^XbhŌĂ΂
+class capture_backend
+{
+public:
+  virtual ~capture_backend() {}
+
+  virtual capture_format get_format() = 0;
+  virtual UINT32 get_buffer_frame_count() = 0;
+  virtual UINT32 get_next_packet_size() = 0;
+  // qpc_position͐擪t[̘^ [100ns]
+  virtual void get_buffer(BYTE** fragment, UINT32* num_frames_available, DWORD* flags, UINT64* device_position, UINT64* qpc_position) = 0;
+  virtual void release_buffer(UINT32 num_frames) = 0;
+  virtual void stop() = 0;
+};
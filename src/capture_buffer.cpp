@@ -0,0 +1,433 @@
+#include "capture_buffer.h"
+#include "metrics.h"
+#include "trace.h"
+#include <algorithm>
+#include <climits>
+#include <cassert>
+
+capture_buffer::capture_buffer(size_t capacity)
+  : capacity(capacity)
+  , state(State::Stopped)
+  , num_channels(0)
+  , recording_data(max_channels, ring_buffer(capacity))
+  , sampling_rate(0)
+  , sample_position(0)
+  , analyzer_data(max_channels, ring_buffer(capacity))
+  , analyzer_sampling_rate(0)
+  , target_buffer_size(1024 * 3)
+  , concealment_mode(underrun_concealer::Mode::Extend)
+  , reader_generation(1)
+  , warm_standby(true)
+  , underruns(0)
+  , enabled_channels(0)
+{
+  recording_write_position.fill(0);
+  analyzer_write_position.fill(0);
+  analyzer_input.resize(capacity);
+}
+
+void capture_buffer::start(int sampling_rate, size_t num_channels)
+{
+  {
+    // Tvʒu͒P̂܂܁AÂ[g̘^̂Ă
+    std::lock_guard<std::mutex> lock(recording_data_mutex);
+    this->sampling_rate = sampling_rate;
+    this->num_channels = num_channels;
+    timeline.clear();
+  }
+  state = State::Preparing;
+}
+
+void capture_buffer::stop()
+{
+  state = State::Stopped;
+}
+
+void capture_buffer::push_timestamp(UINT64 qpc_position)
+{
+  std::lock_guard<std::mutex> lock(recording_data_mutex);
+  timeline.push(capture_timestamp{recording_write_position[0], qpc_position});
+}
+
+size_t capture_buffer::push(std::vector<float>* channels, size_t num_channels, bool crossfade)
+{
+  size_t dropped = 0;
+  for (size_t channel = 0; channel < num_channels && channel < max_channels; ++channel) {
+    const segment input{channels[channel].data(), channels[channel].size()};
+    dropped += push_channel(channel, &input, input.length, crossfade);
+  }
+  sample_position = recording_write_position[0];
+  return dropped;
+}
+
+size_t capture_buffer::push_silence(size_t length, size_t num_channels)
+{
+  size_t dropped = 0;
+  for (size_t channel = 0; channel < num_channels && channel < max_channels; ++channel) {
+    dropped += push_channel(channel, nullptr, length, false);
+  }
+  sample_position = recording_write_position[0];
+  return dropped;
+}
+
+size_t capture_buffer::push_channel(size_t channel, const segment* input, size_t length, bool crossfade)
+{
+  size_t dropped = 0;
+  {
+    TRACE_SCOPE("ring push");
+    std::lock_guard<std::mutex> lock(recording_data_mutex);
+    // Âf[^̓O㏑Ď̂ĂBĐɋNƉr؂ꂷ
+    const size_t free_length = recording_data[channel].capacity() - recording_data[channel].size();
+    if (length > free_length) {
+      metrics::increment(metrics::Counter::OverflowDrops, length - free_length);
+      dropped = length - free_length;
+    }
+    size_t overlap = 0;
+    if (input == nullptr) {
+      recording_data[channel].push_silence(length);
+    } else if (crossfade) {
+      overlap = recording_data[channel].overlap_front(*input, crossfade_length);
+    } else {
+      recording_data[channel].push_front(*input);
+    }
+    recording_write_position[channel] += length - overlap;
+    if (channel == 0) {
+      metrics::record(metrics::Histogram::RingFill, recording_data[channel].size());
+    }
+  }
+  if (analyzer_follows_recording()) {
+    std::lock_guard<std::mutex> lock(analyzer_data_mutex);
+    push_analyzer_channel(channel, input, length, crossfade);
+  }
+  return dropped;
+}
+
+void capture_buffer::push_analyzer_channel(size_t channel, const segment* input, size_t length, bool crossfade)
+{
+  // ͗pɃRs[BÂf[^̓O㏑Ď̂Ă
+  const size_t free_length = analyzer_data[channel].capacity() - analyzer_data[channel].size();
+  if (length > free_length) {
+    metrics::increment(metrics::Counter::AnalyzerDrops, length - free_length);
+  }
+  size_t overlap = 0;
+  if (input == nullptr) {
+    analyzer_data[channel].push_silence(length);
+  } else if (crossfade) {
+    overlap = analyzer_data[channel].overlap_front(*input, crossfade_length);
+  } else {
+    analyzer_data[channel].push_front(*input);
+  }
+  analyzer_write_position[channel] += length - overlap;
+}
+
+void capture_buffer::push_analyzer(const float* interleaved, size_t num_frames, size_t num_channels)
+{
+  if (analyzer_follows_recording()) {
+    return;
+  }
+  num_frames = num_frames < analyzer_input.size() ? num_frames : analyzer_input.size();
+  std::lock_guard<std::mutex> lock(analyzer_data_mutex);
+  for (size_t channel = 0; channel < num_channels && channel < max_channels; ++channel) {
+    if (interleaved == nullptr) {
+      push_analyzer_channel(channel, nullptr, num_frames, false);
+      continue;
+    }
+    for (size_t frame = 0; frame < num_frames; ++frame) {
+      analyzer_input[frame] = interleaved[frame * num_channels + channel];
+    }
+    const segment input{analyzer_input.data(), num_frames};
+    push_analyzer_channel(channel, &input, num_frames, false);
+  }
+}
+
+void capture_buffer::set_analyzer_sampling_rate(int rate)
+{
+  std::lock_guard<std::mutex> recording_lock(recording_data_mutex);
+  std::lock_guard<std::mutex> analyzer_lock(analyzer_data_mutex);
+  analyzer_sampling_rate = rate;
+  // ^悤A݈ʒuV[gɊZđ
+  const int effective_rate = rate != 0 ? rate : sampling_rate;
+  for (size_t channel = 0; channel < max_channels; ++channel) {
+    analyzer_data[channel].clear();
+    analyzer_write_position[channel] = sampling_rate > 0 ?
+      recording_write_position[channel] * effective_rate / sampling_rate : recording_write_position[channel];
+  }
+}
+
+int capture_buffer::get_analyzer_sampling_rate()
+{
+  const int rate = analyzer_sampling_rate;
+  return rate != 0 ? rate : sampling_rate;
+}
+
+bool capture_buffer::analyzer_follows_recording()
+{
+  const int rate = analyzer_sampling_rate;
+  return rate == 0 || rate == sampling_rate;
+}
+
+bool capture_buffer::read_source(int channel, bool enabled, reader& source, float* output, size_t length)
+{
+  const unsigned int bit = 1u << channel;
+  const unsigned int previous = enabled ? enabled_channels.fetch_or(bit) : enabled_channels.fetch_and(~bit);
+  if (previous == 0) {
+    hold_standby();
+  } else if ((previous & bit) == 0 && !enabled) {
+    catch_up(channel);
+  }
+  if (!enabled) {
+    return false;
+  }
+  get_buffer(channel, source, output, length);
+  return true;
+}
+
+void capture_buffer::get_buffer(int request_channel, reader& source, float* output, size_t length)
+{
+  assert(length <= capacity);
+  const unsigned int generation = reader_generation;
+  if (source.generation != generation) {
+    source.concealer.reset();
+    source.concealer.set_mode(concealment_mode);
+    source.generation = generation;
+  }
+
+  // cʂ̊mFƓǂݏo1̃bNōsBԂɑ̃\[X^Xbhk߂Ăǂ݉߂Ȃ
+  bool popped = false;
+  {
+    std::lock_guard<std::mutex> lock(recording_data_mutex);
+    const size_t recording_data_size = recording_data[request_channel].size();
+
+    // ^obt@ɏ\ȉf[^W܂܂Ŗ𗬂đҋ@
+    switch (state) {
+    case State::Preparing:
+      if (recording_data_size < target_buffer_size) {
+        std::fill(output, output + length, 0.0f);
+        return;
+      } else {
+        // ^Xbh~߂Ȃ~߂܂܂ɂ
+        State expected = State::Preparing;
+        if (!state.compare_exchange_strong(expected, State::Playing)) {
+          std::fill(output, output + length, 0.0f);
+          return;
+        }
+      }
+      // Đ֑Jڂ̂break̂܂܎s
+    case State::Playing:
+      if (recording_data_size >= length) {
+        TRACE_SCOPE("ring pop");
+        record_latency(LatencyConsumer::Spatializer, recording_write_position[request_channel] - recording_data_size);
+        recording_data[request_channel].pop_back_to(output, length);
+        popped = true;
+      }
+      break;
+    default:
+      std::fill(output, output + length, 0.0f);
+      return;
+    }
+  }
+
+  if (!popped) {
+    // ^ԂɍĂȂBO̔g`Ŗ߂ēr؂ڗȂ
+    ++underruns;
+    metrics::increment(metrics::Counter::Underruns);
+    metrics::increment(metrics::Counter::ConcealedSamples, source.concealer.conceal(output, length));
+    return;
+  }
+  source.concealer.process(output, length);
+}
+
+size_t capture_buffer::get_analyzer_data(size_t alignment, std::array<std::vector<float>, max_channels>& result, bool* silent)
+{
+  if (silent != nullptr) {
+    *silent = false;
+  }
+  UINT64 read_position;
+  size_t result_size = INT_MAX;
+  {
+    std::lock_guard<std::mutex> lock(analyzer_data_mutex);
+    // \ȉf[^W܂܂ŃXLbv
+    if (analyzer_data[0].size() < alignment) {
+      for (auto& channel : result) {
+        channel.clear();
+      }
+      return 0;
+    }
+
+    read_position = analyzer_write_position[0] - analyzer_data[0].size();
+    metrics::record(metrics::Histogram::AnalyzerBacklog, analyzer_data[0].size());
+    // e`l̂ŏ̃ACς݃TCYvZ
+    for (size_t channel = 0; channel < max_channels; ++channel) {
+      size_t size = analyzer_data[channel].size() - (analyzer_data[channel].size() % alignment);
+      if (size < result_size) {
+        result_size = size;
+      }
+    }
+    assert(result_size % alignment == 0);
+
+    if (silent != nullptr && std::all_of(analyzer_data.begin(), analyzer_data.end(), [](ring_buffer& x) { return x.is_silent(); })) {
+      // Ȃ璆gǂޕKvȂBi߂
+      for (size_t channel = 0; channel < max_channels; ++channel) {
+        result[channel].clear();
+        analyzer_data[channel].pop_back(result_size);
+      }
+      *silent = true;
+    } else {
+      for (size_t channel = 0; channel < max_channels; ++channel) {
+        result[channel].resize(result_size);
+        analyzer_data[channel].pop_back_to(result[channel].data(), result_size);
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(recording_data_mutex);
+    const int rate = analyzer_sampling_rate;
+    if (rate != 0 && rate != sampling_rate) {
+      // ^͘^̃[gň
+      read_position = read_position * sampling_rate / rate;
+    }
+    record_latency(LatencyConsumer::Analyzer, read_position);
+  }
+  return result_size;
+}
+
+void capture_buffer::catch_up(int request_channel)
+{
+  TRACE_SCOPE("catch_up");
+  std::lock_guard<std::mutex> lock(recording_data_mutex);
+  auto min_size = recording_data[0].size();
+  for (size_t channel = 0; channel < num_channels && channel < max_channels; ++channel) {
+    auto size = recording_data[channel].size();
+    if (size < min_size) {
+      min_size = size;
+    }
+  }
+
+  recording_data[request_channel].pop_back(recording_data[request_channel].size() - min_size);
+}
+
+void capture_buffer::reset_buffer()
+{
+  TRACE_SCOPE("reset_buffer");
+  {
+    std::lock_guard<std::mutex> lock(recording_data_mutex);
+    for (auto& recording_channel : recording_data) {
+      recording_channel.clear();
+    }
+  }
+  ++reader_generation;
+  // ^Xbh~߂Ԃ㏑Ȃ
+  State expected = State::Playing;
+  state.compare_exchange_strong(expected, State::Preparing);
+}
+
+void capture_buffer::hold_standby()
+{
+  if (!warm_standby) {
+    reset_buffer();
+    return;
+  }
+
+  // ^͎~߂ɍĐJnƓʂcĂA\[XLɂȂ̃ubN炷
+  TRACE_SCOPE("hold_standby");
+  bool ready = true;
+  {
+    const size_t target = target_buffer_size;
+    std::lock_guard<std::mutex> lock(recording_data_mutex);
+    for (size_t channel = 0; channel < max_channels; ++channel) {
+      const size_t size = recording_data[channel].size();
+      if (size > target) {
+        recording_data[channel].pop_back(size - target);
+      } else if (size < target) {
+        ready = false;
+      }
+    }
+  }
+  ++reader_generation;
+  State expected = ready ? State::Preparing : State::Playing;
+  state.compare_exchange_strong(expected, ready ? State::Playing : State::Preparing);
+}
+
+void capture_buffer::reset_analyzer_data()
+{
+  std::lock_guard<std::mutex> lock(analyzer_data_mutex);
+  for (auto& channel : analyzer_data) {
+    channel.clear();
+  }
+}
+
+void capture_buffer::set_warm_standby(bool enabled)
+{
+  warm_standby = enabled;
+}
+
+void capture_buffer::set_concealment_mode(underrun_concealer::Mode mode)
+{
+  concealment_mode = mode;
+  ++reader_generation;
+}
+
+void capture_buffer::set_target_buffer_size(size_t samples)
+{
+  target_buffer_size = samples < capacity ? samples : capacity;
+}
+
+size_t capture_buffer::get_target_buffer_size()
+{
+  return target_buffer_size;
+}
+
+size_t capture_buffer::get_capacity()
+{
+  return capacity;
+}
+
+capture_buffer::State capture_buffer::get_state()
+{
+  return state;
+}
+
+size_t capture_buffer::get_size(int channel)
+{
+  std::lock_guard<std::mutex> lock(recording_data_mutex);
+  return recording_data[channel].size();
+}
+
+UINT64 capture_buffer::get_sample_position()
+{
+  return sample_position;
+}
+
+UINT64 capture_buffer::get_underruns()
+{
+  return underruns;
+}
+
+float capture_buffer::get_latency(LatencyConsumer consumer)
+{
+  return latency[static_cast<size_t>(consumer)].get_latest();
+}
+
+int capture_buffer::get_latency_histogram(LatencyConsumer consumer, int* buckets, int length)
+{
+  return latency[static_cast<size_t>(consumer)].copy_buckets(buckets, length);
+}
+
+void capture_buffer::reset_latency()
+{
+  for (auto& histogram : latency) {
+    histogram.reset();
+  }
+}
+
+void capture_buffer::record_latency(LatencyConsumer consumer, UINT64 read_position)
+{
+  // recording_data_mutexԂŌĂԂ
+  UINT64 qpc_position;
+  if (sampling_rate == 0 || !timeline.find(read_position, sampling_rate, &qpc_position)) {
+    return;
+  }
+  const UINT64 now = qpc_now_100ns();
+  const float milliseconds = now > qpc_position ? static_cast<float>(now - qpc_position) / 10000.0f : 0.0f;
+  latency[static_cast<size_t>(consumer)].record(milliseconds);
+}
@@ -0,0 +1,136 @@
+#pragma once
+#include "ring_buffer.h"
+#include "capture_latency.h"
+#include "underrun_concealer.h"
+#include <windows.h>
+#include <vector>
+#include <array>
+#include <mutex>
+#include <atomic>
+
+// ^Xbh݁AI[fBIXbhAnalyzerǂݏo^obt@ƁAĐJn̑ҋ@ԁB
+// foCXXbhȂ̂ŁASoakSimulator^vŋ쓮ēr؂Čł
+class capture_buffer
+{
+public:
+  static const size_t max_channels = 2;
+  // foCX؂ւɋfoCX̖Əd˂钷
+  static const size_t crossfade_length = 256;
+
+  enum class State : int
+  {
+    Stopped,    // ^ĂȂBԂ
+    Preparing,  // target_buffer_size܂ŗ܂̂҂BԂ
+    Playing,
+  };
+
+  // \[X̓ǂݏȍԁB\[X1Ã\[Xread_source炾gB
+  // r؂̕Ԃ͒Oɓǂ񂾔g`̂ŁA\[XmŋLƕʂ̃\[X̉
+  struct reader
+  {
+    reader() : generation(0) {}
+    underrun_concealer concealer;
+    // Ōɍ킹reader_generationBႦΕԂ̏Ԃ̂āÃ[hɍ킹
+    unsigned int generation;
+  };
+
+  // capacity̓`l̃O̒BŊmۂAȍ~͊mۂȂ
+  explicit capture_buffer(size_t capacity);
+
+  // ^()ɘ^XbhĂсAĐn߂BÂ[g̘^͎̂Ă
+  void start(int sampling_rate, size_t num_channels);
+  // ď̈˗ƏIɌĂԁBstart܂ŖԂ
+  void stop();
+  // ȉ2͘^XbhĂԁB
+  // pushpPbg̘^ [100ns]
+  void push_timestamp(UINT64 qpc_position);
+  // `lɕpPbgށBcrossfadeȂ璼O̖Əd˂B
+  // ^obt@炠ӂĎ̂ĂTv(S`l̍v)Ԃ
+  size_t push(std::vector<float>* channels, size_t num_channels, bool crossfade);
+  // pPbglengthTvށBTvʂɍςޕApushyB߂lpushƓ
+  size_t push_silence(size_t length, size_t num_channels);
+  // ͂̃[g^ƈႤɁÃ[g֕ϊC^[[ủ̓obt@֏ށBinterleavednullptrȂ疳B
+  // ^Ɠ[gȂpush/push_silence̓obt@ɂނ̂ŌĂ΂Ȃ
+  void push_analyzer(const float* interleaved, size_t num_frames, size_t num_channels);
+
+  // ̓obt@̃[gB0Ȃ^ƓBςƉ̓obt@͋ɂȂ
+  void set_analyzer_sampling_rate(int rate);
+  // ̓obt@̎ۂ̃[gB^ƓȂstartœn[g
+  int get_analyzer_sampling_rate();
+
+  // ProcessCallback 1񕪂̓ǂݏoBS\[XȊԂ͑ҋ@AȂ܂܂̃`l͑ɑB
+  // sourceoutput͌Ăяo(\[X)ɎBoutputlengthȏ̃obt@ŁA\[XmsČĂłȂB
+  // enabledȂoutput֏trueAłȂΉfalseԂ
+  // bNt[ł͂Ȃ: ǂݏorecording_data_mutex1ARs[̊Ԃ^Xbh⑼̃\[XƑ҂B
+  // L/̐؂ւłhold_standbycatch_upXɎ
+  bool read_source(int channel, bool enabled, reader& source, float* output, size_t length);
+  // outputlengthށBlengthget_capacity()ȉ
+  void get_buffer(int request_channel, reader& source, float* output, size_t length);
+  // result͌ĂяoŊmۂĂBeʓŋlߑւ̂ŒԂł͊mۂȂB
+  // silentnƁAǂݏoS`l̓Rs[resultɂ*silenttrueɂ
+  size_t get_analyzer_data(size_t alignment, std::array<std::vector<float>, max_channels>& result, bool* silent = nullptr);
+  void catch_up(int request_channel);
+  void reset_buffer();
+  // S\[XȊԁAR[obNɌĂԁBҋ@^𑱂Ȃ璼߂̕c
+  void hold_standby();
+  void reset_analyzer_data();
+
+  void set_warm_standby(bool enabled);
+  void set_concealment_mode(underrun_concealer::Mode mode);
+  void set_target_buffer_size(size_t samples);
+  size_t get_target_buffer_size();
+  size_t get_capacity();
+
+  State get_state();
+  size_t get_size(int channel);
+  UINT64 get_sample_position();
+  // get_bufferŘ^Ȃ
+  UINT64 get_underruns();
+  float get_latency(LatencyConsumer consumer);
+  int get_latency_histogram(LatencyConsumer consumer, int* buckets, int length);
+  void reset_latency();
+
+private:
+  // 1`lށBinputnullptrȂ疳BӂĎ̂ĂTvԂ
+  size_t push_channel(size_t channel, const segment* input, size_t length, bool crossfade);
+  // analyzer_data_mutexԂŌĂ
+  void push_analyzer_channel(size_t channel, const segment* input, size_t length, bool crossfade);
+  bool analyzer_follows_recording();
+  void record_latency(LatencyConsumer consumer, UINT64 read_position);
+
+  size_t capacity;
+  std::atomic<State> state;
+  size_t num_channels;
+
+  // `ľŒ蒷O
+  std::vector<ring_buffer> recording_data;
+  std::mutex recording_data_mutex;
+
+  // ^JñTvTvʒuƁApPbg̘^B
+  // recording_data_mutexŕی삷Bobt@擪̈ʒu͏݈ʒu-obt@ŋ܂
+  int sampling_rate;
+  capture_timeline timeline;
+  std::array<UINT64, max_channels> recording_write_position;
+  std::atomic<UINT64> sample_position;
+
+  // Đrbg[g肪܂ł́A̓obt@ʂɎB
+  std::vector<ring_buffer> analyzer_data;
+  std::mutex analyzer_data_mutex;
+  std::array<UINT64, max_channels> analyzer_write_position;
+  // 0Ȃ^Ɠ[gBႤanalyzer_write_positioñ[gŐ
+  std::atomic<int> analyzer_sampling_rate;
+  std::vector<float> analyzer_input;
+
+  std::array<latency_histogram, static_cast<size_t>(LatencyConsumer::Max)> latency;
+
+
+  // ĐJnOɗ߂ʁBr؂ԂŉB̂ŁAĂ͕ɂ
+  std::atomic<size_t> target_buffer_size;
+  std::atomic<underrun_concealer::Mode> concealment_mode;
+  // obt@󂯂ƃ[hςɐi߁Ae\[X̕Ԃ̏Ԃ̓ǂݏoŎ̂Ă
+  std::atomic<unsigned int> reader_generation;
+  std::atomic<bool> warm_standby;
+  std::atomic<UINT64> underruns;
+  // Oread_sourceŗL`l̃rbgB1̕sȓǂݏœւAȌԂőҋ@ƒǂ߂
+  std::atomic<unsigned int> enabled_channels;
+};
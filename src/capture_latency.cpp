@@ -0,0 +1,86 @@
+#include "capture_latency.h"
+
+UINT64 qpc_now_100ns()
+{
+  static const LONGLONG frequency = [] {
+    LARGE_INTEGER result;
+    QueryPerformanceFrequency(&result);
+    return result.QuadPart;
+  }();
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return static_cast<UINT64>(counter.QuadPart / frequency * 10000000 + counter.QuadPart % frequency * 10000000 / frequency);
+}
+
+capture_timeline::capture_timeline()
+  : head(0)
+  , count(0)
+{
+}
+
+void capture_timeline::push(const capture_timestamp& timestamp)
+{
+  entries[head] = timestamp;
+  head = (head + 1) % capacity;
+  if (count < capacity) {
+    ++count;
+  }
+}
+
+bool capture_timeline::find(UINT64 sample_position, int sampling_rate, UINT64* qpc_position) const
+{
+  // VpPbgkAsample_position܂ރpPbgT
+  for (size_t i = 1; i <= count; ++i) {
+    const auto& entry = entries[(head + capacity - i) % capacity];
+    if (entry.sample_position <= sample_position) {
+      *qpc_position = entry.qpc_position + (sample_position - entry.sample_position) * 10000000 / sampling_rate;
+      return true;
+    }
+  }
+  return false;
+}
+
+void capture_timeline::clear()
+{
+  head = 0;
+  count = 0;
+}
+
+latency_histogram::latency_histogram()
+{
+  reset();
+}
+
+void latency_histogram::record(float milliseconds)
+{
+  latest.store(milliseconds, std::memory_order_relaxed);
+  int bucket = static_cast<int>(milliseconds);
+  if (bucket < 0) {
+    bucket = 0;
+  } else if (bucket >= num_buckets) {
+    bucket = num_buckets - 1;
+  }
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+float latency_histogram::get_latest()
+{
+  return latest.load(std::memory_order_relaxed);
+}
+
+int latency_histogram::copy_buckets(int* destination, int length)
+{
+  const int num_copied = length < num_buckets ? length : num_buckets;
+  for (int i = 0; i < num_copied; ++i) {
+    destination[i] = static_cast<int>(buckets[i].load(std::memory_order_relaxed));
+  }
+  return num_copied;
+}
+
+void latency_histogram::reset()
+{
+  latest = 0.0f;
+  for (auto& bucket : buckets) {
+    bucket = 0;
+  }
+}
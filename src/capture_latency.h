@@ -0,0 +1,54 @@
+#pragma once
+#include <windows.h>
+#include <array>
+#include <atomic>
+
+// WASAPIqpc_positionƓ100nsPʂ̌ݎ
+UINT64 qpc_now_100ns();
+
+struct capture_timestamp
+{
+  UINT64 sample_position;  // TṽTvʒu
+  UINT64 qpc_position;     // ̐擪TvĐꂽ [100ns]
+};
+
+// pPbg̘^ێACӂ̃Tvʒu̘^悤ɂ
+class capture_timeline
+{
+public:
+  capture_timeline();
+  void push(const capture_timestamp& timestamp);
+  bool find(UINT64 sample_position, int sampling_rate, UINT64* qpc_position) const;
+  void clear();
+
+private:
+  // 10ms̃pPbg2.5bB^obt@̍ő咷\
+  static const size_t capacity = 256;
+  std::array<capture_timestamp, capacity> entries;
+  size_t head;
+  size_t count;
+};
+
+enum class LatencyConsumer : int
+{
+  Spatializer = 0,
+  Analyzer = 1,
+  Max = 2,
+};
+
+// ^܂ł̒xB1ms݂̃qXgOƍŐVl
+class latency_histogram
+{
+public:
+  static const int num_buckets = 256;  // Ō̃oPbg͂ȏ܂Ƃ߂
+
+  latency_histogram();
+  void record(float milliseconds);
+  float get_latest();
+  int copy_buckets(int* buckets, int length);
+  void reset();
+
+private:
+  std::atomic<float> latest;
+  std::array<std::atomic<unsigned int>, num_buckets> buckets;
+};
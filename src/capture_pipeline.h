@@ -0,0 +1,17 @@
+#pragma once
+#include "capture_backend.h"
+#include "MFT_resampler.h"
+#include <wrl/client.h>
+#include <mmdeviceapi.h>
+#include <memory>
+
+// ^foCX1̘^ƃTv̑gBfoCX؂ւ͗ŐVgĂ
+struct capture_pipeline
+{
+  Microsoft::WRL::ComPtr<IMMDevice> device;
+  std::unique_ptr<capture_backend> backend;
+  std::unique_ptr<MFT_resampler> resampler;
+  capture_format format;
+  UINT32 buffer_frame_count;
+  int output_sampling_rate;
+};
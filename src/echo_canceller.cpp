@@ -0,0 +1,447 @@
+#include "echo_canceller.h"
+#include <cmath>
+#include <algorithm>
+#include <cstdlib>
+
+namespace
+{
+// o̓O̗eʁB1pPbg͘^obt@𒴂Ȃ
+const size_t io_capacity = 16384;
+// KLMS̃Xebv̏ƁAwKn߂̑Sш拤ʂ̃Xebv
+const float max_step = 0.5f;
+const float initial_step = 0.25f;
+// c̊(leak)̉ƁAwKn߂𔲂̂ɕKvȒl
+const float min_leak = 0.005f;
+const float adapted_leak = 0.03f;
+const float leak_smoothing = 0.95f;
+// QƐM菬ubNł͓KȂ(1Tv̕σp[)
+const float silent_reference_power = 1.0e-8f;
+// ݑւ̃s[Nς̂{ȂAx̐MpȂ
+const float delay_confidence = 6.0f;
+// W
+const float power_smoothing = 0.9f;
+
+inline std::complex<float> multiply(const std::complex<float>& a, const std::complex<float>& b)
+{
+  return std::complex<float>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+inline std::complex<float> multiply_conjugate(const std::complex<float>& a, const std::complex<float>& b)
+{
+  return std::complex<float>(a.real() * b.real() + a.imag() * b.imag(), a.imag() * b.real() - a.real() * b.imag());
+}
+}
+
+reference_ring::reference_ring(size_t capacity)
+  : buffer(capacity * num_channels, 0.0f)
+  , capacity(capacity)
+  , write_position(0)
+{
+}
+
+void reference_ring::push(const float* interleaved, size_t num_frames, int input_channels)
+{
+  if (input_channels <= 0) {
+    return;
+  }
+  const UINT64 position = write_position.load(std::memory_order_relaxed);
+  size_t index = static_cast<size_t>(position % capacity);
+  for (size_t frame = 0; frame < num_frames; ++frame) {
+    const float left = interleaved[frame * input_channels];
+    buffer[index * num_channels] = left;
+    buffer[index * num_channels + 1] = input_channels > 1 ? interleaved[frame * input_channels + 1] : left;
+    index = index + 1 == capacity ? 0 : index + 1;
+  }
+  write_position.store(position + num_frames, std::memory_order_release);
+}
+
+UINT64 reference_ring::get_write_position()
+{
+  return write_position.load(std::memory_order_acquire);
+}
+
+bool reference_ring::read(UINT64 position, size_t num_frames, float* left, float* right)
+{
+  // ͌JÖʒu֐ɏނ̂ŁAeʂ1/4͏㏑ȂƂ݂Ȃ
+  const UINT64 guard = capacity / 4;
+  const UINT64 written = write_position.load(std::memory_order_acquire);
+  if (position + num_frames > written || position + capacity < written + guard) {
+    return false;
+  }
+  size_t index = static_cast<size_t>(position % capacity);
+  for (size_t frame = 0; frame < num_frames; ++frame) {
+    left[frame] = buffer[index * num_channels];
+    right[frame] = buffer[index * num_channels + 1];
+    index = index + 1 == capacity ? 0 : index + 1;
+  }
+  // ǂłԂɒǂzĂȂm߂
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return position + capacity >= write_position.load(std::memory_order_relaxed) + guard;
+}
+
+echo_canceller::channel_state::channel_state()
+  : input(io_capacity)
+  , output(io_capacity)
+  , previous_reference(block_size, 0.0f)
+  , reference_spectra(num_partitions, std::vector<std::complex<float>>(num_bins))
+  , weights(num_partitions, std::vector<std::complex<float>>(num_bins))
+  , block_in(block_size, 0.0f)
+  , block_out(block_size, 0.0f)
+  , error_spectrum(num_bins)
+{
+}
+
+echo_canceller::echo_canceller(reference_ring& reference)
+  : reference(reference)
+  , block_fft(fft_size)
+  , correlation_fft(correlation_size)
+  , frame(fft_size, 0.0f)
+  , spectrum(num_bins)
+  , power(num_bins, 0.0f)
+  , echo_bin_power(num_bins, 0.0f)
+  , error_bin_power(num_bins, 0.0f)
+  , step(num_bins, 0.0f)
+  , capture_history(history_length)
+  , history_left(history_length, 0.0f)
+  , history_right(history_length, 0.0f)
+  , correlation_input(correlation_size, 0.0f)
+  , capture_spectrum(correlation_size / 2 + 1)
+  , reference_spectrum(correlation_size / 2 + 1)
+  , smoothed_echo_power(num_bins, 0.0f)
+  , smoothed_error_power(num_bins, 0.0f)
+  , published_delay(-1)
+  , erle_db(0.0f)
+{
+  for (auto& block : reference_block) {
+    block.assign(block_size, 0.0f);
+  }
+  reset();
+}
+
+void echo_canceller::reset()
+{
+  for (auto& channel : channels) {
+    channel.input.clear();
+    channel.output.clear();
+    // ŏ̃ubN܂ł̕𖳉Ŗ߂ĂAo͂block_sizexɂ
+    std::fill(channel.block_out.begin(), channel.block_out.end(), 0.0f);
+    channel.output.push_front(segment{channel.block_out.data(), block_size});
+  }
+  clear_filter();
+  block_position = 0;
+  delay_known = false;
+  delay = 0;
+  candidate_known = false;
+  candidate_delay = 0;
+  capture_history.clear();
+  history_position = 0;
+  samples_since_estimate = 0;
+  input_power = 0.0f;
+  published_delay = -1;
+  erle_db = 0.0f;
+}
+
+void echo_canceller::clear_filter()
+{
+  for (auto& channel : channels) {
+    for (auto& partition : channel.reference_spectra) {
+      std::fill(partition.begin(), partition.end(), std::complex<float>());
+    }
+    for (auto& partition : channel.weights) {
+      std::fill(partition.begin(), partition.end(), std::complex<float>());
+    }
+    std::fill(channel.previous_reference.begin(), channel.previous_reference.end(), 0.0f);
+  }
+  newest_partition = 0;
+  constrain_partition = 0;
+  reference_continuous = false;
+  error_power = 0.0f;
+  echo_error_covariance = 0.0f;
+  echo_variance = 0.0f;
+  adapted = false;
+  adapted_sum = 0.0f;
+  std::fill(smoothed_echo_power.begin(), smoothed_echo_power.end(), 0.0f);
+  std::fill(smoothed_error_power.begin(), smoothed_error_power.end(), 0.0f);
+}
+
+long long echo_canceller::get_delay()
+{
+  return published_delay;
+}
+
+float echo_canceller::get_erle_db()
+{
+  return erle_db;
+}
+
+void echo_canceller::process(std::vector<float>* signal, size_t num_channels)
+{
+  num_channels = num_channels < max_channels ? num_channels : max_channels;
+  if (num_channels == 0) {
+    return;
+  }
+  const size_t num_frames = signal[0].size();
+
+  // xpɃmŎc
+  for (size_t start = 0; start < num_frames; start += block_size) {
+    const size_t length = num_frames - start < block_size ? num_frames - start : block_size;
+    for (size_t index = 0; index < length; ++index) {
+      frame[index] = num_channels > 1 ? 0.5f * (signal[0][start + index] + signal[1][start + index]) : signal[0][start + index];
+    }
+    capture_history.push_front(segment{frame.data(), length});
+  }
+  history_position += num_frames;
+  samples_since_estimate += num_frames;
+
+  for (size_t channel = 0; channel < num_channels; ++channel) {
+    channels[channel].input.push_front(segment{signal[channel].data(), num_frames});
+  }
+  while (channels[0].input.size() >= block_size) {
+    for (size_t channel = 0; channel < num_channels; ++channel) {
+      channels[channel].input.pop_back_to(channels[channel].block_in.data(), block_size);
+    }
+    process_block(num_channels);
+    for (size_t channel = 0; channel < num_channels; ++channel) {
+      channels[channel].output.push_front(segment{channels[channel].block_out.data(), block_size});
+    }
+    block_position += block_size;
+  }
+  for (size_t channel = 0; channel < num_channels; ++channel) {
+    channels[channel].output.pop_back_to(signal[channel].data(), num_frames);
+  }
+
+  if (samples_since_estimate >= estimate_interval && capture_history.size() == history_length) {
+    samples_since_estimate = 0;
+    estimate_delay();
+  }
+}
+
+void echo_canceller::process_block(size_t num_channels)
+{
+  bool has_reference = false;
+  if (delay_known) {
+    const long long position = static_cast<long long>(block_position) - delay;
+    has_reference = position >= 0 && reference.read(static_cast<UINT64>(position), block_size, reference_block[0].data(), reference_block[1].data());
+  }
+  if (!has_reference) {
+    // QƂ΂̂܂ܒʂBr؂ꂽQƂ̗͎ɎgɎ̂Ă
+    for (size_t channel = 0; channel < num_channels; ++channel) {
+      channels[channel].block_out = channels[channel].block_in;
+    }
+    reference_continuous = false;
+    return;
+  }
+  if (!reference_continuous) {
+    for (auto& channel : channels) {
+      for (auto& partition : channel.reference_spectra) {
+        std::fill(partition.begin(), partition.end(), std::complex<float>());
+      }
+      std::fill(channel.previous_reference.begin(), channel.previous_reference.end(), 0.0f);
+    }
+    reference_continuous = true;
+  }
+
+  newest_partition = (newest_partition + 1) % num_partitions;
+  float block_input_energy = 0.0f;
+  float block_error_energy = 0.0f;
+  float block_reference_energy = 0.0f;
+  std::fill(echo_bin_power.begin(), echo_bin_power.end(), 0.0f);
+  std::fill(error_bin_power.begin(), error_bin_power.end(), 0.0f);
+  for (size_t channel = 0; channel < num_channels; ++channel) {
+    auto& state = channels[channel];
+    const float* reference_samples = reference_block[channel].data();
+
+    // 2ubN̎QƂϊčŐV̋ɓ(overlap-save)
+    std::copy(state.previous_reference.begin(), state.previous_reference.end(), frame.begin());
+    std::copy(reference_samples, reference_samples + block_size, frame.begin() + block_size);
+    block_fft.forward(frame.data(), state.reference_spectra[newest_partition].data());
+    std::copy(reference_samples, reference_samples + block_size, state.previous_reference.begin());
+
+    // ěW|đAGR[ԗ֖̈߂
+    std::fill(spectrum.begin(), spectrum.end(), std::complex<float>());
+    for (size_t partition = 0; partition < num_partitions; ++partition) {
+      const auto& x = state.reference_spectra[(newest_partition + num_partitions - partition) % num_partitions];
+      const auto& w = state.weights[partition];
+      for (size_t bin = 0; bin < num_bins; ++bin) {
+        spectrum[bin] += multiply(w[bin], x[bin]);
+      }
+    }
+    for (size_t bin = 0; bin < num_bins; ++bin) {
+      echo_bin_power[bin] += std::norm(spectrum[bin]);
+    }
+    block_fft.inverse(spectrum.data(), frame.data());
+
+    for (size_t index = 0; index < block_size; ++index) {
+      const float input = state.block_in[index];
+      const float error = input - frame[block_size + index];
+      state.block_out[index] = error;
+      block_input_energy += input * input;
+      block_error_energy += error * error;
+      block_reference_energy += reference_samples[index] * reference_samples[index];
+    }
+
+    std::fill(frame.begin(), frame.begin() + block_size, 0.0f);
+    std::copy(state.block_out.begin(), state.block_out.end(), frame.begin() + block_size);
+    block_fft.forward(frame.data(), state.error_spectrum.data());
+    for (size_t bin = 0; bin < num_bins; ++bin) {
+      error_bin_power[bin] += std::norm(state.error_spectrum[bin]);
+    }
+  }
+
+  const float scale = 1.0f / (block_size * num_channels);
+  error_power = power_smoothing * error_power + (1.0f - power_smoothing) * block_error_energy * scale;
+  if (block_reference_energy * scale < silent_reference_power) {
+    return;
+  }
+  input_power = power_smoothing * input_power + (1.0f - power_smoothing) * block_input_energy * scale;
+  if (error_power > 0.0f) {
+    erle_db = 10.0f * log10f((input_power + 1.0e-12f) / (error_power + 1.0e-12f));
+  }
+
+  // 덷̂GR[̏c肪߂銄(leak)A덷ƐGR[̃p[ꏏɓx狁߂B
+  // ̃Av̉͐GR[Ɩ֌Wɓ̂ŁA葱ĂĂleakɂ͓Ȃ
+  float covariance = 0.0f;
+  float variance = 0.0f;
+  for (size_t bin = 0; bin < num_bins; ++bin) {
+    smoothed_echo_power[bin] = power_smoothing * smoothed_echo_power[bin] + (1.0f - power_smoothing) * echo_bin_power[bin];
+    smoothed_error_power[bin] = power_smoothing * smoothed_error_power[bin] + (1.0f - power_smoothing) * error_bin_power[bin];
+    const float echo_deviation = echo_bin_power[bin] - smoothed_echo_power[bin];
+    covariance += (error_bin_power[bin] - smoothed_error_power[bin]) * echo_deviation;
+    variance += echo_deviation * echo_deviation;
+  }
+  echo_error_covariance = leak_smoothing * echo_error_covariance + (1.0f - leak_smoothing) * covariance;
+  echo_variance = leak_smoothing * echo_variance + (1.0f - leak_smoothing) * variance;
+  float leak = echo_variance > 0.0f ? echo_error_covariance / echo_variance : 1.0f;
+  leak = leak < min_leak ? min_leak : (leak > 1.0f ? 1.0f : leak);
+
+  if (!adapted) {
+    // GR[܂́AQƂƌ덷̑傫̔őSш𓯂悤ɓ
+    float rate = initial_step * block_reference_energy / (block_error_energy + 1.0e-12f);
+    rate = rate > initial_step ? initial_step : rate;
+    std::fill(step.begin(), step.end(), rate);
+    adapted_sum += rate;
+    adapted = adapted_sum > num_partitions && leak > adapted_leak;
+  } else {
+    // ш斈ɏcƌ덷̔œB̃Av̉傫шقǏȂ
+    for (size_t bin = 0; bin < num_bins; ++bin) {
+      const float residual = leak * echo_bin_power[bin];
+      const float ratio = residual / (error_bin_power[bin] + 1.0e-12f);
+      step[bin] = ratio > max_step ? max_step : ratio;
+    }
+  }
+
+  const float regularization = fft_size * silent_reference_power;
+  for (size_t channel = 0; channel < num_channels; ++channel) {
+    auto& state = channels[channel];
+    std::fill(power.begin(), power.end(), 0.0f);
+    for (const auto& x : state.reference_spectra) {
+      for (size_t bin = 0; bin < num_bins; ++bin) {
+        power[bin] += std::norm(x[bin]);
+      }
+    }
+    for (size_t bin = 0; bin < num_bins; ++bin) {
+      state.error_spectrum[bin] *= step[bin] / (power[bin] + regularization);
+    }
+    for (size_t partition = 0; partition < num_partitions; ++partition) {
+      const auto& x = state.reference_spectra[(newest_partition + num_partitions - partition) % num_partitions];
+      auto& w = state.weights[partition];
+      for (size_t bin = 0; bin < num_bins; ++bin) {
+        w[bin] += multiply_conjugate(state.error_spectrum[bin], x[bin]);
+      }
+    }
+
+    // W̌㔼0ɂďݍ݂̐菜B͏d̂1ubN1悸
+    auto& constrained = state.weights[constrain_partition];
+    block_fft.inverse(constrained.data(), frame.data());
+    std::fill(frame.begin() + block_size, frame.end(), 0.0f);
+    block_fft.forward(frame.data(), constrained.data());
+  }
+  constrain_partition = (constrain_partition + 1) % num_partitions;
+}
+
+void echo_canceller::estimate_delay()
+{
+  const UINT64 reference_end = reference.get_write_position();
+  if (reference_end < history_length) {
+    return;
+  }
+  if (!reference.read(reference_end - history_length, history_length, history_left.data(), history_right.data())) {
+    return;
+  }
+
+  // QƂƘ^ꂼꃂmɂĊԈA딼0Ŗ߂ĕϊ
+  const size_t decimated_length = history_length / decimation;
+  float reference_energy = 0.0f;
+  std::fill(correlation_input.begin(), correlation_input.end(), 0.0f);
+  for (size_t index = 0; index < decimated_length; ++index) {
+    float sum = 0.0f;
+    for (size_t offset = 0; offset < decimation; ++offset) {
+      sum += history_left[index * decimation + offset] + history_right[index * decimation + offset];
+    }
+    correlation_input[index] = sum / (2 * decimation);
+    reference_energy += correlation_input[index] * correlation_input[index];
+  }
+  if (reference_energy / decimated_length < silent_reference_power) {
+    return;
+  }
+  correlation_fft.forward(correlation_input.data(), reference_spectrum.data());
+
+  const auto segments = capture_history.back(history_length);
+  auto capture_at = [&](size_t index) {
+    return index < segments.first.length ? segments.first.data[index] : segments.second.data[index - segments.first.length];
+  };
+  for (size_t index = 0; index < decimated_length; ++index) {
+    float sum = 0.0f;
+    for (size_t offset = 0; offset < decimation; ++offset) {
+      sum += capture_at(index * decimation + offset);
+    }
+    correlation_input[index] = sum / decimation;
+  }
+  correlation_fft.forward(correlation_input.data(), capture_spectrum.data());
+
+  // UŊĈʑc(PHAT)Ass[Nɂ
+  for (size_t bin = 0; bin < capture_spectrum.size(); ++bin) {
+    const auto cross = multiply_conjugate(capture_spectrum[bin], reference_spectrum[bin]);
+    const float magnitude = std::abs(cross);
+    capture_spectrum[bin] = magnitude > 1.0e-12f ? cross / magnitude : std::complex<float>();
+  }
+  correlation_fft.inverse(capture_spectrum.data(), correlation_input.data());
+
+  size_t peak_index = 0;
+  float peak = 0.0f;
+  float total = 0.0f;
+  for (size_t index = 0; index < correlation_size; ++index) {
+    const float value = fabsf(correlation_input[index]);
+    total += value;
+    if (value > peak) {
+      peak = value;
+      peak_index = index;
+    }
+  }
+  if (peak < delay_confidence * total / correlation_size) {
+    return;
+  }
+
+  // ^[i]Q[i - lag]ɑΉ(lagĐ^܂ł̒x)B
+  // ^ƎQƑ̈ʒu̍𑫂āAQƂ̈ʒu = ^̈ʒu - delayɂ
+  const long long lag = (peak_index < correlation_size / 2 ? static_cast<long long>(peak_index) : static_cast<long long>(peak_index) - static_cast<long long>(correlation_size)) * decimation;
+  const long long estimated = static_cast<long long>(history_position) - static_cast<long long>(reference_end) + lag;
+  const long long candidate = estimated - delay_margin;
+  if (delay_known && std::llabs(candidate - delay) <= delay_margin / 2) {
+    candidate_known = false;
+    return;
+  }
+  // QƂÂȋԂȂǂł͊Oꂽs[NôŁA̒xƈႤl2񑱂ēʂoĂgB
+  // ŏ̐肾͂g
+  if (delay_known && (!candidate_known || std::llabs(candidate - candidate_delay) > delay_margin / 2)) {
+    candidate_delay = candidate;
+    candidate_known = true;
+    return;
+  }
+  // oHςBW͎gȂ̂ŊwK
+  delay = candidate;
+  delay_known = true;
+  candidate_known = false;
+  published_delay = lag;
+  clear_filter();
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "fft.h"
+#include "ring_buffer.h"
+#include <windows.h>
+#include <vector>
+#include <array>
+#include <atomic>
+#include <complex>
+
+// Q[g̏o(QƐM)𗭂߂郊OBI[fBIXbhA^Xbhǂ
+class reference_ring
+{
+public:
+  static const size_t num_channels = 2;
+
+  explicit reference_ring(size_t capacity);
+  // interleavedinput_channels`lBm͗`l֓A3`lڈȍ~͎̂Ă
+  void push(const float* interleaved, size_t num_frames, int input_channels);
+  // ܂łɏ񂾃t[
+  UINT64 get_write_position();
+  // [position, position + num_frames)ǂށB܂ĂȂA㏑Ăfalse
+  bool read(UINT64 position, size_t num_frames, float* left, float* right);
+
+private:
+  std::vector<float> buffer;
+  size_t capacity;
+  std::atomic<UINT64> write_position;
+};
+
+// [vobN^Q[g̏o͂菜KtB^B
+// QƐMƂ̒x𑊌ݑ(GCC-PHAT)ő܂ɋ߂č킹AčoH𕪊g̈KtB^(MDF)Ő肵ĈB
+// block_sizeTvɏ̂ŁAo͂block_sizex
+class echo_canceller
+{
+public:
+  static const size_t max_channels = 2;
+  static const size_t block_size = 256;
+  // block_size * num_partitionstB^Bx킹̌oH̓TvxȂ̂ŒZĂ悢
+  static const size_t num_partitions = 4;
+
+  explicit echo_canceller(reference_ring& reference);
+
+  // ^XbhĂԁBfoCXς͒x肵
+  void reset();
+  // channels[0..num_channels)̊echannels[0].size()Tv
+  void process(std::vector<float>* channels, size_t num_channels);
+  // QƂɏĂ^Ɍ܂ł̒x [Tv]BȂ-1
+  long long get_delay();
+  // QƐMĂԂ̏ [dB]
+  float get_erle_db();
+
+private:
+  static const size_t fft_size = block_size * 2;
+  static const size_t num_bins = block_size + 1;
+  // xɎgƊԈB48kHzŖ0.7b1/4ɊԈđւ
+  static const size_t history_length = 32768;
+  static const size_t decimation = 4;
+  static const size_t correlation_size = history_length / decimation * 2;
+  // 肵x肱ꂾQƂgAx̌덷tB^ɋz
+  static const long long delay_margin = 64;
+  static const UINT64 estimate_interval = 48000;
+
+  struct channel_state
+  {
+    channel_state();
+
+    ring_buffer input;
+    ring_buffer output;
+    std::vector<float> previous_reference;
+    // num_partitionsubN̎QƃXyNg(z)ƁAΉtB^W
+    std::vector<std::vector<std::complex<float>>> reference_spectra;
+    std::vector<std::vector<std::complex<float>>> weights;
+    std::vector<float> block_in;
+    std::vector<float> block_out;
+    std::vector<std::complex<float>> error_spectrum;
+  };
+
+  void process_block(size_t num_channels);
+  void clear_filter();
+  void estimate_delay();
+
+  reference_ring& reference;
+  real_fft block_fft;
+  real_fft correlation_fft;
+  std::array<channel_state, max_channels> channels;
+
+  // ς݃ubN̐擪ʒu(^̃Tv)ƁAQƑ̈ʒuƂ̍
+  UINT64 block_position;
+  bool delay_known;
+  long long delay;
+  // ̒xƐH茋ʁB̐łȂ؂ւ
+  bool candidate_known;
+  long long candidate_delay;
+  size_t newest_partition;
+  size_t constrain_partition;
+  bool reference_continuous;
+
+  // Ɨ̈
+  std::vector<float> frame;
+  std::vector<std::complex<float>> spectrum;
+  std::vector<float> power;
+  std::vector<float> echo_bin_power;
+  std::vector<float> error_bin_power;
+  std::vector<float> step;
+  std::array<std::vector<float>, max_channels> reference_block;
+
+  // xp̘^(m)ƍƗ̈
+  ring_buffer capture_history;
+  UINT64 history_position;
+  UINT64 samples_since_estimate;
+  std::vector<float> history_left;
+  std::vector<float> history_right;
+  std::vector<float> correlation_input;
+  std::vector<std::complex<float>> capture_spectrum;
+  std::vector<std::complex<float>> reference_spectrum;
+
+  // K̑̒Əʂ̌vɎgAp[
+  std::vector<float> smoothed_echo_power;
+  std::vector<float> smoothed_error_power;
+  float error_power;
+  float echo_error_covariance;
+  float echo_variance;
+  bool adapted;
+  float adapted_sum;
+  float input_power;
+  std::atomic<long long> published_delay;
+  std::atomic<float> erle_db;
+};
@@ -0,0 +1,197 @@
+#include "endpoint_mixer.h"
+#include "capture_latency.h"
+#include "metrics.h"
+#include "trace.h"
+#include <Audioclient.h>
+#include <cmath>
+#include <stdexcept>
+
+namespace
+{
+// ǉfoCX͏o͂菭O̘^̉𑫂 [b]B
+// foCX̃pPbgƓNœǂ񂾕ł́AԂɎg̃Tv܂͂ĂȂƂ邽
+const double alignment_margin = 0.01;
+// 킹̌덷𒴂ԂŒǂ킸Aǂ݈ʒu΂č킹 [b]
+const double resync_threshold = 0.02;
+// NbN␳̏B@̂͐\琔Sppmx
+const double max_correction = 0.002;
+// 덷1Tv̕␳ʁB10ms̃pPbgŎ萔2bق
+const double proportional_gain = 1.0e-5;
+// IȂłϕ
+const double integral_gain = 1.0e-8;
+}
+
+endpoint_mixer::endpoint_mixer(const std::string& id, std::unique_ptr<capture_pipeline> pipeline, size_t buffer_size, float gain)
+  : id(id)
+  , pipeline(std::move(pipeline))
+  , pending_end_time(0)
+  , read_phase(0.0)
+  , integrated_error(0.0)
+  , aligned(false)
+  , gain(gain)
+  , drift_ppm(0.0f)
+  , failed(false)
+{
+  const auto& format = this->pipeline->format;
+  num_channels = format.num_channels < static_cast<int>(max_channels) ? format.num_channels : max_channels;
+  pending.assign(num_channels, ring_buffer(buffer_size));
+
+  // ^[vŊmۂȂ悤A1pPbgŃobt@ŜĂ܂邾mۂĂ
+  const size_t max_output_frames = static_cast<size_t>(this->pipeline->buffer_frame_count) * this->pipeline->output_sampling_rate / format.sampling_rate + 1024;
+  resampler_result.reserve(max_output_frames * format.num_channels * sizeof(float));
+  deinterleave_buffer.reserve(max_output_frames);
+}
+
+endpoint_mixer::~endpoint_mixer()
+{
+  pipeline->backend->stop();
+}
+
+const std::string& endpoint_mixer::get_id()
+{
+  return id;
+}
+
+float endpoint_mixer::get_gain()
+{
+  return gain;
+}
+
+void endpoint_mixer::set_gain(float gain)
+{
+  this->gain = gain;
+}
+
+float endpoint_mixer::get_drift_ppm()
+{
+  return drift_ppm;
+}
+
+bool endpoint_mixer::has_failed()
+{
+  return failed;
+}
+
+void endpoint_mixer::capture()
+{
+  if (failed) {
+    return;
+  }
+
+  TRACE_SCOPE("endpoint capture");
+  try {
+    auto& backend = *pipeline->backend;
+    const auto& format = pipeline->format;
+    UINT32 packet_length = backend.get_next_packet_size();
+    BYTE *fragment;
+    UINT32 num_frames_available;
+    DWORD flags;
+    UINT64 device_position;
+    UINT64 qpc_position;
+    while (packet_length != 0) {
+      backend.get_buffer(&fragment, &num_frames_available, &flags, &device_position, &qpc_position);
+      if (flags & AUDCLNT_BUFFERFLAGS_TIMESTAMP_ERROR) {
+        qpc_position = qpc_now_100ns();
+      }
+      if (flags & AUDCLNT_BUFFERFLAGS_SILENT) {
+        ZeroMemory(fragment, format.block_align * num_frames_available);
+      }
+      pipeline->resampler->write_buffer(fragment, format.block_align * num_frames_available);
+      backend.release_buffer(num_frames_available);
+
+      resampler_result.clear();
+      pipeline->resampler->read_buffer(resampler_result);
+
+      // foCXƓATv̂̒x͖ăpPbg̏I[𗭂߂ɕRt
+      const size_t num_output_frames = resampler_result.size() / sizeof(float) / format.num_channels;
+      const auto interleaved = reinterpret_cast<const float*>(resampler_result.data());
+      deinterleave_buffer.resize(num_output_frames);
+      for (size_t channel = 0; channel < num_channels; ++channel) {
+        for (size_t frame = 0; frame < num_output_frames; ++frame) {
+          deinterleave_buffer[frame] = interleaved[frame * format.num_channels + channel];
+        }
+        pending[channel].push_front(segment{deinterleave_buffer.data(), num_output_frames});
+      }
+      pending_end_time = qpc_position + static_cast<UINT64>(num_frames_available * 10000000.0 / format.sampling_rate);
+
+      packet_length = backend.get_next_packet_size();
+    }
+  } catch (const std::exception&) {
+    // foCXOꂽȂǁBfoCX̘^͎~߂ɁÃfoCXO
+    failed = true;
+  }
+}
+
+void endpoint_mixer::mix_into(std::vector<float>* output, size_t num_output_channels, UINT64 start_time)
+{
+  const size_t num_frames = output[0].size();
+  size_t available = num_channels > 0 ? pending[0].size() : 0;
+  if (failed || num_frames == 0 || available == 0) {
+    return;
+  }
+
+  // ǂ݈ʒu̘^ƁAo͐擪alignment_marginO̘^Ƃ̍ [Tv]B
+  // Ȃ炱炪xĂ̂ő߂ɓǂ
+  const double rate = pipeline->output_sampling_rate;
+  const double read_time = pending_end_time - (available - read_phase) * 10000000.0 / rate;
+  double error = (static_cast<double>(start_time) - alignment_margin * 10000000.0 - read_time) * rate / 10000000.0;
+
+  size_t first_frame = 0;
+  if (!aligned || fabs(error) > resync_threshold * rate) {
+    // Jnr؂̌B␳ŒǂƎԂ̂ŁAǂ݈ʒu΂󂯂č킹
+    metrics::increment(metrics::Counter::EndpointResyncs);
+    if (error > 0.0) {
+      const size_t skip = static_cast<size_t>(error) < available ? static_cast<size_t>(error) : available;
+      for (auto& channel : pending) {
+        channel.pop_back(skip);
+      }
+      available -= skip;
+    } else {
+      first_frame = static_cast<size_t>(-error) < num_frames ? static_cast<size_t>(-error) : num_frames;
+    }
+    read_phase = 0.0;
+    integrated_error = 0.0;
+    error = 0.0;
+    aligned = true;
+  }
+
+  integrated_error += error;
+  const double integral_limit = max_correction / integral_gain;
+  integrated_error = integrated_error > integral_limit ? integral_limit : (integrated_error < -integral_limit ? -integral_limit : integrated_error);
+  double correction = proportional_gain * error + integral_gain * integrated_error;
+  correction = correction > max_correction ? max_correction : (correction < -max_correction ? -max_correction : correction);
+  drift_ppm = static_cast<float>(correction * 1.0e6);
+  const double ratio = 1.0 + correction;
+
+  std::pair<segment, segment> views[max_channels];
+  for (size_t channel = 0; channel < num_channels; ++channel) {
+    views[channel] = pending[channel].back(available);
+  }
+  auto at = [&](size_t channel, size_t index) {
+    const auto& view = views[channel];
+    return index < view.first.length ? view.first.data[index] : view.second.data[index - view.first.length];
+  };
+
+  const float current_gain = gain;
+  double position = read_phase;
+  for (size_t frame = first_frame; frame < num_frames; ++frame) {
+    const size_t index = static_cast<size_t>(position);
+    if (index + 1 >= available) {
+      // ܂Ă镪g؂B̃pPbgŎƂČ̂ŕ␳ǂ
+      break;
+    }
+    const float fraction = static_cast<float>(position - index);
+    for (size_t channel = 0; channel < num_output_channels; ++channel) {
+      const size_t source = channel < num_channels ? channel : num_channels - 1;
+      output[channel][frame] += current_gain * (at(source, index) * (1.0f - fraction) + at(source, index + 1) * fraction);
+    }
+    position += ratio;
+  }
+
+  size_t consumed = static_cast<size_t>(position);
+  consumed = consumed < available ? consumed : available;
+  read_phase = position - consumed;
+  for (auto& channel : pending) {
+    channel.pop_back(consumed);
+  }
+}
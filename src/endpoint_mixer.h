@@ -0,0 +1,48 @@
+#pragma once
+#include "capture_pipeline.h"
+#include "ring_buffer.h"
+#include <string>
+#include <vector>
+#include <atomic>
+
+// foCXƓɘ^ǉ̍ĐfoCX1B
+// ÕobNGhƃTvŏo̓[g֕ϊė߂ĂAfoCX̊epPbg֘^킹đށB
+// foCXԂ̃NbN̂́A̍狁߂䗦Ő`ԂȂǂނƂŋz
+class endpoint_mixer
+{
+public:
+  endpoint_mixer(const std::string& id, std::unique_ptr<capture_pipeline> pipeline, size_t buffer_size, float gain);
+  ~endpoint_mixer();
+
+  const std::string& get_id();
+  float get_gain();
+  void set_gain(float gain);
+  // ␳̃NbN [ppm]BȂ炱̃foCX̕
+  float get_drift_ppm();
+  // ^ɎsĎ~܂Ă邩Bďɍ蒼
+  bool has_failed();
+
+  // ܂ĂpPbgSēǂ݁Ao̓[g֕ϊė߂B^XbhĂ
+  void capture();
+  // 擪t[̘^start_time [100ns] ̏o֑͂ށBt[output[0].size()
+  void mix_into(std::vector<float>* output, size_t num_output_channels, UINT64 start_time);
+
+private:
+  static const size_t max_channels = 2;
+
+  std::string id;
+  std::unique_ptr<capture_pipeline> pipeline;
+  size_t num_channels;
+  std::vector<ring_buffer> pending;
+  std::vector<BYTE> resampler_result;
+  std::vector<float> deinterleave_buffer;
+  // pending̍Ō̃Tv̘̎^ [100ns]
+  UINT64 pending_end_time;
+  // ǂ݈ʒu̒[ƁANbN␳̐ϕ
+  double read_phase;
+  double integrated_error;
+  bool aligned;
+  std::atomic<float> gain;
+  std::atomic<float> drift_ppm;
+  std::atomic<bool> failed;
+};
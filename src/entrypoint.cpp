@@ -4,12 +4,20 @@
 #include "audio_meter.h"
 #include "session_volume.h"
 #include "spatializer_plugin.h"
+#include "metrics.h"
+#include "trace.h"
+#include "allocation_guard.h"
 #include <windows.h>
+#include <algorithm>
+#include <cstring>
 
 extern HMODULE oculus_spatializer_dll;
 
 std::unique_ptr<AudioMeter> meter;
 std::unique_ptr<SessionVolume> volume;
+std::unique_ptr<metrics::periodic_dump> stats_dump;
+
+static_assert(shared_capture::num_bpm_scores == Analyzer::max_interval - Analyzer::min_interval + 1, "bpm score count mismatch");
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +41,7 @@ void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
     delete device;
     device = nullptr;
   }
+  stats_dump.reset();
   meter.reset();
   volume.reset();
 
@@ -41,13 +50,20 @@ void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnityPluginUnload()
   }
 }
 
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UseSyntheticCapture(int enabled)
+{
+  // ̏LBfoCX̖ł̃x`}[Np
+  AudioDevice::use_synthetic_capture(enabled != 0);
+}
+
 void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API Initialize(int sampling_rate)
 {
   try {
     if (!device) {
       device = new AudioDevice();
-      device->initialize(32, sampling_rate);
     }
+    // ߂BfoCXƃTv͘^Xbhŏ
+    device->start(sampling_rate);
     if (!analyzer) {
       analyzer = new Analyzer(device, sampling_rate);
     }
@@ -62,6 +78,35 @@ void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API Initialize(int sampling_rate)
   }
 }
 
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetAnalyzerSamplingRate(int sampling_rate)
+{
+  // ͂o̓[gƕʂ̃[gōsB0Ȃo̓[gB͍͂蒼̂ŁAwǂƗ͏߂ɂȂB1
+  if (!analyzer || sampling_rate < 0) {
+    return 0;
+  }
+  const int output_sampling_rate = analyzer->get_output_sampling_rate();
+  const int rate = sampling_rate != 0 ? sampling_rate : output_sampling_rate;
+  if (rate == analyzer->get_sampling_rate()) {
+    return 1;
+  }
+  if (rate < rate_fanout::min_sampling_rate || rate > rate_fanout::max_sampling_rate) {
+    return 0;
+  }
+  // Â͂ɏāA̓obt@V[gŎg
+  delete analyzer;
+  analyzer = nullptr;
+  try {
+    analyzer = new Analyzer(device, output_sampling_rate, rate);
+  } catch (const std::exception&) {
+    // ϊȂBo̓[g֖̉͂߂
+    analyzer = new Analyzer(device, output_sampling_rate);
+    analyzer->reset();
+    return 0;
+  }
+  analyzer->reset();
+  return 1;
+}
+
 void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetAnalyzer()
 {
   if (analyzer) {
@@ -75,6 +120,18 @@ void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UpdateAnalyzer()
     return;
   }
   analyzer->update();
+
+  if (device) {
+    shared_capture::analyzer_snapshot snapshot = {};
+    snapshot.bpm = analyzer->get_bpm();
+    snapshot.milliseconds_to_next_beat = analyzer->get_milliseconds_to_next_beat();
+    snapshot.rms = analyzer->get_rms(Analyzer::window_size - 1);
+    snapshot.vu = analyzer->get_bpm_vu(Analyzer::window_size - 1);
+    for (int index = 0; index < static_cast<int>(shared_capture::num_bpm_scores); ++index) {
+      snapshot.bpm_score[index] = analyzer->get_bpm_score(index);
+    }
+    device->publish_analyzer(snapshot);
+  }
 }
 
 float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetBPM()
@@ -117,6 +174,83 @@ float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetMillisecondsToNextBeat(int i
   return analyzer->get_milliseconds_to_next_beat();
 }
 
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SubscribeFeature(int feature)
+{
+  // 0=VU, 1=RMS, 2=IZbg, 3=e|, 4=̈ʒu, 5=ш, 6=EhlX, 7=Ȃ̐؂ւB
+  // wǂʂƂ̈ˑ悾vZBxĂ΂ȂVU/RMS/e|/̈ʒu/Ȃ̐؂ւvZB1
+  if (!analyzer || feature < 0 || feature >= static_cast<int>(Feature::Max)) {
+    return 0;
+  }
+  analyzer->subscribe(static_cast<Feature>(feature));
+  return 1;
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API UnsubscribeFeature(int feature)
+{
+  if (!analyzer || feature < 0 || feature >= static_cast<int>(Feature::Max)) {
+    return;
+  }
+  analyzer->unsubscribe(static_cast<Feature>(feature));
+}
+
+float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetFeatureCost(int feature)
+{
+  // UpdateAnalyzer 1񂠂̌vZԂ̈ړ [us]BvZĂȂ΍Ō̒l
+  if (!analyzer || feature < 0 || feature >= static_cast<int>(Feature::Max)) {
+    return 0.0f;
+  }
+  return analyzer->get_feature_cost(static_cast<Feature>(feature));
+}
+
+float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetOnset()
+{
+  if (!analyzer) {
+    return 0.0f;
+  }
+  return analyzer->get_onset();
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetBandCount()
+{
+  return feature_graph::num_bands;
+}
+
+float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetBandLevel(int band)
+{
+  if (!analyzer || band < 0 || band >= feature_graph::num_bands) {
+    return 0.0f;
+  }
+  return analyzer->get_band_level(band);
+}
+
+float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetLoudness()
+{
+  // K|400ms̃EhlX [LUFS]
+  if (!analyzer) {
+    return static_cast<float>(feature_graph::min_loudness);
+  }
+  return analyzer->get_loudness();
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetTrackChangeCount()
+{
+  // Ȃ̐؂ւo񐔁BO̒lƔׂđĂ΁ÅԂɋȂςăe|TĂ
+  if (!analyzer) {
+    return 0;
+  }
+  return static_cast<int>(analyzer->get_track_changes());
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetFeatureHistory(int feature, float seconds, int width, float* minimum, float* maximum, float* mean)
+{
+  // feature: 0=VU, 1=RMSBsecondsbwidthɂ܂Ƃ߂ŏ/ő/ςÂɏ(null̏o͂͏Ȃ)B
+  // ߂l͒l̂̐ŁAȂΌÂ̗0Ŗ߂B̖ʂ0ԂAȂ
+  if (!analyzer || seconds <= 0.0f || width <= 0 || (feature != static_cast<int>(Feature::Vu) && feature != static_cast<int>(Feature::Rms))) {
+    return 0;
+  }
+  return static_cast<int>(analyzer->get_history(static_cast<Feature>(feature), seconds, static_cast<size_t>(width), minimum, maximum, mean));
+}
+
 int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetWindowSize()
 {
   if (!analyzer) {
@@ -125,6 +259,306 @@ int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetWindowSize()
   return Analyzer::window_size;
 }
 
+float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCaptureLatency(int consumer)
+{
+  // consumer: 0=Spatializer, 1=AnalyzerB^Ăo܂ł̍ŐV̒x[ms]
+  if (!device || consumer < 0 || consumer >= static_cast<int>(LatencyConsumer::Max)) {
+    return 0.0f;
+  }
+  return device->get_latency(static_cast<LatencyConsumer>(consumer));
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCaptureLatencyHistogram(int consumer, int* buckets, int length)
+{
+  // 1ms݂̉񐔂bucketsփRs[ARs[Ԃ
+  if (!device || !buckets || consumer < 0 || consumer >= static_cast<int>(LatencyConsumer::Max)) {
+    return 0;
+  }
+  return device->get_latency_histogram(static_cast<LatencyConsumer>(consumer), buckets, length);
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetCaptureLatency()
+{
+  if (device) {
+    device->reset_latency();
+  }
+}
+
+long long UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCaptureSamplePosition()
+{
+  // ^JñTvBo̓TvO[gP
+  if (!device) {
+    return 0;
+  }
+  return static_cast<long long>(device->get_sample_position());
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetUnderrunConcealment(int mode)
+{
+  // 0=ɐ؂ւ, 1=NXtF[ĥ, 2=g`+NXtF[h()
+  if (!device || mode < 0 || mode > static_cast<int>(underrun_concealer::Mode::Extend)) {
+    return;
+  }
+  device->set_concealment_mode(static_cast<underrun_concealer::Mode>(mode));
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetTargetBufferSize(int samples)
+{
+  // ĐJnOɗ߂TvB3072
+  if (!device || samples <= 0) {
+    return;
+  }
+  device->set_target_buffer_size(static_cast<size_t>(samples));
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetWarmStandby(int enabled)
+{
+  // L()ȂS\[XȊԂ^𗭂ߑALɂ̃ubN炷B
+  // Ȃ]ʂobt@̂āAĊJɗߒ
+  if (device) {
+    device->set_warm_standby(enabled != 0);
+  }
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartRecording(const char* path)
+{
+  // [vobNpathWAVŏoB1
+  if (!device || !path) {
+    return 0;
+  }
+  try {
+    device->start_recording(path);
+    return 1;
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartRecordingWithFormat(const char* path, int sampling_rate, int format)
+{
+  // sampling_rateWAVŏoB0Ȃo̓[gBformat: 0=32bit float, 1=16bitB1
+  if (!device || !path || sampling_rate < 0 || format < 0 || format > static_cast<int>(SampleFormat::Int16)) {
+    return 0;
+  }
+  try {
+    device->start_recording(path, sampling_rate, static_cast<SampleFormat>(format));
+    return 1;
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StopRecording()
+{
+  if (device) {
+    device->stop_recording();
+  }
+}
+
+long long UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRecordedFrames()
+{
+  if (!device) {
+    return 0;
+  }
+  return static_cast<long long>(device->get_recorded_frames());
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartSharedExport(const char* name)
+{
+  // ^̉Ɖ͌ʂ𖼑OtL֌JBnamenullȂ薼B1
+  if (!device) {
+    return 0;
+  }
+  try {
+    device->start_shared_export(name ? name : shared_capture::default_name);
+    return 1;
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StartSharedExportAtRate(const char* name, int sampling_rate)
+{
+  // StartSharedExportƓŁAsampling_rate֕ϊČJB0Ȃo̓[g
+  if (!device || sampling_rate < 0) {
+    return 0;
+  }
+  try {
+    device->start_shared_export(name ? name : shared_capture::default_name, sampling_rate);
+    return 1;
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API StopSharedExport()
+{
+  if (device) {
+    device->stop_shared_export();
+  }
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRenderEndpoints(char* buffer, int length)
+{
+  // ĐfoCX"id\tname\n"̕тbuffer֏ށB߂l͏I[KvȒ
+  try {
+    const auto list = AudioDevice::list_render_endpoints();
+    if (buffer && length > 0) {
+      const size_t num_copied = (std::min)(list.size(), static_cast<size_t>(length - 1));
+      memcpy(buffer, list.data(), num_copied);
+      buffer[num_copied] = '\0';
+    }
+    return static_cast<int>(list.size());
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetRateFanout(char* buffer, int length)
+{
+  // o̓[gƁApҖ̃[gւ̕ϊ̎}"rate <- parent method users\n"̕тbuffer֏ށB
+  // 1sڂ"rate primary users"B߂l͏I[KvȒ
+  if (!device) {
+    return 0;
+  }
+  const auto description = device->describe_rate_fanout();
+  if (buffer && length > 0) {
+    const size_t num_copied = (std::min)(description.size(), static_cast<size_t>(length - 1));
+    memcpy(buffer, description.data(), num_copied);
+    buffer[num_copied] = '\0';
+  }
+  return static_cast<int>(description.size());
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API AddCaptureEndpoint(const char* id, float gain)
+{
+  // foCXƓid̃foCX^A^𑵂gain{őށB1
+  if (!device || !id) {
+    return 0;
+  }
+  try {
+    device->add_endpoint(id, gain);
+    return 1;
+  } catch (const std::exception&) {
+    return 0;
+  }
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API RemoveCaptureEndpoint(const char* id)
+{
+  if (device && id) {
+    device->remove_endpoint(id);
+  }
+}
+
+float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetCaptureEndpointDrift(const char* id)
+{
+  // foCXɑ΂NbN̂̕␳ [ppm]
+  if (!device || !id) {
+    return 0.0f;
+  }
+  return device->get_endpoint_drift(id);
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetSelfOutputCancellation(int enabled)
+{
+  // MasterO[vɑ}"Loopback Self Reference"̉A^菜B͖
+  if (device) {
+    device->set_self_output_cancellation(enabled != 0);
+  }
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetSelfOutputDelay()
+{
+  // 肵Đ^܂ł̒x [Tv]BȂ-1
+  if (!device) {
+    return -1;
+  }
+  return static_cast<int>(device->get_self_output_delay());
+}
+
+float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetSelfOutputErle()
+{
+  // QƂĂԂ̏ [dB]B̃Av̉덷ɓ̂ŁÅԂ͏o
+  if (!device) {
+    return 0.0f;
+  }
+  return device->get_self_output_erle();
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SimulateDeviceChange()
+{
+  // foCX̕ύXʒmƓoHŘ^芷Bvp
+  if (device) {
+    device->request_migration();
+  }
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ArmAllocationGuard(int armed)
+{
+  // EH[AbvɌĂԁBȍ~A^[vProcessCallback̊mۂ𐔂
+  if (armed) {
+    allocation_guard::arm();
+  } else {
+    allocation_guard::disarm();
+  }
+}
+
+long long UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetAllocationViolations()
+{
+  // LOOPBACK_ALLOCATION_GUARDŃrhꍇ-1
+  return allocation_guard::get_violations();
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetStats(char* buffer, int length)
+{
+  // vlJSONbuffer֏ށB߂l͏I[KvȒ
+  const auto json = metrics::to_json();
+  if (buffer && length > 0) {
+    const size_t num_copied = (std::min)(json.size(), static_cast<size_t>(length - 1));
+    memcpy(buffer, json.data(), num_copied);
+    buffer[num_copied] = '\0';
+  }
+  return static_cast<int>(json.size());
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ResetStats()
+{
+  metrics::reset();
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetStatsDump(const char* path, int interval_millisec)
+{
+  // interval_millisec0ȉȂ~BpathnullȂfobOo͂֏
+  stats_dump.reset();
+  if (interval_millisec <= 0) {
+    return;
+  }
+  try {
+    stats_dump = std::make_unique<metrics::periodic_dump>(path ? path : "", interval_millisec);
+  } catch (const std::exception&) {
+  }
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API SetTraceEnabled(int enabled)
+{
+  trace::set_enabled(enabled != 0);
+}
+
+int UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API WriteTrace(const char* path)
+{
+  // L^ς݂̃CxgChromeg[X`ŏoB߂l̓CxgAs-1
+  if (!path) {
+    return -1;
+  }
+  return trace::write_chrome_trace(path);
+}
+
+void UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API ClearTrace()
+{
+  trace::clear();
+}
+
 float UNITY_INTERFACE_EXPORT UNITY_INTERFACE_API GetOutsidePeakMeter()
 {
   if (!meter) {
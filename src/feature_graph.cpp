@@ -0,0 +1,498 @@
+#include "feature_graph.h"
+#include <cassert>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <initializer_list>
+
+namespace
+{
+const size_t num_features = static_cast<size_t>(Feature::Max);
+
+// eʂˑʁBMax
+const Feature dependencies[] = {
+  Feature::Max,    // Vu
+  Feature::Max,    // Rms
+  Feature::Bands,  // Onset
+  Feature::Vu,     // Tempo
+  Feature::Tempo,  // BeatPhase
+  Feature::Max,    // Bands
+  Feature::Max,    // Loudness
+  Feature::Bands,  // TrackChange
+};
+static_assert(sizeof(dependencies) / sizeof(dependencies[0]) == num_features, "dependencies");
+static_assert(track_change_detector::num_bands == feature_graph::num_bands, "track_change_detector reads the bands as is");
+
+// vZԂ̈ړς̌WB60fpsŐbȂ炷
+const float cost_smoothing = 0.05f;
+// EhlX̑ [b] (ITU-R BS.1770momentary)
+const double loudness_window_seconds = 0.4;
+// \p̗B48kHzōłׂx11bAłex3
+const size_t history_capacity = 2048;
+const size_t history_factor = 4;
+const size_t history_levels = 6;
+
+size_t index_of(Feature feature)
+{
+  return static_cast<size_t>(feature);
+}
+
+class stopwatch
+{
+public:
+  stopwatch()
+    : start(std::chrono::steady_clock::now())
+  {
+  }
+  long long elapsed_nanoseconds() const
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+  }
+
+private:
+  std::chrono::steady_clock::time_point start;
+};
+}
+
+void feature_graph::biquad::clear()
+{
+  z1.fill(0.0);
+  z2.fill(0.0);
+}
+
+double feature_graph::biquad::process(int channel, double input)
+{
+  // ]uڌ`II
+  const double output = b0 * input + z1[channel];
+  z1[channel] = b1 * input - a1 * output + z2[channel];
+  z2[channel] = b2 * input - a2 * output;
+  return output;
+}
+
+feature_graph::feature_graph(int sampling_rate)
+  : sampling_rate(sampling_rate)
+  , beat(sampling_rate)
+  , vu_history(history_capacity, history_factor, history_levels)
+  , rms_history(history_capacity, history_factor, history_levels)
+  , fft(packet_size)
+  , window(packet_size)
+  , frame(packet_size)
+  , spectrum(packet_size / 2 + 1)
+  , has_previous_bands(false)
+  , onset(0.0f)
+  , loudness_head(0)
+  , loudness_sum(0.0)
+  , loudness(static_cast<float>(min_loudness))
+  , track(sampling_rate, packet_size)
+  , track_changed(false)
+{
+  for (auto& count : subscribers) {
+    count = 0;
+  }
+  active.fill(false);
+  newly_active.fill(false);
+  cost.fill(0.0f);
+  runs.fill(0);
+
+  const double two_pi = 6.283185307179586;
+  for (size_t index = 0; index < window.size(); ++index) {
+    window[index] = static_cast<float>(0.5 - 0.5 * cos(two_pi * index / window.size()));
+  }
+  // LoopbackAudioSource.csƓArΐԊu8ɕ
+  const size_t half = packet_size / 2;
+  size_t previous_end = 1;
+  for (int band = 0; band < num_bands; ++band) {
+    size_t end = static_cast<size_t>(ceil(exp(log(static_cast<double>(half)) / num_bands * (band + 1))));
+    end = end > previous_end ? end : previous_end + 1;
+    band_ends[band] = band == num_bands - 1 ? half + 1 : end;
+    previous_end = band_ends[band];
+  }
+  band_levels.fill(0.0f);
+  previous_log_bands.fill(0.0f);
+
+  // KBITU-R BS.17702ĩtB^A48kHzȊOłɂȂ悤oꎟϊŐ݌v
+  const double pi = 3.141592653589793;
+  {
+    const double f0 = 1681.974450955533;
+    const double gain_db = 3.999843853973347;
+    const double q = 0.7071752369554196;
+    const double k = tan(pi * f0 / sampling_rate);
+    const double vh = pow(10.0, gain_db / 20.0);
+    const double vb = pow(vh, 0.4996667741545416);
+    const double a0 = 1.0 + k / q + k * k;
+    shelf.b0 = (vh + vb * k / q + k * k) / a0;
+    shelf.b1 = 2.0 * (k * k - vh) / a0;
+    shelf.b2 = (vh - vb * k / q + k * k) / a0;
+    shelf.a1 = 2.0 * (k * k - 1.0) / a0;
+    shelf.a2 = (1.0 - k / q + k * k) / a0;
+  }
+  {
+    const double f0 = 38.13547087602444;
+    const double q = 0.5003270373238773;
+    const double k = tan(pi * f0 / sampling_rate);
+    const double a0 = 1.0 + k / q + k * k;
+    highpass.b0 = 1.0;
+    highpass.b1 = -2.0;
+    highpass.b2 = 1.0;
+    highpass.a1 = 2.0 * (k * k - 1.0) / a0;
+    highpass.a2 = (1.0 - k / q + k * k) / a0;
+  }
+  const size_t window_packets = static_cast<size_t>(loudness_window_seconds * sampling_rate / packet_size + 0.5);
+  loudness_blocks.assign(window_packets > 0 ? window_packets : 1, 0.0);
+  clear_loudness();
+}
+
+void feature_graph::subscribe(Feature feature)
+{
+  ++subscribers[index_of(feature)];
+}
+
+void feature_graph::unsubscribe(Feature feature)
+{
+  auto& count = subscribers[index_of(feature)];
+  int current = count;
+  while (current > 0 && !count.compare_exchange_weak(current, current - 1)) {
+  }
+}
+
+int feature_graph::get_subscribers(Feature feature)
+{
+  return subscribers[index_of(feature)];
+}
+
+bool feature_graph::is_active(Feature feature)
+{
+  return active[index_of(feature)];
+}
+
+void feature_graph::update_active()
+{
+  std::array<bool, num_features> next;
+  for (size_t index = 0; index < num_features; ++index) {
+    next[index] = subscribers[index] > 0;
+  }
+  // ˑ̘A͒ẐŁAςȂȂ܂ŒH
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    for (size_t index = 0; index < num_features; ++index) {
+      const auto dependency = dependencies[index];
+      if (next[index] && dependency != Feature::Max && !next[index_of(dependency)]) {
+        next[index_of(dependency)] = true;
+        changed = true;
+      }
+    }
+  }
+  for (size_t index = 0; index < num_features; ++index) {
+    newly_active[index] = next[index] && !active[index];
+    active[index] = next[index];
+  }
+}
+
+void feature_graph::record_cost(Feature feature, long long nanoseconds)
+{
+  const auto index = index_of(feature);
+  const float microseconds = static_cast<float>(nanoseconds) / 1000.0f;
+  cost[index] = runs[index] == 0 ? microseconds : cost[index] + (microseconds - cost[index]) * cost_smoothing;
+  ++runs[index];
+}
+
+void feature_graph::process(const std::vector<float>& left, const std::vector<float>& right)
+{
+  assert(left.size() == right.size() && left.size() % packet_size == 0);
+  update_active();
+  if (left.empty()) {
+    return;
+  }
+  const size_t num_packets = left.size() / packet_size;
+
+  // ˑ悩珇ɁAzbvŜ܂Ƃ߂ČvZ
+  if (active[index_of(Feature::Vu)]) {
+    stopwatch timer;
+    packet_vu.resize(num_packets);
+    for (size_t packet = 0; packet < num_packets; ++packet) {
+      packet_vu[packet] = beat_analyzer::measure_vu(left.data() + packet * packet_size, right.data() + packet * packet_size);
+      vu_history.push(packet_vu[packet]);
+      if (!active[index_of(Feature::Tempo)]) {
+        beat.push_vu(packet_vu[packet]);
+      }
+    }
+    record_cost(Feature::Vu, timer.elapsed_nanoseconds());
+  }
+  if (active[index_of(Feature::Rms)]) {
+    stopwatch timer;
+    for (size_t packet = 0; packet < num_packets; ++packet) {
+      const float rms = beat_analyzer::measure_rms(left.data() + packet * packet_size, right.data() + packet * packet_size);
+      beat.push_rms(rms);
+      rms_history.push(rms);
+    }
+    record_cost(Feature::Rms, timer.elapsed_nanoseconds());
+  }
+  if (active[index_of(Feature::Tempo)]) {
+    // XRA̓pPbgɂ̎_̑ōXV̂ŁAVU1ȂvZ
+    stopwatch timer;
+    for (size_t packet = 0; packet < num_packets; ++packet) {
+      beat.push_vu(packet_vu[packet]);
+      beat.update_score();
+    }
+    beat.update_tempo();
+    record_cost(Feature::Tempo, timer.elapsed_nanoseconds());
+  }
+  if (active[index_of(Feature::BeatPhase)]) {
+    stopwatch timer;
+    beat.update_phase(left.size(), newly_active[index_of(Feature::BeatPhase)]);
+    record_cost(Feature::BeatPhase, timer.elapsed_nanoseconds());
+  }
+  if (active[index_of(Feature::Bands)]) {
+    stopwatch timer;
+    run_bands(left, right, num_packets);
+    record_cost(Feature::Bands, timer.elapsed_nanoseconds());
+  }
+  if (active[index_of(Feature::Onset)]) {
+    stopwatch timer;
+    run_onset(num_packets);
+    record_cost(Feature::Onset, timer.elapsed_nanoseconds());
+  }
+  if (active[index_of(Feature::Loudness)]) {
+    stopwatch timer;
+    run_loudness(left, right);
+    record_cost(Feature::Loudness, timer.elapsed_nanoseconds());
+  }
+  track_changed = false;
+  if (active[index_of(Feature::TrackChange)]) {
+    stopwatch timer;
+    run_track_change(num_packets);
+    record_cost(Feature::TrackChange, timer.elapsed_nanoseconds());
+  }
+}
+
+void feature_graph::process_silence(size_t num_samples)
+{
+  assert(num_samples % packet_size == 0);
+  update_active();
+  if (num_samples == 0) {
+    return;
+  }
+
+  if (active[index_of(Feature::Vu)] || active[index_of(Feature::Rms)]) {
+    // ܂܂ł͖Aȍ~͔̈ʒui߂
+    beat.process_silence(num_samples);
+  }
+  if (active[index_of(Feature::Vu)]) {
+    vu_history.push_repeated(0.0f, num_samples / packet_size);
+  }
+  if (active[index_of(Feature::Rms)]) {
+    rms_history.push_repeated(0.0f, num_samples / packet_size);
+  }
+  if (active[index_of(Feature::Bands)]) {
+    band_levels.fill(0.0f);
+  }
+  if (active[index_of(Feature::Onset)]) {
+    // ߂ŏ̃pPbg𗧂オƂďE悤AȎшɂ
+    previous_log_bands.fill(0.0f);
+    has_previous_bands = true;
+    onset = 0.0f;
+  }
+  track_changed = false;
+  if (active[index_of(Feature::TrackChange)]) {
+    track.push_silence(num_samples / packet_size);
+  }
+  if (active[index_of(Feature::Loudness)]) {
+    const size_t num_packets = num_samples / packet_size;
+    if (num_packets >= loudness_blocks.size()) {
+      clear_loudness();
+    } else {
+      for (size_t packet = 0; packet < num_packets; ++packet) {
+        push_loudness_block(0.0);
+      }
+      shelf.clear();
+      highpass.clear();
+    }
+  }
+}
+
+void feature_graph::reset()
+{
+  beat.reset();
+  vu_history.clear();
+  rms_history.clear();
+  clear_bands();
+  clear_loudness();
+  track.clear();
+  track_changed = false;
+}
+
+void feature_graph::run_bands(const std::vector<float>& left, const std::vector<float>& right, size_t num_packets)
+{
+  if (newly_active[index_of(Feature::Bands)]) {
+    clear_bands();
+  }
+  packet_bands.resize(num_packets);
+  std::array<float, num_bands> sum;
+  sum.fill(0.0f);
+  // n̘apacket_size/2Ȃ̂ŁAg̐Û܂܏o悤߂
+  const float scale = 4.0f / packet_size;
+  for (size_t packet = 0; packet < num_packets; ++packet) {
+    const float* left_packet = left.data() + packet * packet_size;
+    const float* right_packet = right.data() + packet * packet_size;
+    for (size_t index = 0; index < frame.size(); ++index) {
+      frame[index] = 0.5f * (left_packet[index] + right_packet[index]) * window[index];
+    }
+    fft.forward(frame.data(), spectrum.data());
+    size_t bin = 1;
+    for (int band = 0; band < num_bands; ++band) {
+      float power = 0.0f;
+      const size_t begin = bin;
+      for (; bin < band_ends[band]; ++bin) {
+        power += std::norm(spectrum[bin]);
+      }
+      const float level = sqrtf(power / static_cast<float>(band_ends[band] - begin)) * scale;
+      packet_bands[packet][band] = level;
+      sum[band] += level;
+    }
+  }
+  for (int band = 0; band < num_bands; ++band) {
+    band_levels[band] = sum[band] / num_packets;
+  }
+}
+
+void feature_graph::run_onset(size_t num_packets)
+{
+  if (newly_active[index_of(Feature::Onset)]) {
+    has_previous_bands = false;
+  }
+  // ΐňkш̐Ȗ𑫂
+  float peak = 0.0f;
+  for (size_t packet = 0; packet < num_packets; ++packet) {
+    std::array<float, num_bands> log_bands;
+    float flux = 0.0f;
+    for (int band = 0; band < num_bands; ++band) {
+      log_bands[band] = std::log1p(packet_bands[packet][band] * 100.0f);
+      const float rise = log_bands[band] - previous_log_bands[band];
+      flux += has_previous_bands && rise > 0.0f ? rise : 0.0f;
+    }
+    previous_log_bands = log_bands;
+    has_previous_bands = true;
+    peak = flux > peak ? flux : peak;
+  }
+  onset = peak;
+}
+
+void feature_graph::run_loudness(const std::vector<float>& left, const std::vector<float>& right)
+{
+  if (newly_active[index_of(Feature::Loudness)]) {
+    clear_loudness();
+  }
+  const size_t num_packets = left.size() / packet_size;
+  for (size_t packet = 0; packet < num_packets; ++packet) {
+    // Ȅd݂1.0
+    double square_sum = 0.0;
+    for (size_t index = packet * packet_size; index < (packet + 1) * packet_size; ++index) {
+      const double filtered_left = highpass.process(0, shelf.process(0, left[index]));
+      const double filtered_right = highpass.process(1, shelf.process(1, right[index]));
+      square_sum += filtered_left * filtered_left + filtered_right * filtered_right;
+    }
+    push_loudness_block(square_sum / packet_size);
+  }
+}
+
+void feature_graph::run_track_change(size_t num_packets)
+{
+  if (newly_active[index_of(Feature::TrackChange)]) {
+    track.clear();
+  }
+  for (size_t packet = 0; packet < num_packets; ++packet) {
+    track_changed = track.push(packet_bands[packet]) || track_changed;
+  }
+  if (track_changed && active[index_of(Feature::Tempo)]) {
+    // ŐȂVU甲̂҂ɁAVȂ̕Ńe|ߒ
+    beat.rebase(track.get_track_packets());
+  }
+}
+
+void feature_graph::push_loudness_block(double block)
+{
+  loudness_sum += block - loudness_blocks[loudness_head];
+  loudness_blocks[loudness_head] = block;
+  loudness_head = (loudness_head + 1) % loudness_blocks.size();
+  // ̌덷ŕɂȂȂ悤ɂ
+  const double mean = (std::max)(loudness_sum, 0.0) / loudness_blocks.size();
+  const double value = mean > 0.0 ? -0.691 + 10.0 * log10(mean) : min_loudness;
+  loudness = static_cast<float>(value > min_loudness ? value : min_loudness);
+}
+
+void feature_graph::clear_bands()
+{
+  band_levels.fill(0.0f);
+  previous_log_bands.fill(0.0f);
+  has_previous_bands = false;
+  onset = 0.0f;
+}
+
+void feature_graph::clear_loudness()
+{
+  shelf.clear();
+  highpass.clear();
+  std::fill(loudness_blocks.begin(), loudness_blocks.end(), 0.0);
+  loudness_head = 0;
+  loudness_sum = 0.0;
+  loudness = static_cast<float>(min_loudness);
+}
+
+beat_analyzer& feature_graph::get_beat()
+{
+  return beat;
+}
+
+unsigned long long feature_graph::get_track_changes()
+{
+  return track.get_changes();
+}
+
+bool feature_graph::is_track_changed()
+{
+  return track_changed;
+}
+
+float feature_graph::get_onset()
+{
+  return onset;
+}
+
+float feature_graph::get_band_level(int band)
+{
+  return band_levels[band];
+}
+
+float feature_graph::get_loudness()
+{
+  return loudness;
+}
+
+size_t feature_graph::get_history(Feature feature, size_t span, size_t width, float* minimum, float* maximum, float* mean)
+{
+  switch (feature) {
+  case Feature::Vu:
+    return vu_history.fetch(span, width, minimum, maximum, mean);
+  case Feature::Rms:
+    return rms_history.fetch(span, width, minimum, maximum, mean);
+  default:
+    // ȂBĂяõobt@ŝ܂ܕԂȂ悤0Ŗ߂
+    for (float* output : { minimum, maximum, mean }) {
+      if (output) {
+        std::fill(output, output + width, 0.0f);
+      }
+    }
+    return 0;
+  }
+}
+
+float feature_graph::get_cost(Feature feature)
+{
+  return cost[index_of(feature)];
+}
+
+unsigned long long feature_graph::get_runs(Feature feature)
+{
+  return runs[index_of(feature)];
+}
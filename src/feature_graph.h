@@ -0,0 +1,131 @@
+#pragma once
+#include "beat_analyzer.h"
+#include "fft.h"
+#include "history_pyramid.h"
+#include "track_change_detector.h"
+#include <vector>
+#include <array>
+#include <complex>
+#include <atomic>
+#include <cstddef>
+
+// ͂ŋ߂ʁBSubscribeFeature̔ԍƓ
+enum class Feature : int
+{
+  Vu,         // pPbg̐U̗
+  Rms,        // pPbgRMS̗
+  Onset,      // ш斈̘̑a(XyNgtbNX)BBandsɈˑ
+  Tempo,      // VU̗BPMTBVuɈˑ
+  BeatPhase,  // ̔܂ł̎ԁBTempoɈˑ
+  Bands,      // ΐԊu8ш̃x
+  Loudness,   // K|400ms̕ [LUFS]
+  TrackChange,  // Ȃ̐؂ւ̌oBBandsɈˑATempovZĂΐ؂ւe|T
+  Max,
+};
+
+// ʂ̈ˑ֌WAwǂĂʂƂ̈ˑ悾zbvɌvZB
+// wǐ̑͂ǂ̃Xbhł悭Aprocess/process_silenceƎ擾Analyzer::updateƓXbhĂ
+class feature_graph
+{
+public:
+  static const int packet_size = beat_analyzer::packet_size;
+  static const int num_bands = 8;
+  // ̃EhlX [LUFS]
+  static const int min_loudness = -70;
+
+  explicit feature_graph(int sampling_rate);
+
+  void subscribe(Feature feature);
+  void unsubscribe(Feature feature);
+  int get_subscribers(Feature feature);
+  // ÕzbvŌvZBwǂĂȂĂAwǒ̓ʂˑĂΌvZ
+  bool is_active(Feature feature);
+
+  // left/rightpacket_size̔{̒
+  void process(const std::vector<float>& left, const std::vector<float>& right);
+  // num_samples(packet_size̔{)̖i߂BVU/RMS/e|͑Ŗ܂͌vZȂ
+  void process_silence(size_t num_samples);
+  void reset();
+
+  beat_analyzer& get_beat();
+  // Õzbvōő̃IZbgx
+  float get_onset();
+  // Õzbvŕςш̐UB0łႢш
+  float get_band_level(int band);
+  float get_loudness();
+  // ܂łɌoȂ̐؂ւ̉񐔂ƁAÕzbvŌo
+  unsigned long long get_track_changes();
+  bool is_track_changed();
+  // VURMS̒span(pPbgP)Awidth̍ŏ/ő/ςɂ܂Ƃ߂ĎoBl̂̐ԂB
+  // ̓ʂ͗Ȃ̂ŁAo͂0Ŗ߂0Ԃ
+  size_t get_history(Feature feature, size_t span, size_t width, float* minimum, float* maximum, float* mean);
+
+  // zbv1񂠂̌vZԂ̈ړ [us]ƁAvZzbv
+  float get_cost(Feature feature);
+  unsigned long long get_runs(Feature feature);
+
+private:
+  // wǐÃzbvŌvZʂ߂BVɌvZn߂ʂnewly_activeɗĂ
+  void update_active();
+  void record_cost(Feature feature, long long nanoseconds);
+
+  void run_bands(const std::vector<float>& left, const std::vector<float>& right, size_t num_packets);
+  void run_onset(size_t num_packets);
+  void run_loudness(const std::vector<float>& left, const std::vector<float>& right);
+  void run_track_change(size_t num_packets);
+  // 1pPbg̕ϓ𑋂֓A̕ς烉EhlXߒ
+  void push_loudness_block(double block);
+  void clear_bands();
+  void clear_loudness();
+
+  // 2IIRBK2iŎg
+  struct biquad
+  {
+    double b0, b1, b2, a1, a2;
+    std::array<double, 2> z1;
+    std::array<double, 2> z2;
+
+    void clear();
+    double process(int channel, double input);
+  };
+
+  int sampling_rate;
+  beat_analyzer beat;
+  std::array<std::atomic<int>, static_cast<size_t>(Feature::Max)> subscribers;
+  std::array<bool, static_cast<size_t>(Feature::Max)> active;
+  std::array<bool, static_cast<size_t>(Feature::Max)> newly_active;
+  std::array<float, static_cast<size_t>(Feature::Max)> cost;
+  std::array<unsigned long long, static_cast<size_t>(Feature::Max)> runs;
+
+  // zbṽpPbgVUBTempovZ鎞Tempo֓
+  std::vector<float> packet_vu;
+  // \p̒Bbeat_analyzeȓk
+  history_pyramid vu_history;
+  history_pyramid rms_history;
+
+  // BandsBband_ends͊eш̏Ĩr
+  real_fft fft;
+  std::vector<float> window;
+  std::vector<float> frame;
+  std::vector<std::complex<float>> spectrum;
+  std::array<size_t, num_bands> band_ends;
+  std::vector<std::array<float, num_bands>> packet_bands;
+  std::array<float, num_bands> band_levels;
+
+  // OnsetBÕpPbg̑ш̐UΐŎ
+  std::array<float, num_bands> previous_log_bands;
+  bool has_previous_bands;
+  float onset;
+
+  // LoudnessBpPbg̕ϓ400ms̃OɎ
+  biquad shelf;
+  biquad highpass;
+  std::vector<double> loudness_blocks;
+  size_t loudness_head;
+  double loudness_sum;
+  float loudness;
+
+  // TrackChange
+  track_change_detector track;
+  bool track_changed;
+};
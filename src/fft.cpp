@@ -0,0 +1,124 @@
+#include "fft.h"
+#include <cmath>
+#include <stdexcept>
+
+real_fft::real_fft(size_t size)
+  : length(size)
+{
+  if (size < 4 || (size & (size - 1)) != 0) {
+    throw std::runtime_error("Failed to create FFT of non power of two size.");
+  }
+
+  const double two_pi = 6.283185307179586;
+  const size_t half = size / 2;
+  twiddles.resize(half / 2);
+  for (size_t index = 0; index < twiddles.size(); ++index) {
+    const double angle = -two_pi * index / half;
+    twiddles[index] = std::complex<float>(static_cast<float>(cos(angle)), static_cast<float>(sin(angle)));
+  }
+  split_twiddles.resize(half + 1);
+  for (size_t index = 0; index < split_twiddles.size(); ++index) {
+    const double angle = -two_pi * index / size;
+    split_twiddles[index] = std::complex<float>(static_cast<float>(cos(angle)), static_cast<float>(sin(angle)));
+  }
+
+  size_t bits = 0;
+  while ((static_cast<size_t>(1) << bits) < half) {
+    ++bits;
+  }
+  bit_reverse.resize(half);
+  for (size_t index = 0; index < half; ++index) {
+    size_t reversed = 0;
+    for (size_t bit = 0; bit < bits; ++bit) {
+      reversed |= ((index >> bit) & 1) << (bits - 1 - bit);
+    }
+    bit_reverse[index] = reversed;
+  }
+  work.resize(half);
+}
+
+size_t real_fft::size() const
+{
+  return length;
+}
+
+void real_fft::transform(bool inverse)
+{
+  const size_t half = length / 2;
+  for (size_t index = 0; index < half; ++index) {
+    if (index < bit_reverse[index]) {
+      std::swap(work[index], work[bit_reverse[index]]);
+    }
+  }
+  // std::complex̉ZʂɎƋŌvZ
+  float* data = reinterpret_cast<float*>(work.data());
+  const float* factors = reinterpret_cast<const float*>(twiddles.data());
+  const float sign = inverse ? -1.0f : 1.0f;
+  for (size_t span = 2; span <= half; span <<= 1) {
+    const size_t step = half / span;
+    const size_t middle = span / 2;
+    for (size_t start = 0; start < half; start += span) {
+      float* even = data + start * 2;
+      float* odd = data + (start + middle) * 2;
+      for (size_t offset = 0; offset < middle; ++offset) {
+        const float twiddle_real = factors[offset * step * 2];
+        const float twiddle_imag = sign * factors[offset * step * 2 + 1];
+        const float odd_real = odd[offset * 2] * twiddle_real - odd[offset * 2 + 1] * twiddle_imag;
+        const float odd_imag = odd[offset * 2] * twiddle_imag + odd[offset * 2 + 1] * twiddle_real;
+        odd[offset * 2] = even[offset * 2] - odd_real;
+        odd[offset * 2 + 1] = even[offset * 2 + 1] - odd_imag;
+        even[offset * 2] += odd_real;
+        even[offset * 2 + 1] += odd_imag;
+      }
+    }
+  }
+}
+
+void real_fft::forward(const float* input, std::complex<float>* output)
+{
+  // ԖڂAԖڂɋl߂Ĕ̒ŕϊÃXyNgɕč
+  const size_t half = length / 2;
+  for (size_t index = 0; index < half; ++index) {
+    work[index] = std::complex<float>(input[2 * index], input[2 * index + 1]);
+  }
+  transform(false);
+
+  // X[k] = (Z[k] + conj(Z[N/2-k])) / 2 + W^k (Z[k] - conj(Z[N/2-k])) / 2i
+  for (size_t index = 0; index <= half; ++index) {
+    const auto z = work[index == half ? 0 : index];
+    const auto z_mirror = work[index == 0 ? 0 : half - index];
+    const float even_real = 0.5f * (z.real() + z_mirror.real());
+    const float even_imag = 0.5f * (z.imag() - z_mirror.imag());
+    const float odd_real = 0.5f * (z.imag() + z_mirror.imag());
+    const float odd_imag = -0.5f * (z.real() - z_mirror.real());
+    const auto twiddle = split_twiddles[index];
+    output[index] = std::complex<float>(
+      even_real + twiddle.real() * odd_real - twiddle.imag() * odd_imag,
+      even_imag + twiddle.real() * odd_imag + twiddle.imag() * odd_real);
+  }
+}
+
+void real_fft::inverse(const std::complex<float>* input, float* output)
+{
+  const size_t half = length / 2;
+  // Z[k] = E[k] + i O[k]BE[k] = (X[k] + conj(X[N/2-k])) / 2, O[k] = (X[k] - conj(X[N/2-k])) / 2 * conj(W^k)
+  for (size_t index = 0; index < half; ++index) {
+    const auto x = input[index];
+    const auto x_mirror = input[half - index];
+    const float even_real = 0.5f * (x.real() + x_mirror.real());
+    const float even_imag = 0.5f * (x.imag() - x_mirror.imag());
+    const float difference_real = 0.5f * (x.real() - x_mirror.real());
+    const float difference_imag = 0.5f * (x.imag() + x_mirror.imag());
+    const auto twiddle = split_twiddles[index];
+    const float odd_real = difference_real * twiddle.real() + difference_imag * twiddle.imag();
+    const float odd_imag = difference_imag * twiddle.real() - difference_real * twiddle.imag();
+    work[index] = std::complex<float>(even_real - odd_imag, even_imag + odd_real);
+  }
+  transform(true);
+
+  const float scale = 1.0f / half;
+  for (size_t index = 0; index < half; ++index) {
+    output[2 * index] = work[index].real() * scale;
+    output[2 * index + 1] = work[index].imag() * scale;
+  }
+}
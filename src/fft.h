@@ -0,0 +1,27 @@
+#pragma once
+#include <complex>
+#include <vector>
+
+// 2ׂ̂撷̎FFTBsize/2̕fFFTɋl߂ČvZB
+// ]qƍƗ͍̈쐬ɊmۂAϊ͊mۂȂ
+class real_fft
+{
+public:
+  explicit real_fft(size_t size);
+
+  size_t size() const;
+  // inputsize̎Aoutputsize/2+1̕f
+  void forward(const float* input, std::complex<float>* output);
+  // inputsize/2+1̕fAoutputsize̎Bforward̋tϊɂȂ悤K
+  void inverse(const std::complex<float>* input, float* output);
+
+private:
+  void transform(bool inverse);
+
+  size_t length;
+  // size/2̕fFFTpƁAւ̓WJp̉]q
+  std::vector<std::complex<float>> twiddles;
+  std::vector<std::complex<float>> split_twiddles;
+  std::vector<size_t> bit_reverse;
+  std::vector<std::complex<float>> work;
+};
@@ -0,0 +1,235 @@
+#include "halfband_resampler.h"
+#include <array>
+#include <cmath>
+#include <cassert>
+#include <algorithm>
+
+namespace
+{
+// ^bv4k+3BSȊŐԖڂ[ɂȂ
+const int num_taps = 47;
+const int center = (num_taps - 1) / 2;
+const int num_pairs = (center + 1) / 2;
+const double kaiser_beta = 8.0;
+
+double bessel_i0(double x)
+{
+  double sum = 1.0;
+  double term = 1.0;
+  for (int k = 1; k < 32; ++k) {
+    term *= (x / (2.0 * k)) * (x / (2.0 * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// S獶̔[WBE͑Ώ
+std::array<float, num_pairs> design_coefficients()
+{
+  const double pi = 3.14159265358979323846;
+  std::array<double, num_pairs> coefficients;
+  double sum = 0.5;
+  for (int k = 0; k < num_pairs; ++k) {
+    const int tap = 2 * k;
+    const double t = (tap - center) / 2.0;
+    const double sinc = sin(pi * t) / (pi * t);
+    const double r = (2.0 * tap) / (num_taps - 1) - 1.0;
+    const double window = bessel_i0(kaiser_beta * sqrt(1.0 - r * r)) / bessel_i0(kaiser_beta);
+    coefficients[k] = 0.5 * sinc * window;
+    sum += 2.0 * coefficients[k];
+  }
+  // DCQC1ɐK
+  std::array<float, num_pairs> result;
+  for (int k = 0; k < num_pairs; ++k) {
+    result[k] = static_cast<float>(coefficients[k] / sum);
+  }
+  return result;
+}
+
+const std::array<float, num_pairs>& side_coefficients()
+{
+  static const auto coefficients = design_coefficients();
+  return coefficients;
+}
+
+float center_coefficient()
+{
+  static const float coefficient = [] {
+    double sum = 0.0;
+    for (auto c : side_coefficients()) {
+      sum += 2.0 * c;
+    }
+    return static_cast<float>(1.0 - sum);
+  }();
+  return coefficient;
+}
+}
+
+halfband_decimator::halfband_decimator(size_t max_input_frames)
+{
+  work.assign(num_taps - 1 + max_input_frames, 0.0f);
+}
+
+void halfband_decimator::process(const float* input, size_t input_stride, size_t input_frames, float* output, size_t output_stride)
+{
+  assert(input_frames % 2 == 0);
+  const size_t history = num_taps - 1;
+  if (work.size() < history + input_frames) {
+    work.resize(history + input_frames);
+  }
+  for (size_t i = 0; i < input_frames; ++i) {
+    work[history + i] = input[i * input_stride];
+  }
+
+  const auto& c = side_coefficients();
+  const float c_center = center_coefficient();
+  for (size_t n = 0; n < input_frames / 2; ++n) {
+    const float* x = &work[history + 2 * n];
+    float acc = c_center * x[-center];
+    for (int k = 0; k < num_pairs; ++k) {
+      acc += c[k] * (x[-2 * k] + x[-(num_taps - 1 - 2 * k)]);
+    }
+    output[n * output_stride] = acc;
+  }
+
+  std::copy(work.begin() + input_frames, work.begin() + input_frames + history, work.begin());
+}
+
+int halfband_decimator::get_latency()
+{
+  return center;
+}
+
+halfband_interpolator::halfband_interpolator(size_t max_input_frames)
+{
+  work.assign(center + max_input_frames, 0.0f);
+}
+
+void halfband_interpolator::process(const float* input, size_t input_stride, size_t input_frames, float* output, size_t output_stride)
+{
+  const size_t history = center;
+  if (work.size() < history + input_frames) {
+    work.resize(history + input_frames);
+  }
+  for (size_t i = 0; i < input_frames; ++i) {
+    work[history + i] = input[i * input_stride];
+  }
+
+  // [}̃QC2WɊ|
+  const auto& c = side_coefficients();
+  const float c_center = 2.0f * center_coefficient();
+  for (size_t n = 0; n < input_frames; ++n) {
+    const float* x = &work[history + n];
+    float even = 0.0f;
+    for (int k = 0; k < num_pairs; ++k) {
+      even += c[k] * (x[-k] + x[-(center - k)]);
+    }
+    output[(2 * n) * output_stride] = 2.0f * even;
+    output[(2 * n + 1) * output_stride] = c_center * x[-(center - 1) / 2];
+  }
+
+  std::copy(work.begin() + input_frames, work.begin() + input_frames + history, work.begin());
+}
+
+int halfband_interpolator::get_latency()
+{
+  return center;
+}
+
+halfband_resampler::halfband_resampler(int factor, int num_channels, size_t max_frames)
+  : factor(factor)
+  , num_channels(num_channels)
+  , max_frames(max_frames)
+{
+  assert(factor >= 2 && (factor & (factor - 1)) == 0);
+  size_t frames = max_frames;
+  for (int stage_factor = 1; stage_factor < factor; stage_factor *= 2) {
+    decimators.emplace_back();
+    interpolators.emplace_back();
+    for (int channel = 0; channel < num_channels; ++channel) {
+      decimators.back().emplace_back(new halfband_decimator(frames));
+      interpolators.back().emplace_back(new halfband_interpolator(frames / 2));
+    }
+    frames /= 2;
+  }
+  low_rate_input.assign(max_frames / factor * num_channels, 0.0f);
+  low_rate_output.assign(max_frames / factor * num_channels, 0.0f);
+  stage_buffer_a.assign(max_frames / 2, 0.0f);
+  stage_buffer_b.assign(max_frames / 2, 0.0f);
+}
+
+int halfband_resampler::get_factor()
+{
+  return factor;
+}
+
+int halfband_resampler::get_num_channels()
+{
+  return num_channels;
+}
+
+size_t halfband_resampler::get_max_frames()
+{
+  return max_frames;
+}
+
+int halfband_resampler::get_latency_samples()
+{
+  // eĩfV[^ƃC^[|[^̌Qx̃[gɊZđ
+  int latency = 0;
+  int rate_divider = 1;
+  for (size_t stage = 0; stage < decimators.size(); ++stage) {
+    latency += halfband_decimator::get_latency() * rate_divider;
+    latency += halfband_interpolator::get_latency() * rate_divider;
+    rate_divider *= 2;
+  }
+  return latency;
+}
+
+float* halfband_resampler::decimate(const float* input, unsigned int length)
+{
+  assert(length % factor == 0 && length <= max_frames);
+  const size_t num_stages = decimators.size();
+  for (int channel = 0; channel < num_channels; ++channel) {
+    const float* source = input + channel;
+    size_t source_stride = num_channels;
+    size_t frames = length;
+    for (size_t stage = 0; stage < num_stages; ++stage) {
+      const bool last = (stage + 1 == num_stages);
+      float* destination = last ? low_rate_input.data() + channel : (stage % 2 == 0 ? stage_buffer_a.data() : stage_buffer_b.data());
+      const size_t destination_stride = last ? num_channels : 1;
+      decimators[stage][channel]->process(source, source_stride, frames, destination, destination_stride);
+      source = destination;
+      source_stride = destination_stride;
+      frames /= 2;
+    }
+  }
+  return low_rate_input.data();
+}
+
+float* halfband_resampler::get_low_rate_output()
+{
+  return low_rate_output.data();
+}
+
+void halfband_resampler::interpolate(float* output, unsigned int length)
+{
+  assert(length % factor == 0 && length <= max_frames);
+  const size_t num_stages = interpolators.size();
+  for (int channel = 0; channel < num_channels; ++channel) {
+    const float* source = low_rate_output.data() + channel;
+    size_t source_stride = num_channels;
+    size_t frames = length / factor;
+    // ჌[g̒i珇2{Ă
+    for (size_t step = 0; step < num_stages; ++step) {
+      const size_t stage = num_stages - 1 - step;
+      const bool last = (stage == 0);
+      float* destination = last ? output + channel : (step % 2 == 0 ? stage_buffer_a.data() : stage_buffer_b.data());
+      const size_t destination_stride = last ? num_channels : 1;
+      interpolators[stage][channel]->process(source, source_stride, frames, destination, destination_stride);
+      source = destination;
+      source_stride = destination_stride;
+      frames *= 2;
+    }
+  }
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <vector>
+#include <memory>
+
+// n[tohFIRɂ1/2ԈBW̔0ɂȂ̂Ŕ[̃^bvvZ
+class halfband_decimator
+{
+public:
+  halfband_decimator(size_t max_input_frames);
+  // input_frames ͋ł邱ƁBo͂ input_frames / 2 Tv
+  void process(const float* input, size_t input_stride, size_t input_frames, float* output, size_t output_stride);
+  static int get_latency();  // ̓TvPʂ̌Qx
+
+private:
+  std::vector<float> work;
+};
+
+// n[tohFIRɂ2{ԁB/o͂2ɕČvZ
+class halfband_interpolator
+{
+public:
+  halfband_interpolator(size_t max_input_frames);
+  // o͂ input_frames * 2 Tv
+  void process(const float* input, size_t input_stride, size_t input_frames, float* output, size_t output_stride);
+  static int get_latency();  // o̓TvPʂ̌Qx
+
+private:
+  std::vector<float> work;
+};
+
+// 48kHz𒴂TvOgSpatializer𓮂߁A
+// 2ׂ̂敪1ɊԈďÃ[g֕ԂĖ߂
+class halfband_resampler
+{
+public:
+  halfband_resampler(int factor, int num_channels, size_t max_frames);
+
+  int get_factor();
+  int get_num_channels();
+  size_t get_max_frames();
+  int get_latency_samples();  // ̃[gł̒ǉx
+
+  // C^[[uꂽ͂length / factort[֊ԈA̐擪Ԃ
+  float* decimate(const float* input, unsigned int length);
+  // Spatializeȑo͂ޒ჌[g̃obt@
+  float* get_low_rate_output();
+  // get_low_rate_output()̓elengtht[֕Ԃoutput֏
+  void interpolate(float* output, unsigned int length);
+
+private:
+  int factor;
+  int num_channels;
+  size_t max_frames;
+  // [i][`l]
+  std::vector<std::vector<std::unique_ptr<halfband_decimator>>> decimators;
+  std::vector<std::vector<std::unique_ptr<halfband_interpolator>>> interpolators;
+  std::vector<float> low_rate_input;
+  std::vector<float> low_rate_output;
+  std::vector<float> stage_buffer_a;
+  std::vector<float> stage_buffer_b;
+};
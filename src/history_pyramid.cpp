@@ -0,0 +1,180 @@
+#include "history_pyramid.h"
+#include <cassert>
+#include <cfloat>
+
+void history_pyramid::summary::clear()
+{
+  minimum = FLT_MAX;
+  maximum = -FLT_MAX;
+  sum = 0.0;
+  count = 0;
+}
+
+void history_pyramid::summary::merge(float entry_minimum, float entry_maximum, double entry_sum, size_t entry_count)
+{
+  minimum = entry_minimum < minimum ? entry_minimum : minimum;
+  maximum = entry_maximum > maximum ? entry_maximum : maximum;
+  sum += entry_sum;
+  count += entry_count;
+}
+
+history_pyramid::history_pyramid(size_t capacity, size_t factor, size_t num_levels)
+  : capacity(capacity)
+  , factor(factor)
+  , levels(num_levels)
+  , total(0)
+{
+  assert(capacity > 0 && factor >= 2 && num_levels > 0);
+  size_t stride = 1;
+  for (auto& target : levels) {
+    target.minimum.resize(capacity);
+    target.maximum.resize(capacity);
+    target.mean.resize(capacity);
+    target.stride = stride;
+    stride *= factor;
+  }
+  clear();
+}
+
+void history_pyramid::push(float value)
+{
+  ++total;
+  append(0, value, value, value, 1);
+}
+
+void history_pyramid::push_repeated(float value, size_t count)
+{
+  // łex钷́AÂlSď̂ők镪΂悢
+  const size_t reach = get_reach();
+  if (count > reach) {
+    // ΂ƂɂāAex̗vf̈ʒu𑵂ĂBg͑pushőSď㏑
+    total += count - reach;
+    count = reach;
+    for (size_t index = 0; index < levels.size(); ++index) {
+      auto& target = levels[index];
+      target.count = total / target.stride;
+      target.pending.clear();
+      if (index + 1 < levels.size()) {
+        const size_t carried = static_cast<size_t>(total % levels[index + 1].stride - total % target.stride);
+        if (carried > 0) {
+          target.pending.merge(value, value, static_cast<double>(value) * carried, carried);
+        }
+      }
+    }
+  }
+  for (size_t index = 0; index < count; ++index) {
+    push(value);
+  }
+}
+
+void history_pyramid::clear()
+{
+  for (auto& target : levels) {
+    target.count = 0;
+    target.pending.clear();
+  }
+  total = 0;
+}
+
+void history_pyramid::append(size_t level_index, float minimum, float maximum, double sum, size_t count)
+{
+  auto& target = levels[level_index];
+  const size_t slot = static_cast<size_t>(target.count % capacity);
+  target.minimum[slot] = minimum;
+  target.maximum[slot] = maximum;
+  target.mean[slot] = static_cast<float>(sum / count);
+  ++target.count;
+
+  if (level_index + 1 >= levels.size()) {
+    return;
+  }
+  // factor1̃x֌Jグ
+  target.pending.merge(minimum, maximum, sum, count);
+  if (target.pending.count >= levels[level_index + 1].stride) {
+    const summary carried = target.pending;
+    target.pending.clear();
+    append(level_index + 1, carried.minimum, carried.maximum, carried.sum, carried.count);
+  }
+}
+
+history_pyramid::summary history_pyramid::pending_of(size_t level_index) const
+{
+  // xkŖm̒ĺAׂx̂܂Ƃߓr̒lSč킹
+  summary result;
+  result.clear();
+  for (size_t index = 0; index < level_index; ++index) {
+    const auto& pending = levels[index].pending;
+    if (pending.count > 0) {
+      result.merge(pending.minimum, pending.maximum, pending.sum, pending.count);
+    }
+  }
+  return result;
+}
+
+size_t history_pyramid::fetch(size_t span, size_t width, float* minimum, float* maximum, float* mean) const
+{
+  if (width == 0) {
+    return 0;
+  }
+  // 11vfȏ͈͂ōłexBAspank郌xłȂ΂ȂȂ
+  size_t level_index = 0;
+  while (level_index + 1 < levels.size() &&
+         (levels[level_index + 1].stride * width <= span || levels[level_index].stride * capacity < span)) {
+    ++level_index;
+  }
+  const auto& source = levels[level_index];
+  const unsigned long long stride = source.stride;
+  const summary pending = pending_of(level_index);
+  // mvf̂A܂㏑ĂȂłÂ
+  const unsigned long long oldest = source.count > capacity ? source.count - capacity : 0;
+
+  size_t num_valid = 0;
+  for (size_t column = 0; column < width; ++column) {
+    // 񂪎󂯎̒l͈̔ [begin, end)BŏpushOւ͂ݏo͗
+    unsigned long long end_back = static_cast<unsigned long long>(span) * (width - column) / width;
+    const unsigned long long begin_back = static_cast<unsigned long long>(span) * (width - column - 1) / width;
+    if (end_back == begin_back) {
+      // 11ɖȂ́Äʒu̒lg
+      end_back = begin_back + 1;
+    }
+    summary result;
+    result.clear();
+    if (begin_back < total) {
+      const unsigned long long begin = end_back < total ? total - end_back : 0;
+      const unsigned long long end = total - begin_back;
+      unsigned long long entry = begin / stride;
+      const unsigned long long last = (end + stride - 1) / stride;
+      entry = entry > oldest ? entry : oldest;
+      for (; entry < last && entry < source.count; ++entry) {
+        const size_t slot = static_cast<size_t>(entry % capacity);
+        result.merge(source.minimum[slot], source.maximum[slot], static_cast<double>(source.mean[slot]) * stride, static_cast<size_t>(stride));
+      }
+      if (entry >= source.count && entry < last && pending.count > 0) {
+        result.merge(pending.minimum, pending.maximum, pending.sum, pending.count);
+      }
+    }
+    if (result.count > 0) {
+      ++num_valid;
+    }
+    if (minimum) {
+      minimum[column] = result.count > 0 ? result.minimum : 0.0f;
+    }
+    if (maximum) {
+      maximum[column] = result.count > 0 ? result.maximum : 0.0f;
+    }
+    if (mean) {
+      mean[column] = result.count > 0 ? static_cast<float>(result.sum / result.count) : 0.0f;
+    }
+  }
+  return num_valid;
+}
+
+unsigned long long history_pyramid::get_count() const
+{
+  return total;
+}
+
+size_t history_pyramid::get_reach() const
+{
+  return levels.back().stride * capacity;
+}
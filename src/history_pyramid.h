@@ -0,0 +1,60 @@
+#pragma once
+#include <vector>
+#include <cstddef>
+
+// \pɊԈĎs~bhB
+// x0push̒lAxkfactor^k܂Ƃ߂ŏ/ő/ςŁAǂ̃x̏zobt@B
+// push͏̃xւ̌Jオ܂߂Ē萔ԂŁAfetch͕\ɋ߂ẽxǂ
+class history_pyramid
+{
+public:
+  // capacity͊ex̒Błexcapacity * factor^(num_levels-1)k
+  history_pyramid(size_t capacity, size_t factor, size_t num_levels);
+
+  void push(float value);
+  // lcountēB̊Ԃɂ܂Ƃ߂Đi߂
+  void push_repeated(float value, size_t count);
+  void clear();
+
+  // spanwidthɂ܂Ƃ߁A񖈂̍ŏ/ő/ςÂɏ(nullptȑo͂͏Ȃ)B
+  // ȂÂ̗0Ŗ߁Al̂̐ԂBl̂͏ɉE(V)Ɋ
+  size_t fetch(size_t span, size_t width, float* minimum, float* maximum, float* mean) const;
+
+  // push
+  unsigned long long get_count() const;
+  // kő̌
+  size_t get_reach() const;
+
+private:
+  struct summary
+  {
+    float minimum;
+    float maximum;
+    double sum;
+    size_t count;
+
+    void clear();
+    void merge(float entry_minimum, float entry_maximum, double entry_sum, size_t entry_count);
+  };
+
+  struct level
+  {
+    std::vector<float> minimum;
+    std::vector<float> maximum;
+    std::vector<float> mean;
+    // ̃xŊm肵vf̑Bvfi͌̒l[i*stride, (i+1)*stride)܂Ƃ߂
+    unsigned long long count;
+    size_t stride;
+    // 1̃x֌JグÓA܂Ƃߓr̒l
+    summary pending;
+  };
+
+  void append(size_t level_index, float minimum, float maximum, double sum, size_t count);
+  // łVmvf̌ɂA܂m肵ĂȂl܂Ƃ߂
+  summary pending_of(size_t level_index) const;
+
+  size_t capacity;
+  size_t factor;
+  std::vector<level> levels;
+  unsigned long long total;
+};
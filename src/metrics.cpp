@@ -0,0 +1,371 @@
+#include "metrics.h"
+#include <cstdio>
+#include <sstream>
+
+namespace metrics
+{
+namespace
+{
+// Xbhɕʂ̃V[h֏ƂŁALbVC̎荇
+const size_t num_shards = 16;
+
+struct alignas(64) shard
+{
+  std::array<std::atomic<UINT64>, static_cast<size_t>(Counter::Max)> counters;
+  std::array<std::array<std::atomic<UINT64>, num_histogram_buckets>, static_cast<size_t>(Histogram::Max)> buckets;
+  std::array<std::atomic<UINT64>, static_cast<size_t>(Histogram::Max)> sums;
+  std::array<std::atomic<UINT64>, static_cast<size_t>(Histogram::Max)> maxima;
+};
+
+std::array<shard, num_shards> shards;
+std::atomic<size_t> next_shard(0);
+
+// Q[WƐ؂ւ̗͏݂܂Ȃ̂ŁAV[hɕȂ
+std::array<std::atomic<long long>, static_cast<size_t>(Gauge::Max)> gauges;
+// ؂ւ̗1gBsequence͏ݒȂAI(ʂԍ+1)*2ɂȂ
+struct switch_slot
+{
+  std::atomic<UINT64> sequence;
+  std::atomic<UINT64> time_us;
+  std::atomic<int> from_tier;
+  std::atomic<int> to_tier;
+  std::atomic<const char*> reason;
+  std::atomic<int> load_percent;
+};
+
+std::array<switch_slot, max_resampler_switches> resampler_switches;
+std::atomic<UINT64> num_resampler_switches(0);
+
+shard& local_shard()
+{
+  thread_local size_t index = next_shard.fetch_add(1, std::memory_order_relaxed) % num_shards;
+  return shards[index];
+}
+
+int bucket_of(UINT64 value)
+{
+  int bucket = 0;
+  while (value != 0 && bucket < num_histogram_buckets - 1) {
+    value >>= 1;
+    ++bucket;
+  }
+  return bucket;
+}
+
+const char* counter_names[] = {
+  "capture_wakes",
+  "capture_packets",
+  "capture_frames",
+  "underruns",
+  "concealed_samples",
+  "overflow_drops",
+  "analyzer_drops",
+  "reinitializations",
+  "migrations",
+  "endpoint_resyncs",
+  "process_callbacks",
+  "analyzer_updates",
+  "silent_packets",
+  "resampler_switches",
+  "track_changes",
+};
+static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == static_cast<size_t>(Counter::Max), "counter_names");
+
+const char* histogram_names[] = {
+  "capture_wake_interval_us",
+  "packets_per_wake",
+  "resampler_time_us",
+  "ring_fill_samples",
+  "analyzer_backlog_samples",
+  "process_callback_time_us",
+  "analyzer_update_time_us",
+  "migration_build_time_us",
+  "migration_gap_us",
+  "echo_canceller_time_us",
+  "fanout_time_us",
+};
+static_assert(sizeof(histogram_names) / sizeof(histogram_names[0]) == static_cast<size_t>(Histogram::Max), "histogram_names");
+
+const char* gauge_names[] = {
+  "resampler_tier",
+  "capture_load_percent",
+};
+static_assert(sizeof(gauge_names) / sizeof(gauge_names[0]) == static_cast<size_t>(Gauge::Max), "gauge_names");
+}
+
+void increment(Counter counter, UINT64 value)
+{
+  local_shard().counters[static_cast<size_t>(counter)].fetch_add(value, std::memory_order_relaxed);
+}
+
+void record(Histogram histogram, UINT64 value)
+{
+  auto& target = local_shard();
+  const auto index = static_cast<size_t>(histogram);
+  target.buckets[index][bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+  target.sums[index].fetch_add(value, std::memory_order_relaxed);
+  // V[hɏXbh͒ʏ1Ȃ̂ŁAǂł珑ŏ\
+  if (target.maxima[index].load(std::memory_order_relaxed) < value) {
+    target.maxima[index].store(value, std::memory_order_relaxed);
+  }
+}
+
+void set(Gauge gauge, long long value)
+{
+  gauges[static_cast<size_t>(gauge)].store(value, std::memory_order_relaxed);
+}
+
+void record_resampler_switch(const resampler_switch& event)
+{
+  increment(Counter::ResamplerSwitches);
+  // ޘg͒ʂԍŌ߂BbN炸AǂzꂽÂg͓ǂޑŎ̂Ă
+  const UINT64 index = num_resampler_switches.fetch_add(1, std::memory_order_relaxed);
+  auto& slot = resampler_switches[index % max_resampler_switches];
+  slot.sequence.store(index * 2 + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  slot.time_us.store(event.time_us, std::memory_order_relaxed);
+  slot.from_tier.store(event.from_tier, std::memory_order_relaxed);
+  slot.to_tier.store(event.to_tier, std::memory_order_relaxed);
+  slot.reason.store(event.reason, std::memory_order_relaxed);
+  slot.load_percent.store(event.load_percent, std::memory_order_relaxed);
+  slot.sequence.store(index * 2 + 2, std::memory_order_release);
+}
+
+UINT64 get_counter(Counter counter)
+{
+  UINT64 result = 0;
+  for (auto& target : shards) {
+    result += target.counters[static_cast<size_t>(counter)].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+UINT64 get_histogram_bucket(Histogram histogram, int bucket)
+{
+  if (bucket < 0 || bucket >= num_histogram_buckets) {
+    return 0;
+  }
+  UINT64 result = 0;
+  for (auto& target : shards) {
+    result += target.buckets[static_cast<size_t>(histogram)][bucket].load(std::memory_order_relaxed);
+  }
+  return result;
+}
+
+UINT64 get_histogram_count(Histogram histogram)
+{
+  UINT64 result = 0;
+  for (int bucket = 0; bucket < num_histogram_buckets; ++bucket) {
+    result += get_histogram_bucket(histogram, bucket);
+  }
+  return result;
+}
+
+UINT64 get_histogram_max(Histogram histogram)
+{
+  UINT64 result = 0;
+  for (auto& target : shards) {
+    const auto value = target.maxima[static_cast<size_t>(histogram)].load(std::memory_order_relaxed);
+    if (value > result) {
+      result = value;
+    }
+  }
+  return result;
+}
+
+double get_histogram_mean(Histogram histogram)
+{
+  const auto count = get_histogram_count(histogram);
+  if (count == 0) {
+    return 0.0;
+  }
+  UINT64 sum = 0;
+  for (auto& target : shards) {
+    sum += target.sums[static_cast<size_t>(histogram)].load(std::memory_order_relaxed);
+  }
+  return static_cast<double>(sum) / count;
+}
+
+double get_histogram_percentile(Histogram histogram, double percentile)
+{
+  // oPbg̏[ԂB2{ȓ̐xAr؂Ƃ̑ւɂ͏\
+  const auto count = get_histogram_count(histogram);
+  if (count == 0) {
+    return 0.0;
+  }
+  const auto threshold = static_cast<UINT64>(count * percentile / 100.0);
+  UINT64 accumulated = 0;
+  for (int bucket = 0; bucket < num_histogram_buckets; ++bucket) {
+    accumulated += get_histogram_bucket(histogram, bucket);
+    if (accumulated > threshold) {
+      return bucket == 0 ? 0.0 : static_cast<double>((static_cast<UINT64>(1) << bucket) - 1);
+    }
+  }
+  return static_cast<double>(get_histogram_max(histogram));
+}
+
+long long get_gauge(Gauge gauge)
+{
+  return gauges[static_cast<size_t>(gauge)].load(std::memory_order_relaxed);
+}
+
+int get_resampler_switches(resampler_switch* events, int length)
+{
+  const UINT64 total = num_resampler_switches.load(std::memory_order_acquire);
+  const UINT64 available = total < max_resampler_switches ? total : max_resampler_switches;
+  const UINT64 count = available < static_cast<UINT64>(length) ? available : static_cast<UINT64>(length);
+  // VcountÂɕׂBݒ㏑ꂽg͔΂
+  int written = 0;
+  for (UINT64 index = total - count; index < total; ++index) {
+    const auto& slot = resampler_switches[index % max_resampler_switches];
+    if (slot.sequence.load(std::memory_order_acquire) != index * 2 + 2) {
+      continue;
+    }
+    resampler_switch event;
+    event.time_us = slot.time_us.load(std::memory_order_relaxed);
+    event.from_tier = slot.from_tier.load(std::memory_order_relaxed);
+    event.to_tier = slot.to_tier.load(std::memory_order_relaxed);
+    event.reason = slot.reason.load(std::memory_order_relaxed);
+    event.load_percent = slot.load_percent.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.sequence.load(std::memory_order_relaxed) != index * 2 + 2) {
+      continue;
+    }
+    events[written++] = event;
+  }
+  return written;
+}
+
+const char* get_name(Counter counter)
+{
+  return counter_names[static_cast<size_t>(counter)];
+}
+
+const char* get_name(Histogram histogram)
+{
+  return histogram_names[static_cast<size_t>(histogram)];
+}
+
+const char* get_name(Gauge gauge)
+{
+  return gauge_names[static_cast<size_t>(gauge)];
+}
+
+std::string to_json()
+{
+  std::ostringstream stream;
+  stream << "{\"counters\":{";
+  for (int index = 0; index < static_cast<int>(Counter::Max); ++index) {
+    const auto counter = static_cast<Counter>(index);
+    stream << (index == 0 ? "" : ",") << "\"" << get_name(counter) << "\":" << get_counter(counter);
+  }
+  stream << "},\"histograms\":{";
+  for (int index = 0; index < static_cast<int>(Histogram::Max); ++index) {
+    const auto histogram = static_cast<Histogram>(index);
+    stream << (index == 0 ? "" : ",") << "\"" << get_name(histogram) << "\":{"
+           << "\"count\":" << get_histogram_count(histogram)
+           << ",\"mean\":" << get_histogram_mean(histogram)
+           << ",\"p50\":" << get_histogram_percentile(histogram, 50.0)
+           << ",\"p99\":" << get_histogram_percentile(histogram, 99.0)
+           << ",\"max\":" << get_histogram_max(histogram)
+           << ",\"buckets\":[";
+    for (int bucket = 0; bucket < num_histogram_buckets; ++bucket) {
+      stream << (bucket == 0 ? "" : ",") << get_histogram_bucket(histogram, bucket);
+    }
+    stream << "]}";
+  }
+  stream << "},\"gauges\":{";
+  for (int index = 0; index < static_cast<int>(Gauge::Max); ++index) {
+    const auto gauge = static_cast<Gauge>(index);
+    stream << (index == 0 ? "" : ",") << "\"" << get_name(gauge) << "\":" << get_gauge(gauge);
+  }
+  stream << "},\"resampler_switches\":[";
+  std::array<resampler_switch, max_resampler_switches> events;
+  const int num_events = get_resampler_switches(events.data(), max_resampler_switches);
+  for (int index = 0; index < num_events; ++index) {
+    const auto& event = events[index];
+    stream << (index == 0 ? "" : ",") << "{\"time_us\":" << event.time_us
+           << ",\"from\":" << event.from_tier
+           << ",\"to\":" << event.to_tier
+           << ",\"reason\":\"" << event.reason << "\""
+           << ",\"load_percent\":" << event.load_percent << "}";
+  }
+  stream << "]}";
+  return stream.str();
+}
+
+void reset()
+{
+  for (auto& target : shards) {
+    for (auto& counter : target.counters) {
+      counter = 0;
+    }
+    for (auto& histogram : target.buckets) {
+      for (auto& bucket : histogram) {
+        bucket = 0;
+      }
+    }
+    for (auto& sum : target.sums) {
+      sum = 0;
+    }
+    for (auto& maximum : target.maxima) {
+      maximum = 0;
+    }
+  }
+  // Q[W݂͌̏ԂȂ̂ŎcA؂ւ̗
+  for (auto& slot : resampler_switches) {
+    slot.sequence.store(0, std::memory_order_relaxed);
+  }
+  num_resampler_switches.store(0, std::memory_order_release);
+}
+
+UINT64 now_microseconds()
+{
+  static const LONGLONG frequency = [] {
+    LARGE_INTEGER result;
+    QueryPerformanceFrequency(&result);
+    return result.QuadPart;
+  }();
+  LARGE_INTEGER counter;
+  QueryPerformanceCounter(&counter);
+  return static_cast<UINT64>(counter.QuadPart / frequency * 1000000 + counter.QuadPart % frequency * 1000000 / frequency);
+}
+
+periodic_dump::periodic_dump(const std::string& path, int interval_millisec)
+  : path(path)
+  , interval_millisec(interval_millisec)
+  , stop_requested(false)
+  , worker(&periodic_dump::run, this)
+{
+}
+
+periodic_dump::~periodic_dump()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stop_requested = true;
+  }
+  stop_condition.notify_all();
+  if (worker.joinable()) {
+    worker.join();
+  }
+}
+
+void periodic_dump::run()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!stop_condition.wait_for(lock, std::chrono::milliseconds(interval_millisec), [this] { return stop_requested; })) {
+    const auto json = to_json();
+    if (path.empty()) {
+      OutputDebugStringA((json + "\n").c_str());
+      continue;
+    }
+    // 1s1R[hŒǋL
+    FILE* file = nullptr;
+    if (fopen_s(&file, path.c_str(), "a") == 0 && file) {
+      fprintf(file, "%s\n", json.c_str());
+      fclose(file);
+    }
+  }
+}
+}
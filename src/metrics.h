@@ -0,0 +1,135 @@
+#pragma once
+#include <windows.h>
+#include <array>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+// r؂X[vbg{ԊŒǂ߂̌vlB
+// ݂̓Xbh̃V[hrelaxedŉZ邾Ȃ̂ŁAI[fBIXbhĂł悢B
+namespace metrics
+{
+enum class Counter : int
+{
+  CaptureWakes,         // ^Xbh̋N
+  CapturePackets,       // 󂯎pPbg
+  CaptureFrames,        // 󂯎t[
+  Underruns,            // get_bufferŘ^Ȃ
+  ConcealedSamples,     // r؂𒼑O̔g`Ŗ߂Tv
+  OverflowDrops,        // ^obt@炠ӂĎ̂ĂTv
+  AnalyzerDrops,        // ̓obt@炠ӂĎ̂ĂTv
+  Reinitializations,    // Oōďv
+  Migrations,           // foCX̐؂ւŘ^芷
+  EndpointResyncs,      // ǉfoCX̎ꂪ傫Aǂ݈ʒu΂č킹
+  ProcessCallbacks,     // Spatializeȑ
+  AnalyzerUpdates,      // Analyzer::updatěĂяo
+  SilentPackets,        // tOtŁATvʂɏ񂾃pPbg
+  ResamplerSwitches,    // ׂɉăTv̕i؂ւ
+  TrackChanges,         // ͂ŋȂ̐؂ւo
+  Max,
+};
+
+enum class Histogram : int
+{
+  CaptureWakeInterval,  // NԊu [us]
+  PacketsPerWake,       // 1̋NŏpPbg
+  ResamplerTime,        // 1pPbg̃Tv [us]
+  RingFill,             // ݒ̘^obt@ [samples]
+  AnalyzerBacklog,      // ͎ɗ܂Ă̓obt@ [samples]
+  ProcessCallbackTime,  // Spatializeȑ [us]
+  AnalyzerUpdateTime,   // Analyzer::updatȅ [us]
+  MigrationBuildTime,   // ؂ւ̘^𗠂ŏ̂ɂ [us]
+  MigrationGap,         // ؂ւVfoCX̍ŏ̏o͂܂ł̎ [us]
+  EchoCancellerTime,    // 1pPbg̎ȏo͏̏ [us]
+  FanoutTime,           // 1pPbg𗘗pҖ̃[g֕ϊ鎞 [us]
+  Max,
+};
+
+// ŐV̒lvl
+enum class Gauge : int
+{
+  ResamplerTier,        // foCX̃Tv̕i̒iB0ōi
+  CaptureLoad,          // ^Xbḧׂ̕ړ [%]BNԊuɑ΂鏈Ԃ̊
+  Max,
+};
+
+// Tv̕i̐؂ւ1
+struct resampler_switch
+{
+  UINT64 time_us;
+  int from_tier;
+  int to_tier;
+  const char* reason;
+  int load_percent;
+};
+// to_jsonɊ܂߂؂ւ̗̐
+static const int max_resampler_switches = 32;
+
+// 2ׂ̂捏݁BoPbgiɂ[2^(i-1), 2^i)̒l(oPbg00̂)
+static const int num_histogram_buckets = 32;
+
+void increment(Counter counter, UINT64 value = 1);
+void record(Histogram histogram, UINT64 value);
+void set(Gauge gauge, long long value);
+// ؂ւ̉񐔂B^XbhĂł悭AmۂȂ
+void record_resampler_switch(const resampler_switch& event);
+
+UINT64 get_counter(Counter counter);
+UINT64 get_histogram_bucket(Histogram histogram, int bucket);
+UINT64 get_histogram_count(Histogram histogram);
+UINT64 get_histogram_max(Histogram histogram);
+double get_histogram_mean(Histogram histogram);
+double get_histogram_percentile(Histogram histogram, double percentile);
+long long get_gauge(Gauge gauge);
+// ߂̐؂ւÂevents֏݁A񂾐Ԃ
+int get_resampler_switches(resampler_switch* events, int length);
+
+const char* get_name(Counter counter);
+const char* get_name(Histogram histogram);
+const char* get_name(Gauge gauge);
+
+// SvlJSONɂ
+std::string to_json();
+void reset();
+
+UINT64 now_microseconds();
+
+// XR[v̏ԂqXgO֋L^
+class scoped_timer
+{
+public:
+  explicit scoped_timer(Histogram histogram)
+    : histogram(histogram)
+    , start(now_microseconds())
+  {
+  }
+  ~scoped_timer()
+  {
+    record(histogram, now_microseconds() - start);
+  }
+
+private:
+  Histogram histogram;
+  UINT64 start;
+};
+
+// Ԋuto_json()t@CfobOo͂֏o
+class periodic_dump
+{
+public:
+  periodic_dump(const std::string& path, int interval_millisec);
+  ~periodic_dump();
+
+private:
+  void run();
+
+  std::string path;
+  int interval_millisec;
+  bool stop_requested;
+  std::mutex mutex;
+  std::condition_variable stop_condition;
+  std::thread worker;
+};
+}
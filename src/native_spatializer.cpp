@@ -0,0 +1,321 @@
+#include "native_spatializer.h"
+#include <windows.h>
+#include <emmintrin.h>
+#include <atomic>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace
+{
+enum class Parameters : int
+{
+  Gain = 0,
+  NearDistance = 1,
+  UnityCurve = 2,
+  AirAbsorption = 3,
+  HeadSize = 4,
+  Max = 5,
+};
+
+const float pi = 3.14159265f;
+const float head_radius = 0.0875f;    // [m]
+const float speed_of_sound = 343.0f;  // [m/s]
+const size_t delay_line_length = 256; // 2ׂ̂B192kHzłőITD܂钷
+const float default_parameters[] = { 0.0f, 1.0f, 1.0f, 0.0f, 1.0f };
+
+struct NativeEffectData
+{
+  std::atomic<float> parameters[static_cast<int>(Parameters::Max)];
+
+  // OubN̒l獡ubN̒l֐`Ƀv
+  float left_gain;
+  float right_gain;
+  float left_delay;
+  float right_delay;
+
+  float lowpass_state;
+  std::vector<float> delay_line;
+  size_t delay_head;
+  std::vector<float> wet;
+};
+
+struct Target
+{
+  float left_gain;
+  float right_gain;
+  float left_delay;
+  float right_delay;
+  float lowpass_coefficient;
+  float blend;
+};
+
+float parameter(const NativeEffectData* data, Parameters index)
+{
+  return data->parameters[static_cast<int>(index)].load(std::memory_order_relaxed);
+}
+
+// Xi[Ԃł̃\[Xʒu߂
+void listener_space_position(const UnityAudioSpatializerData* spatializer, float* x, float* y, float* z)
+{
+  const float* m = spatializer->listenermatrix;
+  const float* s = spatializer->sourcematrix;
+  const float px = s[12];
+  const float py = s[13];
+  const float pz = s[14];
+  *x = m[0] * px + m[4] * py + m[8] * pz + m[12];
+  *y = m[1] * px + m[5] * py + m[9] * pz + m[13];
+  *z = m[2] * px + m[6] * py + m[10] * pz + m[14];
+}
+
+Target compute_target(const UnityAudioEffectState* state, const NativeEffectData* data)
+{
+  Target target;
+  target.left_gain = target.right_gain = 1.0f;
+  target.left_delay = target.right_delay = 0.0f;
+  target.lowpass_coefficient = 0.0f;
+  target.blend = 0.0f;
+  if (state->spatializerdata == nullptr) {
+    return target;
+  }
+
+  float x, y, z;
+  listener_space_position(state->spatializerdata, &x, &y, &z);
+  const float distance = sqrtf(x * x + y * y + z * z);
+  // ʂ̊px̐BE
+  const float lateral = (distance > 1.0e-4f) ? (std::max)(-1.0f, (std::min)(1.0f, x / distance)) : 0.0f;
+  const float head_size = parameter(data, Parameters::HeadSize);
+  const float gain = powf(10.0f, parameter(data, Parameters::Gain) / 20.0f);
+
+  // p[p + ɂՕ(ILD)
+  const float theta = (lateral + 1.0f) * pi * 0.25f;
+  const float shadow = 1.0f - 0.3f * (std::min)(head_size, 2.0f) * 0.5f * fabsf(lateral);
+  target.left_gain = cosf(theta) * gain * (lateral > 0.0f ? shadow : 1.0f);
+  target.right_gain = sinf(theta) * gain * (lateral < 0.0f ? shadow : 1.0f);
+
+  // Woodworth̎ɂITDB̎x点
+  const float angle = asinf(fabsf(lateral));
+  const float itd_samples = head_size * head_radius / speed_of_sound * (angle + sinf(angle)) * state->samplerate;
+  const float max_delay = static_cast<float>(delay_line_length - 2);
+  target.left_delay = (lateral > 0.0f) ? (std::min)(itd_samples, max_delay) : 0.0f;
+  target.right_delay = (lateral < 0.0f) ? (std::min)(itd_samples, max_delay) : 0.0f;
+
+  // CzBقǃJbgIt1[pX
+  const float air = parameter(data, Parameters::AirAbsorption);
+  if (air > 0.0f) {
+    const float cutoff = (std::max)(500.0f, 20000.0f * expf(-air * distance / 50.0f));
+    target.lowpass_coefficient = expf(-2.0f * pi * cutoff / state->samplerate);
+  }
+
+  target.blend = state->spatializerdata->spatialblend;
+  return target;
+}
+
+float read_delay_line(const NativeEffectData* data, float delay)
+{
+  const size_t mask = delay_line_length - 1;
+  const auto integer = static_cast<size_t>(delay);
+  const float fraction = delay - integer;
+  const float a = data->delay_line[(data->delay_head - integer) & mask];
+  const float b = data->delay_line[(data->delay_head - integer - 1) & mask];
+  return a + (b - a) * fraction;
+}
+
+// 1ubNtargetփvȂ珈Blengthwet̒ȉ
+void process_block(NativeEffectData* data, const Target& target, const float* input, float* output, unsigned int length)
+{
+  const float step = 1.0f / length;
+
+  // 1pX: m֍Ă烍[pXƒxBċÂŃXJ[ŏ
+  const size_t mask = delay_line_length - 1;
+  const float a = target.lowpass_coefficient;
+  const float left_delay_step = (target.left_delay - data->left_delay) * step;
+  const float right_delay_step = (target.right_delay - data->right_delay) * step;
+  float left_delay = data->left_delay;
+  float right_delay = data->right_delay;
+  float lowpass = data->lowpass_state;
+  float* wet = data->wet.data();
+  for (unsigned int frame = 0; frame < length; ++frame) {
+    const float mono = (input[frame * 2] + input[frame * 2 + 1]) * 0.5f;
+    lowpass = (1.0f - a) * mono + a * lowpass;
+    data->delay_head = (data->delay_head + 1) & mask;
+    data->delay_line[data->delay_head] = lowpass;
+    wet[frame * 2] = read_delay_line(data, left_delay);
+    wet[frame * 2 + 1] = read_delay_line(data, right_delay);
+    left_delay += left_delay_step;
+    right_delay += right_delay_step;
+  }
+  data->lowpass_state = lowpass;
+  data->left_delay = target.left_delay;
+  data->right_delay = target.right_delay;
+
+  // 2pX: QC̃vspatial blendɂhCƂ̍B2t[SSEŏ
+  const float left_gain_step = (target.left_gain - data->left_gain) * step;
+  const float right_gain_step = (target.right_gain - data->right_gain) * step;
+  const __m128 blend = _mm_set1_ps(target.blend);
+  const __m128 dry_gain = _mm_set1_ps(1.0f - target.blend);
+  __m128 gain = _mm_set_ps(
+    data->right_gain + right_gain_step,
+    data->left_gain + left_gain_step,
+    data->right_gain,
+    data->left_gain);
+  const __m128 gain_step = _mm_set_ps(
+    right_gain_step * 2.0f,
+    left_gain_step * 2.0f,
+    right_gain_step * 2.0f,
+    left_gain_step * 2.0f);
+  unsigned int frame = 0;
+  for (; frame + 2 <= length; frame += 2) {
+    const __m128 dry = _mm_loadu_ps(input + frame * 2);
+    const __m128 spatialized = _mm_mul_ps(_mm_loadu_ps(wet + frame * 2), gain);
+    _mm_storeu_ps(output + frame * 2, _mm_add_ps(_mm_mul_ps(dry, dry_gain), _mm_mul_ps(spatialized, blend)));
+    gain = _mm_add_ps(gain, gain_step);
+  }
+  for (; frame < length; ++frame) {
+    const float left_gain = data->left_gain + left_gain_step * frame;
+    const float right_gain = data->right_gain + right_gain_step * frame;
+    output[frame * 2] = input[frame * 2] * (1.0f - target.blend) + wet[frame * 2] * left_gain * target.blend;
+    output[frame * 2 + 1] = input[frame * 2 + 1] * (1.0f - target.blend) + wet[frame * 2 + 1] * right_gain * target.blend;
+  }
+  data->left_gain = target.left_gain;
+  data->right_gain = target.right_gain;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK DistanceAttenuationCallback(UnityAudioEffectState* state, float distanceIn, float attenuationIn, float* attenuationOut)
+{
+  auto data = state->GetEffectData<NativeEffectData>();
+  if (parameter(data, Parameters::UnityCurve) > 0.5f) {
+    *attenuationOut = attenuationIn;
+  } else {
+    const float near_distance = parameter(data, Parameters::NearDistance);
+    *attenuationOut = near_distance / (std::max)(near_distance, distanceIn);
+  }
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback(UnityAudioEffectState* state)
+{
+  auto data = new NativeEffectData;
+  for (int index = 0; index < static_cast<int>(Parameters::Max); ++index) {
+    data->parameters[index] = default_parameters[index];
+  }
+  data->left_gain = data->right_gain = 0.0f;
+  data->left_delay = data->right_delay = 0.0f;
+  data->lowpass_state = 0.0f;
+  data->delay_line.assign(delay_line_length, 0.0f);
+  data->delay_head = 0;
+  // ubN͂ŊmۂĂAI[fBIXbhŊmۂȂ悤ɂB蒷ubN͕ď
+  data->wet.assign((std::max)(state->dspbuffersize, 4096u) * 2, 0.0f);
+  state->effectdata = data;
+
+  if (state->spatializerdata) {
+    state->spatializerdata->distanceattenuationcallback = DistanceAttenuationCallback;
+  }
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ReleaseCallback(UnityAudioEffectState* state)
+{
+  delete state->GetEffectData<NativeEffectData>();
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback(UnityAudioEffectState* state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels)
+{
+  if (inchannels != 2 || outchannels != 2) {
+    return UNITY_AUDIODSP_ERR_UNSUPPORTED;
+  }
+
+  auto data = state->GetEffectData<NativeEffectData>();
+  const auto target = compute_target(state, data);
+  // wetCreateCallbackŊmۂ̂܂܎gB蒷ubN͕ďAv͍ŏ̋؂ŏI
+  const unsigned int max_frames = static_cast<unsigned int>(data->wet.size() / 2);
+  for (unsigned int offset = 0; offset < length; offset += max_frames) {
+    const unsigned int frames = (std::min)(max_frames, length - offset);
+    process_block(data, target, inbuffer + offset * 2, outbuffer + offset * 2, frames);
+  }
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SetFloatParameterCallback(UnityAudioEffectState* state, int index, float value)
+{
+  if (index < 0 || index >= static_cast<int>(Parameters::Max)) {
+    return UNITY_AUDIODSP_ERR_UNSUPPORTED;
+  }
+  state->GetEffectData<NativeEffectData>()->parameters[index].store(value, std::memory_order_relaxed);
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatParameterCallback(UnityAudioEffectState* state, int index, float* value, char *valuestr)
+{
+  if (index < 0 || index >= static_cast<int>(Parameters::Max)) {
+    return UNITY_AUDIODSP_ERR_UNSUPPORTED;
+  }
+  if (value != NULL) {
+    *value = state->GetEffectData<NativeEffectData>()->parameters[index].load(std::memory_order_relaxed);
+  }
+  if (valuestr != NULL) {
+    valuestr[0] = 0;
+  }
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback(UnityAudioEffectState* state, const char* name, float* buffer, int numsamples)
+{
+  return UNITY_AUDIODSP_OK;
+}
+
+void register_parameter(
+  UnityAudioParameterDefinition* paramdefs,
+  Parameters index,
+  const char* name,
+  const char* unit,
+  float minval,
+  float maxval,
+  const char* description)
+{
+  auto& definition = paramdefs[static_cast<int>(index)];
+  strcpy_s(definition.name, name);
+  strcpy_s(definition.unit, unit);
+  definition.description = description;
+  definition.min = minval;
+  definition.max = maxval;
+  definition.defaultval = default_parameters[static_cast<int>(index)];
+  definition.displayscale = 1.0f;
+  definition.displayexponent = 1.0f;
+}
+}
+
+int NativeSpatializer_UnityGetAudioEffectDefinitions(UnityAudioEffectDefinition*** definitionptr)
+{
+  static UnityAudioEffectDefinition definition;
+  static UnityAudioEffectDefinition* definition_array[1];
+  static UnityAudioParameterDefinition paramdefs[static_cast<int>(Parameters::Max)];
+  ZeroMemory(&definition, sizeof(UnityAudioEffectDefinition));
+  ZeroMemory(paramdefs, sizeof(paramdefs));
+
+  strcpy_s(definition.name, "Native Spatializer");
+  definition.structsize = sizeof(UnityAudioEffectDefinition);
+  definition.paramstructsize = sizeof(UnityAudioParameterDefinition);
+  definition.apiversion = UNITY_AUDIO_PLUGIN_API_VERSION;
+  definition.pluginversion = 0x010000;
+  definition.create = CreateCallback;
+  definition.release = ReleaseCallback;
+  definition.process = ProcessCallback;
+  definition.setfloatparameter = SetFloatParameterCallback;
+  definition.getfloatparameter = GetFloatParameterCallback;
+  definition.getfloatbuffer = GetFloatBufferCallback;
+  definition.flags |= UnityAudioEffectDefinitionFlags_IsSpatializer;
+
+  register_parameter(paramdefs, Parameters::Gain, "Gain", "dB", -24.0f, 12.0f, "Additional gain");
+  register_parameter(paramdefs, Parameters::NearDistance, "Near", "m", 0.1f, 100.0f, "Distance where inverse distance attenuation starts");
+  register_parameter(paramdefs, Parameters::UnityCurve, "Unity Curve", "", 0.0f, 1.0f, "Use AudioSource volume curve instead of inverse distance");
+  register_parameter(paramdefs, Parameters::AirAbsorption, "Air Absorb", "", 0.0f, 1.0f, "Distance dependent low-pass amount");
+  register_parameter(paramdefs, Parameters::HeadSize, "Head Size", "", 0.0f, 2.0f, "Scale of interaural time and level difference");
+  definition.paramdefs = paramdefs;
+  definition.numparameters = static_cast<int>(Parameters::Max);
+
+  definition_array[0] = &definition;
+  *definitionptr = definition_array;
+  return 1;
+}
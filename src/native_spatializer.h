@@ -0,0 +1,7 @@
+#pragma once
+
+#include "AudioPluginInterface.h"
+
+// AudioPluginOculusSpatializerǂݍ߂ȂɎg̊ȈՃpi[B
+// Oculus SpatializerUnityGetAudioEffectDefinitionsƓ`Œ`ԂB
+int NativeSpatializer_UnityGetAudioEffectDefinitions(UnityAudioEffectDefinition*** definitionptr);
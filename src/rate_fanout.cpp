@@ -0,0 +1,321 @@
+#include "rate_fanout.h"
+#include "metrics.h"
+#include "trace.h"
+#include <mmreg.h>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+// MFT_resampler̓̓obt@̑傫B𒴂镪͕ē
+const size_t resampler_input_bytes = 1024 * 10;
+// 1pPbgŏoĂʂ̗]TBreserve_work_buffersƓ
+const size_t output_margin_frames = 1024;
+}
+
+rate_fanout::rate_fanout()
+  : primary_rate(0)
+  , num_channels(0)
+  , max_primary_frames(0)
+  , primary_output(nullptr)
+  , primary_frames(0)
+{
+}
+
+void rate_fanout::configure(int primary_rate, int num_channels, size_t max_primary_frames)
+{
+  std::vector<std::unique_ptr<branch>> removed;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    this->primary_rate = primary_rate;
+    this->num_channels = num_channels;
+    this->max_primary_frames = max_primary_frames;
+    silence.assign(max_primary_frames * num_channels, 0.0f);
+    primary_output = nullptr;
+    primary_frames = 0;
+    removed.swap(branches);
+
+    // eɂł悤A[g
+    std::vector<int> rates;
+    for (auto& entry : users) {
+      rates.push_back(entry.first);
+    }
+    std::sort(rates.begin(), rates.end(), [](int a, int b) { return a > b; });
+    for (int rate : rates) {
+      if (rate == primary_rate) {
+        continue;
+      }
+      try {
+        insert(create_branch(rate, choose_parent(rate), primary_rate, num_channels, max_primary_frames));
+      } catch (const std::exception&) {
+        // Ȃ[g̗p҂ɂ͉nȂB僌[g̘^͎~߂Ȃ
+      }
+    }
+  }
+}
+
+void rate_fanout::acquire(int sampling_rate)
+{
+  if (sampling_rate < min_sampling_rate || sampling_rate > max_sampling_rate) {
+    throw std::runtime_error("Failed to acquire unsupported sampling rate.");
+  }
+  int parent_rate;
+  int configured_rate;
+  int configured_channels;
+  size_t configured_frames;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = std::find_if(users.begin(), users.end(), [&](const std::pair<int, int>& entry) { return entry.first == sampling_rate; });
+    if (found != users.end()) {
+      ++found->second;
+    } else {
+      users.emplace_back(sampling_rate, 1);
+    }
+    if (primary_rate == 0 || sampling_rate == primary_rate || find(sampling_rate)) {
+      // ݒȂconfigureō
+      return;
+    }
+    parent_rate = choose_parent(sampling_rate);
+    configured_rate = primary_rate;
+    configured_channels = num_channels;
+    configured_frames = max_primary_frames;
+  }
+
+  for (;;) {
+    std::unique_ptr<branch> created;
+    try {
+      created = create_branch(sampling_rate, parent_rate, configured_rate, configured_channels, configured_frames);
+    } catch (const std::exception&) {
+      release(sampling_rate);
+      throw;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    if (primary_rate != configured_rate || num_channels != configured_channels || find(sampling_rate)) {
+      // ĂԂɎ僌[gςconfigure蒼A̗p҂ɍ
+      return;
+    }
+    if (parent_rate == primary_rate || find(parent_rate)) {
+      insert(std::move(created));
+      return;
+    }
+    // eɂ肾}BeIђč蒼
+    parent_rate = choose_parent(sampling_rate);
+  }
+}
+
+void rate_fanout::release(int sampling_rate)
+{
+  std::vector<std::unique_ptr<branch>> removed;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto found = std::find_if(users.begin(), users.end(), [&](const std::pair<int, int>& entry) { return entry.first == sampling_rate; });
+    if (found == users.end()) {
+      return;
+    }
+    if (--found->second == 0) {
+      users.erase(found);
+    }
+    prune(removed);
+  }
+  // Tv̔j̓bN̊Oōs
+}
+
+std::mutex& rate_fanout::get_mutex()
+{
+  return mutex;
+}
+
+void rate_fanout::process(const float* interleaved, size_t num_frames)
+{
+  primary_output = interleaved;
+  primary_frames = num_frames;
+  if (branches.empty()) {
+    return;
+  }
+  TRACE_SCOPE("rate fanout");
+  metrics::scoped_timer timer(metrics::Histogram::FanoutTime);
+  for (auto& target : branches) {
+    target->silence_remainder = 0;
+    if (target->parent_rate == primary_rate) {
+      run_branch(*target, interleaved, num_frames);
+    } else {
+      // e̓[ĝŐɏς
+      const auto parent = find(target->parent_rate);
+      run_branch(*target, reinterpret_cast<const float*>(parent->output.data()), parent->num_frames);
+    }
+  }
+}
+
+void rate_fanout::process_silence(size_t num_frames)
+{
+  num_frames = num_frames < max_primary_frames ? num_frames : max_primary_frames;
+  primary_output = silence.data();
+  primary_frames = num_frames;
+  for (auto& target : branches) {
+    const size_t parent_frames = target->parent_rate == primary_rate ? num_frames : find(target->parent_rate)->num_frames;
+    size_t output_frames;
+    if (target->method == Method::Halfband) {
+      // ϊƓAzƍ킹ċt[Ԉ
+      const size_t total = parent_frames + (target->has_carry ? 1 : 0);
+      output_frames = total / 2;
+      target->has_carry = total % 2 != 0;
+      std::fill(target->input.begin(), target->input.begin() + num_channels, 0.0f);
+    } else {
+      const UINT64 scaled = static_cast<UINT64>(parent_frames) * target->sampling_rate + target->silence_remainder;
+      output_frames = static_cast<size_t>(scaled / target->parent_rate);
+      target->silence_remainder = scaled % target->parent_rate;
+    }
+    // mۍς݂̗eʓŖ߂
+    const size_t capacity_frames = target->output.capacity() / sizeof(float) / num_channels;
+    target->num_frames = output_frames < capacity_frames ? output_frames : capacity_frames;
+    target->output.assign(target->num_frames * num_channels * sizeof(float), 0);
+  }
+}
+
+const float* rate_fanout::get_output(int sampling_rate, size_t* num_frames)
+{
+  if (sampling_rate == primary_rate) {
+    *num_frames = primary_frames;
+    return primary_output;
+  }
+  const auto target = find(sampling_rate);
+  if (!target) {
+    *num_frames = 0;
+    return nullptr;
+  }
+  *num_frames = target->num_frames;
+  return reinterpret_cast<const float*>(target->output.data());
+}
+
+std::string rate_fanout::describe()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::string result = std::to_string(primary_rate) + " primary " + std::to_string(get_users(primary_rate)) + "\n";
+  for (auto& target : branches) {
+    result += std::to_string(target->sampling_rate) + " <- " + std::to_string(target->parent_rate) +
+      (target->method == Method::Halfband ? " halfband " : " resampler ") + std::to_string(get_users(target->sampling_rate)) + "\n";
+  }
+  return result;
+}
+
+std::unique_ptr<rate_fanout::branch> rate_fanout::create_branch(int sampling_rate, int parent_rate, int primary_rate, int num_channels, size_t max_primary_frames)
+{
+  auto created = std::make_unique<branch>();
+  created->sampling_rate = sampling_rate;
+  created->parent_rate = parent_rate;
+  created->method = parent_rate == sampling_rate * 2 ? Method::Halfband : Method::Resampler;
+  created->has_carry = false;
+  created->num_frames = 0;
+  created->silence_remainder = 0;
+
+  const size_t max_parent_frames = max_primary_frames * parent_rate / primary_rate + output_margin_frames;
+  if (created->method == Method::Halfband) {
+    for (int channel = 0; channel < num_channels; ++channel) {
+      created->decimators.push_back(std::make_unique<halfband_decimator>(max_parent_frames + 1));
+    }
+    created->input.resize((max_parent_frames + 1) * num_channels);
+  } else {
+    // 僌[g̉͏ς݂floatȂ̂ŁATvɂfloat̂܂ܓ
+    const int block_align = static_cast<int>(sizeof(float)) * num_channels;
+    created->resampler = std::make_unique<MFT_resampler>(
+      block_align,
+      SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT,
+      block_align * parent_rate,
+      parent_rate,
+      sampling_rate
+      );
+  }
+  const size_t max_output_frames = max_primary_frames * sampling_rate / primary_rate + output_margin_frames;
+  created->output.reserve(max_output_frames * num_channels * sizeof(float));
+  return created;
+}
+
+void rate_fanout::insert(std::unique_ptr<branch> created)
+{
+  auto position = std::find_if(branches.begin(), branches.end(), [&](const std::unique_ptr<branch>& target) { return target->sampling_rate < created->sampling_rate; });
+  branches.insert(position, std::move(created));
+}
+
+rate_fanout::branch* rate_fanout::find(int sampling_rate)
+{
+  for (auto& target : branches) {
+    if (target->sampling_rate == sampling_rate) {
+      return target.get();
+    }
+  }
+  return nullptr;
+}
+
+int rate_fanout::choose_parent(int sampling_rate)
+{
+  const int doubled = sampling_rate * 2;
+  if (doubled == primary_rate || find(doubled)) {
+    return doubled;
+  }
+  return primary_rate;
+}
+
+void rate_fanout::run_branch(branch& target, const float* input, size_t num_frames)
+{
+  if (target.method == Method::Resampler) {
+    target.output.clear();
+    const size_t max_chunk_frames = resampler_input_bytes / (sizeof(float) * num_channels);
+    for (size_t offset = 0; offset < num_frames; offset += max_chunk_frames) {
+      const size_t chunk_frames = (std::min)(max_chunk_frames, num_frames - offset);
+      // write_buffer͓͂ȂAconstłȂ
+      target.resampler->write_buffer(
+        reinterpret_cast<BYTE*>(const_cast<float*>(input + offset * num_channels)),
+        static_cast<DWORD>(chunk_frames * num_channels * sizeof(float)));
+      target.resampler->read_buffer(target.output);
+    }
+    target.num_frames = target.output.size() / sizeof(float) / num_channels;
+    return;
+  }
+
+  // z1t[֑̌At[Ԉ
+  const size_t carried = target.has_carry ? 1 : 0;
+  const size_t capacity_frames = target.input.size() / num_channels;
+  const size_t total = (std::min)(carried + num_frames, capacity_frames);
+  memcpy(target.input.data() + carried * num_channels, input, (total - carried) * num_channels * sizeof(float));
+  const size_t even = total & ~static_cast<size_t>(1);
+  target.num_frames = even / 2;
+  target.output.resize(target.num_frames * num_channels * sizeof(float));
+  const auto output = reinterpret_cast<float*>(target.output.data());
+  for (int channel = 0; channel < num_channels; ++channel) {
+    target.decimators[channel]->process(target.input.data() + channel, num_channels, even, output + channel, num_channels);
+  }
+  target.has_carry = total != even;
+  if (target.has_carry) {
+    memmove(target.input.data(), target.input.data() + even * num_channels, num_channels * sizeof(float));
+  }
+}
+
+int rate_fanout::get_users(int sampling_rate)
+{
+  for (auto& entry : users) {
+    if (entry.first == sampling_rate) {
+      return entry.second;
+    }
+  }
+  return 0;
+}
+
+void rate_fanout::prune(std::vector<std::unique_ptr<branch>>& removed)
+{
+  // qĂ̂ŁAȂȂ܂ŌJԂ
+  for (bool changed = true; changed;) {
+    changed = false;
+    for (auto target = branches.begin(); target != branches.end(); ++target) {
+      const int rate = (*target)->sampling_rate;
+      const bool has_children = std::any_of(branches.begin(), branches.end(), [&](const std::unique_ptr<branch>& child) { return child->parent_rate == rate; });
+      if (get_users(rate) == 0 && !has_children) {
+        removed.push_back(std::move(*target));
+        branches.erase(target);
+        changed = true;
+        break;
+      }
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#pragma once
+#include "MFT_resampler.h"
+#include "halfband_resampler.h"
+#include <windows.h>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <cstddef>
+
+// ^Xbh̏o̓[g(僌[g)̉Ap҂߂ʂ̃[g֕ϊ؁B
+// [g͉l߂Ă1񂾂ϊċLBɂ}̂傤ǔ̃[g͂̎}n[tohŊԈA
+// ȊO͎僌[gMFTŃTvB
+// ^Xbh1̋N̊get_mutex()A}̒ǉƍ폜͂̍Ԃɍs
+class rate_fanout
+{
+public:
+  // vł郌[g͈̔
+  static const int min_sampling_rate = 8000;
+  static const int max_sampling_rate = 384000;
+
+  rate_fanout();
+
+  // 僌[gςɘ^XbhĂԁBṽ[g̎}Sč蒼
+  void configure(int primary_rate, int num_channels, size_t max_primary_frames);
+  // p҂[gvB僌[gƓɎ}Ηp҂𐔂邾B
+  // V}̃Tv͌ĂяõXbhōA^Xbh~߂Ȃ
+  void acquire(int sampling_rate);
+  // Ō̗p҂}́A̎}̐ełȂȂɏ
+  void release(int sampling_rate);
+
+  std::mutex& get_mutex();
+  // ȉget_mutex()^XbhĂԁBmۂȂB
+  // 僌[g̃C^[[uSĂ̎}֗
+  void process(const float* interleaved, size_t num_frames);
+  // num_frames(僌[g)̖𗬂BϊɁAe}oĂ̖͂̒o
+  void process_silence(size_t num_frames);
+  // Oprocess/process_silencesampling_rate̗p҂֓nB}nullptr*num_frames0
+  const float* get_output(int sampling_rate, size_t* num_frames);
+
+  // 僌[gƎ}"rate <- parent method users\n"̌`ŕׂ
+  std::string describe();
+
+private:
+  enum class Method
+  {
+    Halfband,
+    Resampler,
+  };
+
+  struct branch
+  {
+    int sampling_rate;
+    int parent_rate;
+    Method method;
+    std::unique_ptr<MFT_resampler> resampler;
+    // [`l]BHalfband̎g
+    std::vector<std::unique_ptr<halfband_decimator>> decimators;
+    // Ԉ͋t[Ȃ̂ŁA͍̎Ō1t[֎zBinput[0, num_channels)
+    std::vector<float> input;
+    bool has_carry;
+    std::vector<BYTE> output;
+    size_t num_frames;
+    // process_silenceŏo͒߂鎞̒[
+    UINT64 silence_remainder;
+  };
+
+  // ĂяõXbhō悤Aݒ̓bNɓǂ񂾒ln
+  static std::unique_ptr<branch> create_branch(int sampling_rate, int parent_rate, int primary_rate, int num_channels, size_t max_primary_frames);
+  // }e([g̍)ɕׂē
+  void insert(std::unique_ptr<branch> created);
+  branch* find(int sampling_rate);
+  // sampling_rate̎}̐eɂ郌[gB{̃[g僌[g}ȂԈAȊO͎僌[g烊Tv
+  int choose_parent(int sampling_rate);
+  void run_branch(branch& target, const float* input, size_t num_frames);
+  int get_users(int sampling_rate);
+  // p҂qȂ}removedֈڂBj̓bN̊Oōs
+  void prune(std::vector<std::unique_ptr<branch>>& removed);
+
+  std::mutex mutex;
+  int primary_rate;
+  int num_channels;
+  size_t max_primary_frames;
+  std::vector<std::unique_ptr<branch>> branches;
+  // p҂̐B僌[gƓ[gŐA僌[gςɎ}邩߂
+  std::vector<std::pair<int, int>> users;
+  const float* primary_output;
+  size_t primary_frames;
+  std::vector<float> silence;
+};
@@ -0,0 +1,86 @@
+#include "resampler_quality.h"
+
+namespace
+{
+// ׂ̈ړς̌WBN͖16msȂ̂ŁA0.5bxłȂ炷
+const float load_smoothing = 0.03f;
+}
+
+resampler_quality_controller::resampler_quality_controller(int num_tiers)
+  : num_tiers(num_tiers)
+{
+  reset(0);
+}
+
+void resampler_quality_controller::reset(int tier)
+{
+  this->tier = tier;
+  load = 0.0f;
+  has_load = false;
+  reason = Reason::None;
+  last_change = 0;
+  calm_since = 0;
+}
+
+int resampler_quality_controller::update(UINT64 now, UINT64 busy, UINT64 elapsed, size_t fill, size_t target)
+{
+  const float sample = elapsed > 0 ? 100.0f * static_cast<float>(busy) / static_cast<float>(elapsed) : 0.0f;
+  load = has_load ? load + (sample - load) * load_smoothing : sample;
+  has_load = true;
+
+  // N̎cʂ1ōłȂ_Ȃ̂ŁAꂪڕW傫ƍĐɒǂꂩĂB
+  // ׂႢ͕îł͂Ȃ̂ŁAɖ߂f𑱂
+  const bool calm = load < low_load_percent;
+  const bool starving = target > 0 && fill < target / 4 && !calm;
+  const bool overloaded = load > high_load_percent;
+  if ((starving || overloaded) && tier + 1 < num_tiers && (last_change == 0 || now - last_change >= step_down_interval)) {
+    ++tier;
+    reason = overloaded ? Reason::Load : Reason::Fill;
+    last_change = now;
+    calm_since = 0;
+    return tier;
+  }
+
+  if (calm) {
+    calm_since = calm_since != 0 ? calm_since : now;
+  } else {
+    calm_since = 0;
+  }
+  if (tier > 0 && calm_since != 0 && now - calm_since >= step_up_hold) {
+    --tier;
+    reason = Reason::Headroom;
+    last_change = now;
+    // ̒i֖߂ɂAx]T̂҂
+    calm_since = now;
+  }
+  return tier;
+}
+
+int resampler_quality_controller::get_tier()
+{
+  return tier;
+}
+
+float resampler_quality_controller::get_load()
+{
+  return load;
+}
+
+resampler_quality_controller::Reason resampler_quality_controller::get_reason()
+{
+  return reason;
+}
+
+const char* resampler_quality_controller::get_name(Reason reason)
+{
+  switch (reason) {
+  case Reason::Load:
+    return "load";
+  case Reason::Fill:
+    return "fill";
+  case Reason::Headroom:
+    return "headroom";
+  default:
+    return "none";
+  }
+}
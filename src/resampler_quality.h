@@ -0,0 +1,50 @@
+#pragma once
+#include <windows.h>
+#include <cstddef>
+
+// ^Xbhׂ̕Ƙ^obt@̎cʂAfoCX̃Tv̕i̒i߂B
+// ׂAׂ钆Ŏcʂ͂1iAׂ̒ႢԂ΂炭1i߂B^XbhG
+class resampler_quality_controller
+{
+public:
+  enum class Reason : int
+  {
+    None,
+    Load,      // ^XbhCPUԂoߎԂɑ΂Ē
+    Fill,      // ׂႭȂŁAN̘^obt@̎cʂڕW1/4؂
+    Headroom,  // ׂ̒ႢԂ̂Ŗ߂
+  };
+
+  // ׂ̈ړς𒴂牺AԂグ [%]B
+  // cʂ̕sׂ͕low_load_percentȏ̎邫ɂBׂႢ̂ɑȂ̂̓NbN̂ǂݏo̒~ŁAiĂȂ
+  static const int high_load_percent = 30;
+  static const int low_load_percent = 10;
+  // Aɉ܂ł̊ԊuƁAグ̂ɕKvȗ]T̑ [us]
+  static const UINT64 step_down_interval = 2000000;
+  static const UINT64 step_up_hold = 10000000;
+
+  explicit resampler_quality_controller(int num_tiers);
+
+  // iƂ̂YāAtiernߒ
+  void reset(int tier);
+  // NɌĂԁBnow͍̎ [us]Bbusy͑O񂩂^XbhgCPUԁAelapsed͓Ԃ̌oߎԂŁAPʂ͑ĂΉł悢B
+  // fill͋N_̘^obt@̎cʁAtarget̖͂ڕWŁAĐłȂ0nBςׂiԂ
+  int update(UINT64 now, UINT64 busy, UINT64 elapsed, size_t fill, size_t target);
+
+  int get_tier();
+  // oߎԂɑ΂^XbhCPUԂ̈ړ [%]
+  float get_load();
+  // Oɒiς
+  Reason get_reason();
+  static const char* get_name(Reason reason);
+
+private:
+  int num_tiers;
+  int tier;
+  float load;
+  bool has_load;
+  Reason reason;
+  UINT64 last_change;
+  // ׂ̒ႢԂn܂B0Ȃ獡ׂ͕ႭȂ
+  UINT64 calm_since;
+};
@@ -1,9 +1,11 @@
 #include "ring_buffer.h"
+#include <algorithm>
 
 ring_buffer::ring_buffer(size_t buffer_size)
   : head(0)
   , tail(0)
   , buffer_full(false)
+  , silent_length(0)
 {
   buffer.assign(buffer_size, 0.0f);
 }
@@ -38,11 +40,50 @@ const std::pair<segment, segment> ring_buffer::back(size_t length)
 
 void ring_buffer::pop_back(size_t length)
 {
+  // c葽͎̂ĂȂBt̎0̂Ăhead == tail̂܂܋󈵂ɂȂ̂ŉȂ
+  length = length < data_length() ? length : data_length();
+  if (length == 0) {
+    return;
+  }
   tail += length;
   if (tail >= buffer.size()) {
     tail -= buffer.size();
   }
   buffer_full = false;
+  if (silent_length > data_length()) {
+    silent_length = data_length();
+  }
+}
+
+void ring_buffer::pop_back_to(float* destination, size_t length)
+{
+  // Ȃ0Ŗ߁ARs[̂Ă
+  const size_t available = length < data_length() ? length : data_length();
+  const auto segments = back(available);
+  std::copy(segments.first.data, segments.first.data + segments.first.length, destination);
+  if (segments.second.length > 0) {
+    std::copy(segments.second.data, segments.second.data + segments.second.length, destination + segments.first.length);
+  }
+  std::fill(destination + available, destination + length, 0.0f);
+  pop_back(available);
+}
+
+void ring_buffer::clear()
+{
+  head = 0;
+  tail = 0;
+  buffer_full = false;
+  silent_length = 0;
+}
+
+size_t ring_buffer::size()
+{
+  return data_length();
+}
+
+size_t ring_buffer::capacity()
+{
+  return buffer.size();
 }
 
 size_t ring_buffer::data_length()
@@ -60,8 +101,61 @@ size_t ring_buffer::data_length()
   }
 }
 
+size_t ring_buffer::overlap_front(const segment& input, size_t overlap_length)
+{
+  size_t overlap = overlap_length;
+  if (overlap > data_length()) {
+    overlap = data_length();
+  }
+  if (overlap > input.length) {
+    overlap = input.length;
+  }
+
+  for (size_t i = 0; i < overlap; ++i) {
+    const size_t index = (head + buffer.size() - overlap + i) % buffer.size();
+    const float gain = static_cast<float>(i + 1) / (overlap + 1);
+    buffer[index] = buffer[index] * (1.0f - gain) + input.data[i] * gain;
+  }
+  push_front(segment{input.data + overlap, input.length - overlap});
+  return overlap;
+}
+
+void ring_buffer::push_silence(size_t length)
+{
+  if (length > buffer.size()) {
+    length = buffer.size();
+  }
+  const auto free_length = buffer.size() - data_length();
+  const auto head_to_end = buffer.size() - head;
+  if (head_to_end > length) {
+    std::fill(buffer.begin() + head, buffer.begin() + head + length, 0.0f);
+    head += length;
+  } else {
+    std::fill(buffer.begin() + head, buffer.end(), 0.0f);
+    std::fill(buffer.begin(), buffer.begin() + (length - head_to_end), 0.0f);
+    head = length - head_to_end;
+  }
+  if (free_length <= length) {
+    tail = head;
+    buffer_full = true;
+  } else {
+    buffer_full = false;
+  }
+  silent_length = silent_length + length < data_length() ? silent_length + length : data_length();
+}
+
+bool ring_buffer::is_silent()
+{
+  return silent_length == data_length();
+}
+
 void ring_buffer::push_front(const segment& input)
 {
+  // eʂ𒴂镪͌Â̂āA̗eʕ
+  if (input.length > buffer.size()) {
+    push_front(segment{input.data + input.length - buffer.size(), buffer.size()});
+    return;
+  }
   auto free_length = buffer.size() - data_length();
   auto head_to_end = buffer.size() - head;
   if (head_to_end > input.length) {
@@ -86,4 +180,7 @@ void ring_buffer::push_front(const segment& input)
   } else {
     buffer_full = false;
   }
+  if (input.length > 0) {
+    silent_length = 0;
+  }
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <cstdint>
+#include <cstddef>
 #include <vector>
 
 struct segment
@@ -13,12 +14,27 @@ class ring_buffer
 public:
   ring_buffer(size_t buffer_size);
   void push_front(const segment& input);
+  // ŐVoverlap_lengthTvinput̐擪`ɃNXtF[hAcǉB
+  // d˂TvԂ
+  size_t overlap_front(const segment& input, size_t overlap_length);
+  // lengthTvǉBēꂽ̒oĂAǂޑgɖƕ悤ɂ
+  void push_silence(size_t length);
+  // cĂTvSpush_silenceœꂽ
+  bool is_silent();
   const std::pair<segment, segment> back(size_t length);
+  // c肪length菭ȂΎcŜĂ
   void pop_back(size_t length);
+  // 擪lengthTvdestinationփRs[Ď̂ĂBc肪Ȃ0Ŗ߂
+  void pop_back_to(float* destination, size_t length);
+  void clear();
+  size_t size();
+  size_t capacity();
 
 private:
   size_t data_length();
   std::vector<float> buffer;
   size_t head, tail;
   bool buffer_full;
+  // ŐV琔Apush_silenceőēꂽ̒
+  size_t silent_length;
 };
@@ -0,0 +1,111 @@
+#include "shared_capture_export.h"
+#include <new>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+shared_capture_export::shared_capture_export(const std::string& name)
+  : name(name)
+  , mapping(nullptr)
+  , shared(nullptr)
+{
+  const size_t total_bytes = shared_capture::total_bytes();
+  void* view = nullptr;
+#ifdef _WIN32
+  auto handle = CreateFileMappingA(
+    INVALID_HANDLE_VALUE,
+    nullptr,
+    PAGE_READWRITE,
+    static_cast<DWORD>(static_cast<UINT64>(total_bytes) >> 32),
+    static_cast<DWORD>(total_bytes),
+    name.c_str()
+  );
+  if (!handle) {
+    throw std::runtime_error("Failed to create file mapping.");
+  }
+  view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, total_bytes);
+  if (!view) {
+    CloseHandle(handle);
+    throw std::runtime_error("Failed to map view of file.");
+  }
+  mapping = handle;
+#else
+  const int descriptor = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+  if (descriptor < 0) {
+    throw std::runtime_error("Failed to open shared memory.");
+  }
+  if (ftruncate(descriptor, static_cast<off_t>(total_bytes)) != 0) {
+    close(descriptor);
+    throw std::runtime_error("Failed to resize shared memory.");
+  }
+  view = mmap(nullptr, total_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0);
+  close(descriptor);
+  if (view == MAP_FAILED) {
+    throw std::runtime_error("Failed to map shared memory.");
+  }
+#endif
+
+  // ǂݎmagicĂ瑼̒lǂނ̂ŁAmagic͍Ōɏ
+  memset(view, 0, total_bytes);
+  shared = new (view) shared_capture::header;
+  shared->version = shared_capture::version;
+  shared->header_bytes = static_cast<uint32_t>(shared_capture::header_bytes());
+  shared->capacity_frames = shared_capture::capacity_frames;
+  shared->sampling_rate = 0;
+  shared->num_channels = 0;
+  shared->write_frame = 0;
+  shared->analyzer_sequence = 0;
+  std::atomic_thread_fence(std::memory_order_release);
+  shared->magic = shared_capture::magic;
+}
+
+shared_capture_export::~shared_capture_export()
+{
+#ifdef _WIN32
+  UnmapViewOfFile(shared);
+  CloseHandle(mapping);
+#else
+  munmap(shared, shared_capture::total_bytes());
+  shm_unlink(name.c_str());
+#endif
+}
+
+void shared_capture_export::publish_audio(const float* interleaved, size_t num_frames, int sampling_rate, int num_channels)
+{
+  const uint32_t channels = num_channels < static_cast<int>(shared_capture::max_channels) ? num_channels : shared_capture::max_channels;
+  shared->sampling_rate.store(static_cast<uint32_t>(sampling_rate), std::memory_order_relaxed);
+  shared->num_channels.store(channels, std::memory_order_relaxed);
+
+  const uint64_t write_frame = shared->write_frame.load(std::memory_order_relaxed);
+  for (uint32_t channel = 0; channel < channels; ++channel) {
+    float* destination = plane(channel);
+    for (size_t frame = 0; frame < num_frames; ++frame) {
+      destination[(write_frame + frame) % shared_capture::capacity_frames] = interleaved[frame * num_channels + channel];
+    }
+  }
+  shared->write_frame.store(write_frame + num_frames, std::memory_order_release);
+}
+
+void shared_capture_export::publish_analyzer(const shared_capture::analyzer_snapshot& snapshot)
+{
+  const uint64_t sequence = shared->analyzer_sequence.load(std::memory_order_relaxed);
+  shared->analyzer_sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  memcpy(&shared->analyzer, &snapshot, sizeof(snapshot));
+  shared->analyzer_sequence.store(sequence + 2, std::memory_order_release);
+}
+
+uint64_t shared_capture_export::get_write_frame()
+{
+  return shared->write_frame.load(std::memory_order_relaxed);
+}
+
+float* shared_capture_export::plane(uint32_t channel)
+{
+  return reinterpret_cast<float*>(reinterpret_cast<char*>(shared) + shared->header_bytes) + static_cast<size_t>(channel) * shared->capacity_frames;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include "shared_capture_layout.h"
+#include <string>
+
+// shared_capture_layout.h̃CAEgŖOtLAޑB
+// Windows̓t@C}bsOCreateFileMappingAȊOPOSIXshm_openg
+class shared_capture_export
+{
+public:
+  explicit shared_capture_export(const std::string& name);
+  ~shared_capture_export();
+
+  // ^XbhĂԁBC^[[uꂽ͂`l̃O֏
+  void publish_audio(const float* interleaved, size_t num_frames, int sampling_rate, int num_channels);
+  void publish_analyzer(const shared_capture::analyzer_snapshot& snapshot);
+  uint64_t get_write_frame();
+
+private:
+  float* plane(uint32_t channel);
+
+  std::string name;
+  void* mapping;
+  shared_capture::header* shared;
+};
@@ -0,0 +1,108 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// ^̃[vobNƉ͌ʂAvZX狤Lzɓǂނ߂̃CAEgB
+// ݂̓vOC1XbhBǂݎ͉vZXł悭AbN͎ȂB
+//
+// [header][channel 0 plane][channel 1 plane]
+// planecapacity_framesfloat̃OŁAt[n n % capacity_frames ɓB
+// write_frame͏ݍς݂̒ʎZt[ŁA݌releaseōXVB
+// ǂݎwrite_frameǂłRs[Axwrite_frameǂŏ㏑ꂽ̂ĂB
+// ͌ʂanalyzer_sequenceɂseqlockŎ(̊Ԃ͏ݒ)B
+namespace shared_capture
+{
+const uint32_t magic = 0x5341424C;  // "LBAS"
+const uint32_t version = 1;
+const uint32_t max_channels = 2;
+const uint32_t capacity_frames = 1 << 16;
+const uint32_t num_bpm_scores = 136;  // Analyzer::max_interval - Analyzer::min_interval + 1
+
+#ifdef _WIN32
+const char* const default_name = "Local\\LoopbackAudioSource";
+#else
+const char* const default_name = "/LoopbackAudioSource";
+#endif
+
+struct analyzer_snapshot
+{
+  uint64_t sample_position;  // ͂_write_frame
+  float bpm;
+  float milliseconds_to_next_beat;
+  float rms;
+  float vu;
+  float bpm_score[num_bpm_scores];
+};
+
+struct header
+{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t header_bytes;     // plane̊JnItZbg
+  uint32_t capacity_frames;
+  std::atomic<uint32_t> sampling_rate;
+  std::atomic<uint32_t> num_channels;
+  std::atomic<uint64_t> write_frame;
+  std::atomic<uint64_t> analyzer_sequence;
+  analyzer_snapshot analyzer;
+};
+
+inline size_t header_bytes()
+{
+  return (sizeof(header) + 63) / 64 * 64;
+}
+
+inline size_t total_bytes()
+{
+  return header_bytes() + sizeof(float) * max_channels * capacity_frames;
+}
+
+inline const float* plane(const header* shared, uint32_t channel)
+{
+  return reinterpret_cast<const float*>(reinterpret_cast<const char*>(shared) + shared->header_bytes) + static_cast<size_t>(channel) * shared->capacity_frames;
+}
+
+// num_framest[destinationփRs[B߂l̓Rs[łLt[(ɋl߂)
+inline size_t read_latest(const header* shared, uint32_t channel, float* destination, size_t num_frames)
+{
+  const uint64_t end = shared->write_frame.load(std::memory_order_acquire);
+  if (num_frames > shared->capacity_frames) {
+    num_frames = shared->capacity_frames;
+  }
+  if (num_frames > end) {
+    num_frames = static_cast<size_t>(end);
+  }
+  const uint64_t begin = end - num_frames;
+  const float* source = plane(shared, channel);
+  for (uint64_t frame = begin; frame < end; ++frame) {
+    destination[frame - begin] = source[frame % shared->capacity_frames];
+  }
+  // Rs[ɏ肪ď㏑擪͖
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const uint64_t latest = shared->write_frame.load(std::memory_order_relaxed);
+  const uint64_t oldest_valid = latest > shared->capacity_frames ? latest - shared->capacity_frames : 0;
+  if (oldest_valid <= begin) {
+    return num_frames;
+  }
+  return oldest_valid >= end ? 0 : static_cast<size_t>(end - oldest_valid);
+}
+
+// ͌ʂ̈тRs[BݒȂ牽xĎsAȂfalse
+inline bool read_analyzer(const header* shared, analyzer_snapshot* destination)
+{
+  for (int retry = 0; retry < 64; ++retry) {
+    const uint64_t before = shared->analyzer_sequence.load(std::memory_order_acquire);
+    if (before & 1) {
+      continue;
+    }
+    std::memcpy(destination, &shared->analyzer, sizeof(analyzer_snapshot));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (shared->analyzer_sequence.load(std::memory_order_relaxed) == before) {
+      return true;
+    }
+  }
+  return false;
+}
+}
@@ -1,13 +1,19 @@
 #include "spatializer_plugin.h"
 #include "audio_device.h"
+#include "native_spatializer.h"
+#include "halfband_resampler.h"
+#include "metrics.h"
+#include "trace.h"
+#include "allocation_guard.h"
 #include <string.h>
 #include <windows.h>
-#include <mutex>
+#include <atomic>
 #include <array>
 #include <algorithm>
 
 HMODULE oculus_spatializer_dll;
 UnityGetAudioEffectDefinitionsFunc OculusSpatializer_UnityGetAudioEffectDefinitions;
+// Oculus Spatializerǂݍ߂Ȃꍇ́Aȉɓpi[̃R[obN
 UnityAudioEffect_CreateCallback OculusSpatializer_CreateCallback;
 UnityAudioEffect_ReleaseCallback OculusSpatializer_ReleaseCallback;
 UnityAudioEffect_ProcessCallback OculusSpatializer_ProcessCallback;
@@ -16,16 +22,19 @@ UnityAudioEffect_GetFloatParameterCallback OculusSpatializer_GetFloatParameterCa
 UnityAudioEffect_GetFloatBufferCallback OculusSpatializer_GetFloatBufferCallback;
 UnityAudioEffect_DistanceAttenuationCallback OculusSpatializer_DistanceAttenuationCallback;
 
-std::mutex state_mutex;
 
 enum class Parameters : int
 {
   OculusSpatializerMax = 4, // Oculus Spatializer5(0~4)̃p[^
   LoopbackEnabled = 5,
   LoopbackChannel = 6,
-  Max = 7,
+  Latency = 7,
+  Max = 8,
 };
 
+// Oculus SpatializerΉĂő̃TvOgB𒴂ꍇ͊Ԉēn
+const UInt32 max_oculus_spatializer_sampling_rate = 48000;
+
 char* strnew(const char* src)
 {
   char* newstr = new char[strlen(src) + 1];
@@ -63,8 +72,10 @@ void RegisterParameter(
 extern "C" UNITY_AUDIODSP_EXPORT_API int UnityGetAudioEffectDefinitions(UnityAudioEffectDefinition*** definitionptr)
 {
   static UnityAudioEffectDefinition definition;
-  static UnityAudioEffectDefinition* definition_array[1];
+  static UnityAudioEffectDefinition self_reference_definition;
+  static UnityAudioEffectDefinition* definition_array[2];
   ZeroMemory(&definition, sizeof(UnityAudioEffectDefinition));
+  ZeroMemory(&self_reference_definition, sizeof(UnityAudioEffectDefinition));
 
   strcpy_s(definition.name, "Oculus Spatializer + Loopback");
   definition.structsize = sizeof(UnityAudioEffectDefinition);
@@ -81,14 +92,15 @@ extern "C" UNITY_AUDIODSP_EXPORT_API int UnityGetAudioEffectDefinitions(UnityAud
   definition.paramdefs = new UnityAudioParameterDefinition[static_cast<int>(Parameters::Max)];
   RegisterParameter(definition, "Loopback On", "", 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, static_cast<int>(Parameters::LoopbackEnabled), "Enable Loopback Audio");
   RegisterParameter(definition, "Loopback Ch", "", 0.0f, 1.0f, 0.0f, 1.0f, 1.0f, static_cast<int>(Parameters::LoopbackChannel), "Loopback Audio Channel");
+  RegisterParameter(definition, "Latency", "ms", 0.0f, 100.0f, 0.0f, 1.0f, 1.0f, static_cast<int>(Parameters::Latency), "Latency added by internal rate conversion (read only)");
 
   definition.flags |= UnityAudioEffectDefinitionFlags_IsSpatializer;
 
-  if (!OculusSpatializer_UnityGetAudioEffectDefinitions) {
-    return 0;
+  if (OculusSpatializer_UnityGetAudioEffectDefinitions) {
+    OculusSpatializer_UnityGetAudioEffectDefinitions(definitionptr);
+  } else {
+    NativeSpatializer_UnityGetAudioEffectDefinitions(definitionptr);
   }
-
-  OculusSpatializer_UnityGetAudioEffectDefinitions(definitionptr);
   auto oculus_spatializer_definition = (*definitionptr)[0];
   auto oculus_spatializer_numparams = oculus_spatializer_definition->numparameters;
   auto oculus_spatializer_paramdefs = oculus_spatializer_definition->paramdefs;
@@ -106,32 +118,55 @@ extern "C" UNITY_AUDIODSP_EXPORT_API int UnityGetAudioEffectDefinitions(UnityAud
   OculusSpatializer_GetFloatParameterCallback = oculus_spatializer_definition->getfloatparameter;
   OculusSpatializer_GetFloatBufferCallback = oculus_spatializer_definition->getfloatbuffer;
 
+  strcpy_s(self_reference_definition.name, "Loopback Self Reference");
+  self_reference_definition.structsize = sizeof(UnityAudioEffectDefinition);
+  self_reference_definition.paramstructsize = sizeof(UnityAudioParameterDefinition);
+  self_reference_definition.apiversion = UNITY_AUDIO_PLUGIN_API_VERSION;
+  self_reference_definition.pluginversion = 0x010000;
+  self_reference_definition.create = SelfReferenceCreateCallback;
+  self_reference_definition.release = SelfReferenceReleaseCallback;
+  self_reference_definition.process = SelfReferenceProcessCallback;
+
   definition_array[0] = &definition;
+  definition_array[1] = &self_reference_definition;
   *definitionptr = definition_array;
-  return 1;
+  return 2;
 }
 
+
 struct EffectData
 {
   void* oculus_spatializer_data;
-  bool enabled;
-  int channel;
+  std::atomic<bool> enabled;
+  std::atomic<int> channel;
+  std::unique_ptr<halfband_resampler> rate_converter;
+  // ̃\[X^ǂݏoB\[XɎ̂ŁÃ~LT[Xbh̃\[XƕsēǂłȂ
+  std::vector<float> loopback_buffer;
+  // r؂̕Ԃ̏Ԃ\[XɎ
+  capture_buffer::reader loopback_reader;
 };
 
+// state->effectdataւOculus SpatializerĂԂ߁AstateX^bNɕ
+UnityAudioEffectState oculus_spatializer_state(const UnityAudioEffectState* state)
+{
+  UnityAudioEffectState result = *state;
+  auto data = state->GetEffectData<EffectData>();
+  result.effectdata = data->oculus_spatializer_data;
+  if (data->rate_converter) {
+    result.samplerate /= data->rate_converter->get_factor();
+    result.dspbuffersize /= data->rate_converter->get_factor();
+  }
+  return result;
+}
+
 UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK DistanceAttenuationCallback(UnityAudioEffectState* state, float distanceIn, float attenuationIn, float* attenuationOut)
 {
   if (!OculusSpatializer_DistanceAttenuationCallback) {
     return UNITY_AUDIODSP_ERR_UNSUPPORTED;
   }
 
-  {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    auto loopback_effect_data = state->GetEffectData<EffectData>();
-    state->effectdata = loopback_effect_data->oculus_spatializer_data;
-    auto result = OculusSpatializer_DistanceAttenuationCallback(state, distanceIn, attenuationIn, attenuationOut);
-    state->effectdata = loopback_effect_data;
-    return result;
-  }
+  auto oculus_state = oculus_spatializer_state(state);
+  return OculusSpatializer_DistanceAttenuationCallback(&oculus_state, distanceIn, attenuationIn, attenuationOut);
 }
 
 UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback(UnityAudioEffectState * state)
@@ -139,11 +174,20 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback(UnityAudioEffectSta
   if (!OculusSpatializer_CreateCallback) {
     return UNITY_AUDIODSP_ERR_UNSUPPORTED;
   }
-  // Oculus SpatializerT|[gĂȂTvOg
-  if (48000 < state->samplerate) {
-    return UNITY_AUDIODSP_ERR_UNSUPPORTED;
+  // Oculus SpatializerT|[gĂȂTvOgł́A2ׂ̂敪1ɊԈď
+  int rate_factor = 1;
+  if (OculusSpatializer_UnityGetAudioEffectDefinitions) {
+    while (state->samplerate / rate_factor > max_oculus_spatializer_sampling_rate) {
+      rate_factor *= 2;
+    }
   }
+  const auto host_samplerate = state->samplerate;
+  const auto host_dspbuffersize = state->dspbuffersize;
+  state->samplerate /= rate_factor;
+  state->dspbuffersize /= rate_factor;
   auto oculus_spatializer_result = OculusSpatializer_CreateCallback(state);
+  state->samplerate = host_samplerate;
+  state->dspbuffersize = host_dspbuffersize;
   if (oculus_spatializer_result != UNITY_AUDIODSP_OK) {
     return oculus_spatializer_result;
   }
@@ -152,18 +196,23 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback(UnityAudioEffectSta
   state->spatializerdata->distanceattenuationcallback = DistanceAttenuationCallback;
 
   EffectData* effect_data = new EffectData;
-  memset(effect_data, 0, sizeof(EffectData));
   effect_data->oculus_spatializer_data = state->effectdata;
   effect_data->enabled = false;
   effect_data->channel = 0;
+  if (rate_factor > 1) {
+    effect_data->rate_converter = std::make_unique<halfband_resampler>(
+      rate_factor,
+      2,
+      (std::max)(host_dspbuffersize, 4096u));
+  }
+  effect_data->loopback_buffer.resize(AudioDevice::max_buffer_size);
   state->effectdata = effect_data;
 
   if (!device) {
     device = new AudioDevice();
   }
-  if (!device->is_initialized()) {
-    device->initialize(32, state->samplerate);
-  }
+  // ^XbhŏBł܂ł͖Ԃ
+  device->start(state->samplerate);
 
   return UNITY_AUDIODSP_OK;
 }
@@ -174,27 +223,28 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ReleaseCallback(UnityAudioEffectSt
     return UNITY_AUDIODSP_ERR_UNSUPPORTED;
   }
 
-  {
-    // ProcessCallbackReleaseCallbackĂ΂̂h
-    std::lock_guard<std::mutex> lock(state_mutex);
-
-    EffectData* loopback_effect_data = state->GetEffectData<EffectData>();
-    assert(loopback_effect_data != loopback_effect_data->oculus_spatializer_data);
-    state->effectdata = loopback_effect_data->oculus_spatializer_data;
-    auto oculus_spatializer_result = OculusSpatializer_ReleaseCallback(state);
-    delete loopback_effect_data;
+  EffectData* loopback_effect_data = state->GetEffectData<EffectData>();
+  assert(loopback_effect_data != loopback_effect_data->oculus_spatializer_data);
+  state->effectdata = loopback_effect_data->oculus_spatializer_data;
+  auto oculus_spatializer_result = OculusSpatializer_ReleaseCallback(state);
+  // AudioPluginInterface.ȟ_: release̓CX^X钼OɌĂ΂AȌケ̃CX^X̃R[obN͌Ă΂ȂB
+  // ProcessCallbackƏdȂȂ̂ŁAłɍ폜Ă悢
+  delete loopback_effect_data;
 
-    return oculus_spatializer_result;
-  }
+  return oculus_spatializer_result;
 }
 
 using namespace std::chrono;
 
 UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback(UnityAudioEffectState* state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels)
 {
+  if (!device) {
+    return UNITY_AUDIODSP_OK;
+  }
+
   if (device->is_initialized() == false) {
-    // ď
-    device->initialize(32, state->samplerate);
+    // I[fBIXbhł͏A^Xbhֈ˗
+    device->start(state->samplerate);
   }
 
   if (!OculusSpatializer_ProcessCallback) {
@@ -205,37 +255,17 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback(UnityAudioEffectSt
     return UNITY_AUDIODSP_OK;
   }
 
-  static std::array<bool, AudioDevice::max_channels> previous_enabled{ false, false };
-  bool enabled;
-  int channel;
-  bool need_reset = false;
-  bool need_catchup = false;
-  {
-    std::lock_guard<std::mutex> lock(state_mutex);
+  allocation_guard::scope no_allocation;
+  TRACE_SCOPE("ProcessCallback");
+  metrics::scoped_timer timer(metrics::Histogram::ProcessCallbackTime);
+  metrics::increment(metrics::Counter::ProcessCallbacks);
 
-    if (!device) {
-      return UNITY_AUDIODSP_OK;
-    }
+  EffectData* loopback_effect_data = state->GetEffectData<EffectData>();
+  const bool enabled = loopback_effect_data->enabled.load(std::memory_order_relaxed);
+  const int channel = loopback_effect_data->channel.load(std::memory_order_relaxed);
 
-    EffectData* loopback_effect_data = state->GetEffectData<EffectData>();
-    enabled = loopback_effect_data->enabled;
-    channel = loopback_effect_data->channel;
-
-    if (std::all_of(previous_enabled.begin(), previous_enabled.end(), [](bool x) { return x == false; })) {
-      need_reset = true;
-    } else if (previous_enabled[channel] == false && !enabled) {
-      need_catchup = true;
-    }
-  }
-  if (need_reset) {
-    device->reset_buffer();
-  }
-  if (need_catchup) {
-    device->catch_up(channel);
-  }
-  previous_enabled[channel] = enabled;
-  if (enabled) {
-    auto recorded_buffer = device->get_buffer(channel, length);
+  const float* recorded_buffer = loopback_effect_data->loopback_buffer.data();
+  if (device->read_source(channel, enabled, loopback_effect_data->loopback_reader, loopback_effect_data->loopback_buffer.data(), length)) {
     // `lɓ͂
     for (unsigned int i = 0; i < length * outchannels; i += outchannels) {
       inbuffer[i] = recorded_buffer[i / outchannels];
@@ -243,15 +273,31 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback(UnityAudioEffectSt
     }
   }
 
-  {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    EffectData* loopback_effect_data = state->GetEffectData<EffectData>();
-    state->effectdata = loopback_effect_data->oculus_spatializer_data;
-    auto result = OculusSpatializer_ProcessCallback(state, inbuffer, outbuffer, length, inchannels, outchannels);
-    state->effectdata = loopback_effect_data;
+  auto oculus_state = oculus_spatializer_state(state);
+  auto& rate_converter = loopback_effect_data->rate_converter;
+  if (!rate_converter) {
+    return OculusSpatializer_ProcessCallback(&oculus_state, inbuffer, outbuffer, length, inchannels, outchannels);
+  }
 
-    return result;
+  // ԈĂOculus SpatializerɓnAo͂̃[g֕Ԃ
+  const int factor = rate_converter->get_factor();
+  if (length % factor != 0 ||
+      inchannels != rate_converter->get_num_channels() || outchannels != rate_converter->get_num_channels()) {
+    // łȂÕubN̓e炳Ȃ悤AԂ
+    memset(outbuffer, 0, sizeof(float) * length * outchannels);
+    return UNITY_AUDIODSP_ERR_UNSUPPORTED;
+  }
+  // mۂ蒷ubŃAfactor̔{̒ɕď
+  const unsigned int max_frames = static_cast<unsigned int>(rate_converter->get_max_frames() / factor * factor);
+  UNITY_AUDIODSP_RESULT result = UNITY_AUDIODSP_OK;
+  for (unsigned int offset = 0; offset < length; offset += max_frames) {
+    const unsigned int frames = (std::min)(max_frames, length - offset);
+    auto low_rate_input = rate_converter->decimate(inbuffer + offset * inchannels, frames);
+    const auto chunk_result = OculusSpatializer_ProcessCallback(&oculus_state, low_rate_input, rate_converter->get_low_rate_output(), frames / factor, inchannels, outchannels);
+    rate_converter->interpolate(outbuffer + offset * outchannels, frames);
+    result = chunk_result != UNITY_AUDIODSP_OK ? chunk_result : result;
   }
+  return result;
 }
 
 UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SetFloatParameterCallback(UnityAudioEffectState* state, int index, float value)
@@ -259,37 +305,27 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SetFloatParameterCallback(UnityAud
   if (!OculusSpatializer_SetFloatParameterCallback) {
     return UNITY_AUDIODSP_ERR_UNSUPPORTED;
   }
-  {
-    std::lock_guard<std::mutex> lock(state_mutex);
-    if (!device) {
-      return UNITY_AUDIODSP_OK;
-    }
+  if (!device) {
+    return UNITY_AUDIODSP_OK;
+  }
 
-    if (index > static_cast<int>(Parameters::OculusSpatializerMax)) {
-      auto data = state->GetEffectData<EffectData>();
-      switch (index) {
-      case static_cast<int>(Parameters::LoopbackEnabled) :
-        if (value > 0.0f) {
-          data->enabled = true;
-        } else {
-          data->enabled = false;
-        }
-        break;
-      case static_cast<int>(Parameters::LoopbackChannel) :
-        if (value > 0.0f) {
-          data->channel = 1;  // E`l
-        } else {
-          data->channel = 0;  // `l
-        }
+  if (index > static_cast<int>(Parameters::OculusSpatializerMax)) {
+    auto data = state->GetEffectData<EffectData>();
+    switch (index) {
+    case static_cast<int>(Parameters::LoopbackEnabled) :
+      data->enabled.store(value > 0.0f, std::memory_order_relaxed);
+      break;
+    case static_cast<int>(Parameters::LoopbackChannel) :
+      if (value > 0.0f) {
+        data->channel.store(1, std::memory_order_relaxed);  // E`l
+      } else {
+        data->channel.store(0, std::memory_order_relaxed);  // `l
       }
-      return UNITY_AUDIODSP_OK;
-    } else {
-      EffectData* loopback_effect_data = state->GetEffectData<EffectData>();
-      state->effectdata = loopback_effect_data->oculus_spatializer_data;
-      auto oculus_spatializer_result = OculusSpatializer_SetFloatParameterCallback(state, index, value);
-      state->effectdata = loopback_effect_data;
-      return oculus_spatializer_result;
     }
+    return UNITY_AUDIODSP_OK;
+  } else {
+    auto oculus_state = oculus_spatializer_state(state);
+    return OculusSpatializer_SetFloatParameterCallback(&oculus_state, index, value);
   }
 }
 
@@ -298,34 +334,35 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatParameterCallback(UnityAud
   if (!OculusSpatializer_GetFloatParameterCallback) {
     return UNITY_AUDIODSP_ERR_UNSUPPORTED;
   }
-  
-  {
-    std::lock_guard<std::mutex> lock(state_mutex);
-
-    if (index > static_cast<int>(Parameters::OculusSpatializerMax)) {
-      auto data = state->GetEffectData<EffectData>();
-      switch (static_cast<Parameters>(index)) {
-      case Parameters::LoopbackChannel:
-        *value = static_cast<float>(data->channel);
-        break;
-      case Parameters::LoopbackEnabled:
-        if (data->enabled) {
-          *value = 1.0f;
-        } else {
-          *value = 0.0f;
-        }
+
+  if (index > static_cast<int>(Parameters::OculusSpatializerMax)) {
+    auto data = state->GetEffectData<EffectData>();
+    switch (static_cast<Parameters>(index)) {
+    case Parameters::LoopbackChannel:
+      *value = static_cast<float>(data->channel.load(std::memory_order_relaxed));
+      break;
+    case Parameters::LoopbackEnabled:
+      if (data->enabled.load(std::memory_order_relaxed)) {
+        *value = 1.0f;
+      } else {
+        *value = 0.0f;
       }
-      if (valuestr != NULL) {
-        valuestr[0] = 0;
+      break;
+    case Parameters::Latency:
+      if (data->rate_converter) {
+        *value = data->rate_converter->get_latency_samples() * 1000.0f / state->samplerate;
+      } else {
+        *value = 0.0f;
       }
-      return UNITY_AUDIODSP_OK;
-    } else {
-      EffectData* loopback_effect_data = state->GetEffectData<EffectData>();
-      state->effectdata = loopback_effect_data->oculus_spatializer_data;
-      auto result = OculusSpatializer_GetFloatParameterCallback(state, index, value, valuestr);
-      state->effectdata = loopback_effect_data;
-      return result;
+      break;
+    }
+    if (valuestr != NULL) {
+      valuestr[0] = 0;
     }
+    return UNITY_AUDIODSP_OK;
+  } else {
+    auto oculus_state = oculus_spatializer_state(state);
+    return OculusSpatializer_GetFloatParameterCallback(&oculus_state, index, value, valuestr);
   }
 }
 
@@ -335,13 +372,32 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback(UnityAudioE
     return UNITY_AUDIODSP_ERR_UNSUPPORTED;
   }
 
-  {
-    std::lock_guard<std::mutex> lock(state_mutex);
+  auto oculus_state = oculus_spatializer_state(state);
+  return OculusSpatializer_GetFloatBufferCallback(&oculus_state, name, buffer, numsamples);
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SelfReferenceCreateCallback(UnityAudioEffectState* state)
+{
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SelfReferenceReleaseCallback(UnityAudioEffectState* state)
+{
+  return UNITY_AUDIODSP_OK;
+}
 
-    auto loopback_effect_data = state->GetEffectData<EffectData>();
-    state->effectdata = loopback_effect_data->oculus_spatializer_data;
-    auto result = OculusSpatializer_GetFloatBufferCallback(state, name, buffer, numsamples);
-    state->effectdata = loopback_effect_data;
-    return result;
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SelfReferenceProcessCallback(UnityAudioEffectState* state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels)
+{
+  // ɂ͎ɒʂA^XbhǂގQƃO֎ʂ
+  memcpy(outbuffer, inbuffer, sizeof(float) * length * outchannels);
+  if (!device || inchannels != outchannels) {
+    return UNITY_AUDIODSP_OK;
+  }
+  if ((state->flags & UnityAudioEffectStateFlags_IsPaused) || (state->flags & UnityAudioEffectStateFlags_IsMuted)) {
+    return UNITY_AUDIODSP_OK;
   }
+
+  allocation_guard::scope no_allocation;
+  device->push_reference(inbuffer, length, inchannels);
+  return UNITY_AUDIODSP_OK;
 }
@@ -9,5 +9,10 @@ UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SetFloatParameterCallback(UnityAud
 UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatParameterCallback(UnityAudioEffectState* state, int index, float* value, char *valuestr);
 UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback(UnityAudioEffectState* state, const char* name, float* buffer, int numsamples);
 
+// Q[g̏o͂ȏo͏̎QƂƂĎ荞ރGtFNgBMasterO[v̍Ōɑ}
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SelfReferenceCreateCallback(UnityAudioEffectState* state);
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SelfReferenceReleaseCallback(UnityAudioEffectState* state);
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SelfReferenceProcessCallback(UnityAudioEffectState* state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels);
+
 typedef int (*UnityGetAudioEffectDefinitionsFunc)(UnityAudioEffectDefinition*** descptr);
 extern UnityGetAudioEffectDefinitionsFunc OculusSpatializer_UnityGetAudioEffectDefinitions;
@@ -0,0 +1,207 @@
+#include "stream_recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <malloc.h>
+#include <stdexcept>
+
+namespace
+{
+const WORD wave_format_pcm = 1;
+const WORD wave_format_ieee_float = 3;
+// f[^̐擪staging_alignmentɑ邽߁AfmtdatåԂJUNK`NŖ߂B
+// staging͏Ɉtŏ̂ŁAȍ~݂̏SċEn܂
+const UINT32 header_bytes = 4096;
+const UINT32 fmt_chunk_end = 36;
+const UINT32 junk_bytes = header_bytes - fmt_chunk_end - 8 - 8;
+// RIFF̃TCY32bitȂ̂ŁA𒴂ȍ~͏Ȃ
+const UINT64 max_data_bytes = 0xFFFFFFFFull - header_bytes;
+
+void put_u32(BYTE* destination, UINT32 value)
+{
+  destination[0] = static_cast<BYTE>(value);
+  destination[1] = static_cast<BYTE>(value >> 8);
+  destination[2] = static_cast<BYTE>(value >> 16);
+  destination[3] = static_cast<BYTE>(value >> 24);
+}
+
+void put_u16(BYTE* destination, WORD value)
+{
+  destination[0] = static_cast<BYTE>(value);
+  destination[1] = static_cast<BYTE>(value >> 8);
+}
+}
+
+stream_recorder::stream_recorder(const std::string& path, int sampling_rate, int num_channels, SampleFormat format)
+  : file(nullptr)
+  , sampling_rate(sampling_rate)
+  , num_channels(num_channels)
+  , format(format)
+  , bytes_per_sample(format == SampleFormat::Int16 ? sizeof(INT16) : sizeof(float))
+  , ring(static_cast<size_t>(sampling_rate) * num_channels * ring_seconds)
+  , write_index(0)
+  , read_index(0)
+  , staging(static_cast<BYTE*>(_aligned_malloc(staging_bytes, staging_alignment)))
+  , data_bytes(0)
+  , written_frames(0)
+  , dropped_frames(0)
+  , stop_requested(false)
+{
+  if (!staging) {
+    throw std::runtime_error("Failed to allocate recording buffer.");
+  }
+  if (fopen_s(&file, path.c_str(), "wb") != 0 || !file) {
+    throw std::runtime_error("Failed to open recording file.");
+  }
+  // stagingŏ\傫܂Ƃ߂̂ŁACRT̃obt@͎gȂ
+  setvbuf(file, nullptr, _IONBF, 0);
+  write_header();
+  writer = std::thread(&stream_recorder::run, this);
+}
+
+stream_recorder::~stream_recorder()
+{
+  close();
+}
+
+void stream_recorder::close()
+{
+  if (!file) {
+    return;
+  }
+  stop_requested = true;
+  if (writer.joinable()) {
+    writer.join();
+  }
+  write_header();
+  fclose(file);
+  file = nullptr;
+}
+
+void stream_recorder::push(const float* interleaved, size_t num_frames)
+{
+  const size_t num_samples = num_frames * num_channels;
+  if (stop_requested.load(std::memory_order_relaxed)) {
+    return;
+  }
+  const size_t write = write_index.load(std::memory_order_relaxed);
+  const size_t read = read_index.load(std::memory_order_acquire);
+  if (ring.size() - (write - read) < num_samples) {
+    dropped_frames.fetch_add(num_frames, std::memory_order_relaxed);
+    return;
+  }
+
+  const size_t offset = write % ring.size();
+  const size_t first = (std::min)(num_samples, ring.size() - offset);
+  memcpy(ring.data() + offset, interleaved, first * sizeof(float));
+  memcpy(ring.data(), interleaved + first, (num_samples - first) * sizeof(float));
+  write_index.store(write + num_samples, std::memory_order_release);
+}
+
+UINT64 stream_recorder::get_written_frames()
+{
+  return written_frames;
+}
+
+UINT64 stream_recorder::get_dropped_frames()
+{
+  return dropped_frames;
+}
+
+void stream_recorder::aligned_deleter::operator()(BYTE* pointer) const
+{
+  _aligned_free(pointer);
+}
+
+int stream_recorder::get_sampling_rate()
+{
+  return sampling_rate;
+}
+
+void stream_recorder::run()
+{
+  size_t staging_used = 0;
+  auto last_header = std::chrono::steady_clock::now();
+  for (;;) {
+    // ~vɓǂނƂŁA~Oɐς܂ꂽK؂
+    const bool stopping = stop_requested.load();
+    const size_t write = write_index.load(std::memory_order_acquire);
+    size_t read = read_index.load(std::memory_order_relaxed);
+
+    while (read != write) {
+      const size_t offset = read % ring.size();
+      const size_t contiguous = (std::min)(write - read, ring.size() - offset);
+      const size_t num_samples = (std::min)(contiguous, (staging_bytes - staging_used) / bytes_per_sample);
+      if (format == SampleFormat::Int16) {
+        // ͈͊O͖OaĊۂ߂
+        auto destination = reinterpret_cast<INT16*>(staging.get() + staging_used);
+        for (size_t index = 0; index < num_samples; ++index) {
+          const float sample = (std::max)(-1.0f, (std::min)(1.0f, ring[offset + index]));
+          destination[index] = static_cast<INT16>(lrintf(sample * 32767.0f));
+        }
+      } else {
+        memcpy(staging.get() + staging_used, ring.data() + offset, num_samples * sizeof(float));
+      }
+      staging_used += num_samples * bytes_per_sample;
+      read += num_samples;
+      read_index.store(read, std::memory_order_release);
+      if (staging_used == staging_bytes) {
+        write_staging(staging_used);
+        staging_used = 0;
+      }
+    }
+
+    if (stopping) {
+      break;
+    }
+
+    // rŗĂǂ߂悤Awb_̃TCYIɍXV
+    const auto now = std::chrono::steady_clock::now();
+    if (now - last_header > std::chrono::seconds(1)) {
+      write_header();
+      last_header = now;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  write_staging(staging_used);
+}
+
+void stream_recorder::write_staging(size_t num_bytes)
+{
+  if (num_bytes == 0 || data_bytes + num_bytes > max_data_bytes) {
+    return;
+  }
+  if (fwrite(staging.get(), 1, num_bytes, file) != num_bytes) {
+    return;
+  }
+  data_bytes += num_bytes;
+  written_frames = data_bytes / (bytes_per_sample * num_channels);
+}
+
+void stream_recorder::write_header()
+{
+  BYTE header[header_bytes];
+  const WORD block_align = static_cast<WORD>(bytes_per_sample * num_channels);
+  memcpy(header, "RIFF", 4);
+  put_u32(header + 4, static_cast<UINT32>(header_bytes - 8 + data_bytes));
+  memcpy(header + 8, "WAVE", 4);
+  memcpy(header + 12, "fmt ", 4);
+  put_u32(header + 16, 16);
+  put_u16(header + 20, format == SampleFormat::Int16 ? wave_format_pcm : wave_format_ieee_float);
+  put_u16(header + 22, static_cast<WORD>(num_channels));
+  put_u32(header + 24, static_cast<UINT32>(sampling_rate));
+  put_u32(header + 28, static_cast<UINT32>(sampling_rate) * block_align);
+  put_u16(header + 32, block_align);
+  put_u16(header + 34, static_cast<WORD>(bytes_per_sample * 8));
+  memcpy(header + fmt_chunk_end, "JUNK", 4);
+  put_u32(header + fmt_chunk_end + 4, junk_bytes);
+  memset(header + fmt_chunk_end + 8, 0, junk_bytes);
+  memcpy(header + header_bytes - 8, "data", 4);
+  put_u32(header + header_bytes - 4, static_cast<UINT32>(data_bytes));
+
+  fseek(file, 0, SEEK_SET);
+  fwrite(header, 1, header_bytes, file);
+  // 2GB𒴂longňʒuĂȂ̂ŁASEEK_ENDŖ֖߂
+  fseek(file, 0, SEEK_END);
+}
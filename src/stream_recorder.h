@@ -0,0 +1,65 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// WAṼTv`BStartRecordingWithFormat̔ԍƓ
+enum class SampleFormat : int
+{
+  Float32,
+  Int16,
+};
+
+// [vobNWAV(32bit float16bit)֏o^bvB
+// ^Xbh͊mۍς݂̃Ofloat̂܂܃Rs[邾ŁA`̕ϊƃt@C݂͐pXbh傫ȒPʂł܂Ƃ߂čs
+class stream_recorder
+{
+public:
+  stream_recorder(const std::string& path, int sampling_rate, int num_channels, SampleFormat format = SampleFormat::Float32);
+  ~stream_recorder();
+  // c؂ăt@CBȍ~push͖
+  void close();
+
+  // ^XbhĂԁBmۂVXeR[ȂB
+  // Oɓ肫Ȃꍇ̓ubNƎ̂Ădropped_framesɐ
+  void push(const float* interleaved, size_t num_frames);
+  UINT64 get_written_frames();
+  UINT64 get_dropped_frames();
+  int get_sampling_rate();
+
+private:
+  void run();
+  void write_staging(size_t num_bytes);
+  void write_header();
+
+  // O4bB݃Xbhl܂ĂȂ悤ɂ
+  static const int ring_seconds = 4;
+  // 1̏ݒPʁBy[WTCY̔{ɂ
+  static const size_t staging_bytes = 256 * 1024;
+  // staging̐擪ƃt@C݈̏ʒu𑵂鋫E
+  static const size_t staging_alignment = 4096;
+
+  struct aligned_deleter
+  {
+    void operator()(BYTE* pointer) const;
+  };
+
+  FILE* file;
+  int sampling_rate;
+  int num_channels;
+  SampleFormat format;
+  size_t bytes_per_sample;
+  std::vector<float> ring;
+  std::atomic<size_t> write_index;  // O̒ʎZTvʒu
+  std::atomic<size_t> read_index;
+  std::unique_ptr<BYTE, aligned_deleter> staging;
+  UINT64 data_bytes;
+  std::atomic<UINT64> written_frames;
+  std::atomic<UINT64> dropped_frames;
+  std::atomic<bool> stop_requested;
+  std::thread writer;
+};
@@ -0,0 +1,73 @@
+#include "synthetic_capture_backend.h"
+#include "capture_latency.h"
+#include <cmath>
+#include <algorithm>
+
+synthetic_capture_backend::synthetic_capture_backend(
+  int sampling_rate,
+  int buffer_length_millisec,
+  float tone_frequency,
+  float click_bpm,
+  double clock_ppm)
+  : tone_frequency(tone_frequency)
+  , click_bpm(click_bpm)
+  , actual_sampling_rate(sampling_rate * (1.0 + clock_ppm * 1.0e-6))
+  , start_qpc_position(qpc_now_100ns())
+  , produced_frames(0)
+{
+  format.sampling_rate = sampling_rate;
+  format.num_channels = num_channels;
+  format.bit_per_sample = 32;
+  format.block_align = num_channels * sizeof(float);
+  format.avg_bytes_per_sec = sampling_rate * format.block_align;
+  buffer_frame_count = sampling_rate * buffer_length_millisec / 1000;
+  packet_frame_count = sampling_rate * packet_millisec / 1000;
+  packet.resize(packet_frame_count * num_channels);
+}
+
+capture_format synthetic_capture_backend::get_format()
+{
+  return format;
+}
+
+UINT32 synthetic_capture_backend::get_buffer_frame_count()
+{
+  return buffer_frame_count;
+}
+
+UINT32 synthetic_capture_backend::get_next_packet_size()
+{
+  // WASAPIƓlɁAoߎԕ̃f[^܂pPbgԂ
+  const auto elapsed = qpc_now_100ns() - start_qpc_position;
+  const auto due_frames = static_cast<UINT64>(elapsed * actual_sampling_rate / 10000000);
+  if (due_frames < produced_frames + packet_frame_count) {
+    return 0;
+  }
+  return packet_frame_count;
+}
+
+void synthetic_capture_backend::get_buffer(BYTE** fragment, UINT32* num_frames_available, DWORD* flags, UINT64* device_position, UINT64* qpc_position)
+{
+  const double two_pi = 6.283185307179586;
+  const auto click_interval = static_cast<UINT64>(format.sampling_rate * 60.0 / click_bpm);
+  const auto click_length = static_cast<UINT64>(format.sampling_rate / 1000);
+  for (UINT32 frame = 0; frame < packet_frame_count; ++frame) {
+    const auto position = produced_frames + frame;
+    packet[frame * num_channels] = 0.25f * static_cast<float>(sin(two_pi * tone_frequency * position / format.sampling_rate));
+    packet[frame * num_channels + 1] = (position % click_interval) < click_length ? 0.8f : 0.0f;
+  }
+  *fragment = reinterpret_cast<BYTE*>(packet.data());
+  *num_frames_available = packet_frame_count;
+  *flags = 0;
+  *device_position = produced_frames;
+  *qpc_position = start_qpc_position + static_cast<UINT64>(produced_frames * 10000000 / actual_sampling_rate);
+}
+
+void synthetic_capture_backend::release_buffer(UINT32 num_frames)
+{
+  produced_frames += num_frames;
+}
+
+void synthetic_capture_backend::stop()
+{
+}
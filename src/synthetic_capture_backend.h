@@ -0,0 +1,39 @@
+#pragma once
+#include "capture_backend.h"
+#include <vector>
+
+// foCXœ߂̋^^B
+// ɐgAEɈe|̃NbNԂɍ킹ĐB
+// clock_ppmw肷ƁÃ[g炸ꂽNbÑfoCX͋[B
+class synthetic_capture_backend : public capture_backend
+{
+public:
+  synthetic_capture_backend(
+    int sampling_rate,
+    int buffer_length_millisec,
+    float tone_frequency = 440.0f,
+    float click_bpm = 120.0f,
+    double clock_ppm = 0.0);
+
+  capture_format get_format() override;
+  UINT32 get_buffer_frame_count() override;
+  UINT32 get_next_packet_size() override;
+  void get_buffer(BYTE** fragment, UINT32* num_frames_available, DWORD* flags, UINT64* device_position, UINT64* qpc_position) override;
+  void release_buffer(UINT32 num_frames) override;
+  void stop() override;
+
+private:
+  static const int num_channels = 2;
+  static const int packet_millisec = 10;
+
+  capture_format format;
+  UINT32 buffer_frame_count;
+  UINT32 packet_frame_count;
+  float tone_frequency;
+  float click_bpm;
+  // ۂɃt[𐶐鑬Bformatɂ͌̃[gԂ
+  double actual_sampling_rate;
+  UINT64 start_qpc_position;
+  UINT64 produced_frames;
+  std::vector<float> packet;
+};
@@ -0,0 +1,216 @@
+#include "trace.h"
+#include "metrics.h"
+#include <array>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace
+{
+std::atomic<bool> enabled(false);
+
+namespace
+{
+struct event
+{
+  const char* name;
+  UINT64 begin;
+  UINT64 end;
+};
+
+// Xbh̃Cxgobt@Bނ͎̂̃XbhȂ̂ŃbNsvB
+// tɂȂÂCxg㏑Bcount͎債i߂ÃXbh͏Ȃ
+struct thread_buffer
+{
+  static const size_t capacity = 1 << 16;
+
+  thread_buffer()
+    : thread_id(0)
+    , name(nullptr)
+    , count(0)
+    , cleared(0)
+    , events(capacity)
+  {
+  }
+
+  // 傪܂܂ł0
+  std::atomic<DWORD> thread_id;
+  std::atomic<const char*> name;
+  std::atomic<UINT64> count;
+  // clearcountBÕCxg͏oȂ
+  std::atomic<UINT64> cleared;
+  std::vector<event> events;
+};
+
+// XbhIo悤Aobt@̓vZXI܂ŉȂ
+std::mutex registry_mutex;
+std::vector<std::unique_ptr<thread_buffer>> registry;
+
+// set_thread_nameĂ΂ȂXbh(Unitỹ~LT[XbhȂ)̂߂ɁALɂɊmۂĂ\̃obt@B
+// L^鑤̓bNmۂ1AcĂȂ΃CxĝĂ
+const size_t num_spare_buffers = 4;
+std::array<std::atomic<thread_buffer*>, num_spare_buffers> spare_buffers;
+
+thread_local thread_buffer* local_buffer = nullptr;
+
+// registry_mutexĂĂ
+thread_buffer* add_buffer()
+{
+  registry.push_back(std::make_unique<thread_buffer>());
+  return registry.back().get();
+}
+
+void fill_spare_buffers()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto& spare : spare_buffers) {
+    if (!spare.load(std::memory_order_relaxed)) {
+      spare.store(add_buffer(), std::memory_order_release);
+    }
+  }
+}
+
+thread_buffer* claim_spare_buffer()
+{
+  for (auto& spare : spare_buffers) {
+    if (auto buffer = spare.exchange(nullptr, std::memory_order_acquire)) {
+      buffer->thread_id.store(GetCurrentThreadId(), std::memory_order_relaxed);
+      return buffer;
+    }
+  }
+  return nullptr;
+}
+
+void write_escaped(FILE* file, const char* text)
+{
+  for (; *text; ++text) {
+    if (*text == '"' || *text == '\\') {
+      fputc('\\', file);
+    }
+    fputc(*text, file);
+  }
+}
+
+// buffer̃Cxgresult֎ʂB͎~߂ɋL^𑱂̂ŁA
+// ʂcountǂݒAʂĂԂɏ㏑ꂽ\̂ÂCxĝĂ
+void copy_events(const thread_buffer& buffer, std::vector<event>& result)
+{
+  const auto count = buffer.count.load(std::memory_order_acquire);
+  const auto cleared = buffer.cleared.load(std::memory_order_relaxed);
+  auto oldest = count > thread_buffer::capacity ? count - thread_buffer::capacity : 0;
+  oldest = oldest > cleared ? oldest : cleared;
+  result.clear();
+  for (auto index = oldest; index < count; ++index) {
+    result.push_back(buffer.events[index % thread_buffer::capacity]);
+  }
+
+  // counti߂OɎ̘g(count % capacity)֏̂ŁAǂݒcount̘gƂ݂Ȃ
+  std::atomic_thread_fence(std::memory_order_acquire);
+  const auto latest = buffer.count.load(std::memory_order_relaxed);
+  const auto valid_from = latest + 1 > thread_buffer::capacity ? latest + 1 - thread_buffer::capacity : 0;
+  if (valid_from > oldest) {
+    const size_t overwritten = static_cast<size_t>(valid_from - oldest);
+    result.erase(result.begin(), result.begin() + (overwritten < result.size() ? overwritten : result.size()));
+  }
+}
+}
+
+void set_enabled(bool value)
+{
+  if (value) {
+    fill_spare_buffers();
+  }
+  enabled.store(value, std::memory_order_relaxed);
+}
+
+void set_thread_name(const char* name)
+{
+  if (!local_buffer) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    local_buffer = add_buffer();
+    local_buffer->thread_id.store(GetCurrentThreadId(), std::memory_order_relaxed);
+  }
+  local_buffer->name.store(name, std::memory_order_relaxed);
+}
+
+void record(const char* name, UINT64 begin_microseconds, UINT64 end_microseconds)
+{
+  if (!local_buffer) {
+    local_buffer = claim_spare_buffer();
+    if (!local_buffer) {
+      return;
+    }
+  }
+  const auto index = local_buffer->count.load(std::memory_order_relaxed);
+  // Ocount݂̏g̏㏑ɌBocountǂݒď㏑̘ĝĂ
+  std::atomic_thread_fence(std::memory_order_release);
+  local_buffer->events[index % thread_buffer::capacity] = event{name, begin_microseconds, end_microseconds};
+  local_buffer->count.store(index + 1, std::memory_order_release);
+}
+
+int write_chrome_trace(const std::string& path)
+{
+  FILE* file = nullptr;
+  if (fopen_s(&file, path.c_str(), "w") != 0 || !file) {
+    return -1;
+  }
+
+  const DWORD process_id = GetCurrentProcessId();
+  int num_written = 0;
+  std::vector<event> events;
+  events.reserve(thread_buffer::capacity);
+  fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    bool first = true;
+    for (auto& buffer : registry) {
+      const char* thread_name = buffer->name.load(std::memory_order_relaxed);
+      if (thread_name) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%lu,\"tid\":%lu,\"args\":{\"name\":\"",
+                first ? "" : ",\n", process_id, buffer->thread_id.load(std::memory_order_relaxed));
+        write_escaped(file, thread_name);
+        fprintf(file, "\"}}");
+        first = false;
+      }
+
+      // L^͎~߂ɎʂĂ珑oBt@C֏Ԃɏ㏑Ăʂ͕Ȃ
+      copy_events(*buffer, events);
+      for (const auto& entry : events) {
+        fprintf(file, "%s{\"name\":\"", first ? "" : ",\n");
+        write_escaped(file, entry.name);
+        fprintf(file, "\",\"ph\":\"X\",\"pid\":%lu,\"tid\":%lu,\"ts\":%llu,\"dur\":%llu}",
+                process_id, buffer->thread_id.load(std::memory_order_relaxed), entry.begin, entry.end - entry.begin);
+        first = false;
+        ++num_written;
+      }
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+
+  return num_written;
+}
+
+void clear()
+{
+  // count͎傾i߂̂0ɂ͖߂A܂łoȂt
+  std::lock_guard<std::mutex> lock(registry_mutex);
+  for (auto& buffer : registry) {
+    buffer->cleared.store(buffer->count.load(std::memory_order_acquire), std::memory_order_relaxed);
+  }
+}
+
+scope::scope(const char* name)
+  : name(name)
+  , begin(enabled.load(std::memory_order_relaxed) ? metrics::now_microseconds() : 0)
+{
+}
+
+scope::~scope()
+{
+  if (begin != 0) {
+    record(name, begin, metrics::now_microseconds());
+  }
+}
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <string>
+
+// pCvC̃^CCL^BChromẽg[X`(JSON)ŏoA
+// chrome://tracing  Perfetto UI ŊJB
+// ̃RXg̓XR[vatomic<bool>1ǂނB
+// LOOPBACK_DISABLE_TRACE`TRACE_SCOPEƏB
+namespace trace
+{
+extern std::atomic<bool> enabled;
+
+void set_enabled(bool value);
+// ĂяoXbhɃg[X̖OtAL^p̃obt@mۂBI[fBI̊OŌĂԂ
+void set_thread_name(const char* name);
+// name͕񃊃eȂǁAo܂ŐĂ̂nƁB
+// set_thread_nameĂłȂXbh͗\̃obt@gA΃CxĝĂBmۂ͂Ȃ
+void record(const char* name, UINT64 begin_microseconds, UINT64 end_microseconds);
+// L^ς݂̃Cxgpath֏oAoCxgԂBs-1
+int write_chrome_trace(const std::string& path);
+void clear();
+
+class scope
+{
+public:
+  explicit scope(const char* name);
+  ~scope();
+
+private:
+  const char* name;
+  UINT64 begin;
+};
+}
+
+#ifndef LOOPBACK_DISABLE_TRACE
+#define TRACE_CONCAT_INNER(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_INNER(a, b)
+#define TRACE_SCOPE(name) trace::scope TRACE_CONCAT(trace_scope_, __LINE__)(name)
+#else
+#define TRACE_SCOPE(name)
+#endif
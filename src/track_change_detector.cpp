@@ -0,0 +1,147 @@
+#include "track_change_detector.h"
+#include <cmath>
+
+namespace
+{
+// Sш悪pPbg͖Ƃ݂Ȃ
+const float silence_level = 1.0e-4f;
+// ΐƂOɑp[Bقډш̗hEȂ悤ɂ
+const float power_floor = silence_level * silence_level;
+// ߂̕ςƍ̋Ȃ̕ς̊T`藣ꂽA؂ւ̌Ƃ [dB]
+const float novelty_threshold = 8.0f;
+
+size_t to_packets(int sampling_rate, int packet_size, double seconds)
+{
+  return static_cast<size_t>(seconds * sampling_rate / packet_size + 0.5);
+}
+}
+
+track_change_detector::track_change_detector(int sampling_rate, int packet_size)
+  : short_packets(to_packets(sampling_rate, packet_size, 1.0))
+  , long_packets(to_packets(sampling_rate, packet_size, 20.0))
+  , hold_packets(to_packets(sampling_rate, packet_size, 1.0))
+  , settle_packets(to_packets(sampling_rate, packet_size, 4.0))
+  , gap_packets(to_packets(sampling_rate, packet_size, 2.0))
+  , changes(0)
+{
+  clear();
+}
+
+bool track_change_detector::push(const std::array<float, num_bands>& bands)
+{
+  // ς̓p[łƂBĂAΐɂĂ畽ςT`hȂ
+  std::array<float, num_bands> power;
+  float loudest = 0.0f;
+  for (int band = 0; band < num_bands; ++band) {
+    power[band] = bands[band] * bands[band];
+    loudest = bands[band] > loudest ? bands[band] : loudest;
+  }
+  if (loudest < silence_level) {
+    push_silence(1);
+    return false;
+  }
+
+  const bool gap = has_track && silent_packets >= gap_packets;
+  silent_packets = 0;
+  if (!has_track || gap) {
+    // ŏ̉͐؂ւƂȂ
+    changes += gap ? 1 : 0;
+    restart(power, 1);
+    return gap;
+  }
+
+  ++track_packets;
+  ++settled_packets;
+  for (int band = 0; band < num_bands; ++band) {
+    short_mean[band] += (power[band] - short_mean[band]) / short_packets;
+  }
+  novelty = measure_novelty();
+
+  if (settled_packets >= settle_packets && novelty > novelty_threshold) {
+    // ̊Ԃ͍̋Ȃ̕ς~߁AVȂ֊ĂȂ悤ɂ
+    if (++novel_packets >= hold_packets) {
+      ++changes;
+      // n߂蒼߂̕ς̒OAVȂn܂ĂƂ݂Ȃ
+      restart(short_mean, novel_packets + short_packets);
+      return true;
+    }
+    return false;
+  }
+  novel_packets = 0;
+  // nߒ͒PςőǍ͖20błȂ炷
+  const size_t divisor = settled_packets < long_packets ? settled_packets + 1 : long_packets;
+  for (int band = 0; band < num_bands; ++band) {
+    long_mean[band] += (power[band] - long_mean[band]) / divisor;
+  }
+  return false;
+}
+
+void track_change_detector::push_silence(size_t num_packets)
+{
+  silent_packets += num_packets;
+  if (!has_track) {
+    return;
+  }
+  track_packets += num_packets;
+  settled_packets += num_packets;
+  // ߂̕ς͖܂߂ĂƂBSш悪ŉ邾Ȃ̂ŊT`͕ς炸ÅԂ󂭋ȂłԂ̒
+  const float decay = powf(1.0f - 1.0f / short_packets, static_cast<float>(num_packets));
+  for (auto& value : short_mean) {
+    value *= decay;
+  }
+}
+
+void track_change_detector::clear()
+{
+  short_mean.fill(0.0f);
+  long_mean.fill(0.0f);
+  has_track = false;
+  track_packets = 0;
+  settled_packets = 0;
+  novel_packets = 0;
+  silent_packets = 0;
+  novelty = 0.0f;
+}
+
+unsigned long long track_change_detector::get_changes()
+{
+  return changes;
+}
+
+size_t track_change_detector::get_track_packets()
+{
+  return track_packets;
+}
+
+float track_change_detector::get_novelty()
+{
+  return novelty;
+}
+
+float track_change_detector::measure_novelty()
+{
+  // ш斈̃x[dB]Sш̕ςAʂ̈ႢT`̍̓敽ϕƂ
+  std::array<float, num_bands> difference;
+  float sum = 0.0f;
+  for (int band = 0; band < num_bands; ++band) {
+    difference[band] = 10.0f * log10f((short_mean[band] + power_floor) / (long_mean[band] + power_floor));
+    sum += difference[band];
+  }
+  float square_sum = 0.0f;
+  for (int band = 0; band < num_bands; ++band) {
+    const float centered = difference[band] - sum / num_bands;
+    square_sum += centered * centered;
+  }
+  return sqrtf(square_sum / num_bands);
+}
+
+void track_change_detector::restart(const std::array<float, num_bands>& power, size_t track_packets)
+{
+  short_mean = power;
+  long_mean = power;
+  has_track = true;
+  this->track_packets = track_packets;
+  settled_packets = 0;
+  novel_packets = 0;
+  novelty = 0.0f;
+}
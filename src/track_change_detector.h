@@ -0,0 +1,55 @@
+#pragma once
+#include <array>
+#include <cstddef>
+
+// pPbg̑ш̃xAȂ؂ւB
+// ш斈̃p[̕ςΐɂđSш̕ς`(ʂɈ˂ȂXyNg̊T`)wƂA
+// ߖ1b̎w䂪A̋Ȃ̒ς̎w䂩痣ꂽ܂܈莞ԑ؂ւƂ݂ȂB
+// 2bȏ̖̌ɉ߂؂ւƂ݂Ȃ
+class track_change_detector
+{
+public:
+  static const int num_bands = 8;
+
+  // packet_sizepush֓n1pPbg̃Tv
+  track_change_detector(int sampling_rate, int packet_size);
+
+  // 1pPbg̑ш̐UB̃pPbgŐ؂ւm肵trueԂ
+  bool push(const std::array<float, num_bands>& bands);
+  // num_packets̖i߂
+  void push_silence(size_t num_packets);
+  // ̋ȂYB؂ւ̉񐔂͎c
+  void clear();
+
+  // m肵؂ւ̉
+  unsigned long long get_changes();
+  // ̋Ȃn܂Ɛ肵pPbgB؂ւ̊m͒x̂ŁA̕kĐ
+  size_t get_track_packets();
+  // ߂̎wƍ̋Ȃ̎w̗ [dB]
+  float get_novelty();
+
+private:
+  float measure_novelty();
+  // VȂƂđш̃p[̕ςnߒ
+  void restart(const std::array<float, num_bands>& power, size_t track_packets);
+
+  // 1bA20bA؂ւ̊mɗv鎞ԁA̋ȂƂĔ׎n߂܂ł̎ԁAȊԂƂ݂Ȃ̒ [pPbg]
+  size_t short_packets;
+  size_t long_packets;
+  size_t hold_packets;
+  size_t settle_packets;
+  size_t gap_packets;
+
+  // ш斈̃p[́A߂ƍ̋Ȃ̕
+  std::array<float, num_bands> short_mean;
+  std::array<float, num_bands> long_mean;
+  bool has_track;
+  size_t track_packets;
+  // nߒĂpPbgB؂ւ̓rŎnߒς܂ŁA̐؂ւTȂ
+  size_t settled_packets;
+  // ꂽ܂܂̃pPbgƁAē̃pPbg
+  size_t novel_packets;
+  size_t silent_packets;
+  float novelty;
+  unsigned long long changes;
+};
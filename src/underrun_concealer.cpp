@@ -0,0 +1,131 @@
+#include "underrun_concealer.h"
+#include <algorithm>
+#include <cmath>
+
+underrun_concealer::underrun_concealer()
+  : mode(Mode::Extend)
+{
+  reset();
+}
+
+void underrun_concealer::set_mode(Mode mode)
+{
+  this->mode = mode;
+}
+
+void underrun_concealer::reset()
+{
+  history.fill(0.0f);
+  history_size = 0;
+  concealing = false;
+  extension_position = 0;
+  period = 0;
+}
+
+void underrun_concealer::process(float* buffer, size_t length)
+{
+  // Offł͏]ʂAtF[hɂ̂܂ܖ߂
+  if (concealing && mode != Mode::Off) {
+    // ԉ̑Vf[^փNXtF[h
+    const size_t crossfade_length = length < fade_length ? length : fade_length;
+    for (size_t i = 0; i < crossfade_length; ++i) {
+      const float gain = static_cast<float>(i + 1) / (crossfade_length + 1);
+      buffer[i] = buffer[i] * gain + continuation(extension_position + i) * (1.0f - gain);
+    }
+  }
+  concealing = false;
+  push_history(buffer, length);
+}
+
+size_t underrun_concealer::conceal(float* buffer, size_t length)
+{
+  if (!concealing) {
+    concealing = true;
+    extension_position = 0;
+    if (mode == Mode::Extend) {
+      find_period();
+    }
+  }
+
+  size_t num_concealed = 0;
+  for (size_t i = 0; i < length; ++i) {
+    buffer[i] = continuation(extension_position + i);
+    if (buffer[i] != 0.0f) {
+      ++num_concealed;
+    }
+  }
+  extension_position += length;
+  return num_concealed;
+}
+
+float underrun_concealer::continuation(size_t position)
+{
+  if (mode == Mode::Off || history_size == 0) {
+    return 0.0f;
+  }
+
+  if (mode == Mode::Extend && period != 0) {
+    // łĂŒO̔g`JԂAŌɃtF[hAEg
+    if (position >= max_extension) {
+      return 0.0f;
+    }
+    const float gain = position < max_extension - fade_length ? 1.0f : static_cast<float>(max_extension - position) / fade_length;
+    return history[history_length - period + position % period] * gain;
+  }
+
+  // ܂ԂĘAۂ܂܃tF[hAEg
+  if (position >= fade_length) {
+    return 0.0f;
+  }
+  const size_t mirrored = (std::min)(position, history_size - 1);
+  const float gain = 1.0f - static_cast<float>(position + 1) / (fade_length + 1);
+  return history[history_length - 1 - mirrored] * gain;
+}
+
+void underrun_concealer::find_period()
+{
+  // match_lengthTvƁAlagkԂ̐KւőɂȂlagT
+  period = 0;
+  if (history_size < max_period + match_length) {
+    return;
+  }
+
+  const float* tail = history.data() + history_length - match_length;
+  float tail_energy = 0.0f;
+  for (size_t i = 0; i < match_length; ++i) {
+    tail_energy += tail[i] * tail[i];
+  }
+  if (tail_energy < 1.0e-8f) {
+    return;
+  }
+
+  float best_score = 0.5f;  // 莗ĂȂΉtF[hɂ
+  for (size_t lag = min_period; lag <= max_period; ++lag) {
+    const float* candidate = tail - lag;
+    float correlation = 0.0f;
+    float candidate_energy = 0.0f;
+    for (size_t i = 0; i < match_length; ++i) {
+      correlation += tail[i] * candidate[i];
+      candidate_energy += candidate[i] * candidate[i];
+    }
+    if (candidate_energy < 1.0e-8f) {
+      continue;
+    }
+    const float score = correlation / std::sqrt(tail_energy * candidate_energy);
+    if (score > best_score) {
+      best_score = score;
+      period = lag;
+    }
+  }
+}
+
+void underrun_concealer::push_history(const float* buffer, size_t length)
+{
+  if (length >= history_length) {
+    std::copy(buffer + length - history_length, buffer + length, history.begin());
+  } else {
+    std::copy(history.begin() + length, history.end(), history.begin());
+    std::copy(buffer, buffer + length, history.end() - length);
+  }
+  history_size = history_size + length < history_length ? history_size + length : history_length;
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <array>
+#include <cstddef>
+
+// ^ԂɍȂubN𖄂߁Ar؂ƕA̋ڂ̃NbN}B
+// ǂݏo\[X1(capture_buffer::reader)Ã\[Xget_bufferĂяo炾g
+class underrun_concealer
+{
+public:
+  enum class Mode : int
+  {
+    Off = 0,        // ]ʂ薳ɐ؂ւ
+    Crossfade = 1,  // ڂZtF[h
+    Extend = 2,     // O̔g`IɉĂtF[h(WSOLA)
+  };
+
+  underrun_concealer();
+  void set_mode(Mode mode);
+  void reset();
+  // ɓǂ߂ubNBԒꍇ͕ԉNXtF[hŖ߂BOffł̓NXtF[hȂ
+  void process(float* buffer, size_t length);
+  // ubN𖄂߂B߂l͖ȊOŖ߂Tv
+  size_t conceal(float* buffer, size_t length);
+
+private:
+  float continuation(size_t position);
+  void find_period();
+  void push_history(const float* buffer, size_t length);
+
+  static const size_t history_length = 2048;
+  static const size_t fade_length = 128;
+  static const size_t max_extension = 2048;
+  static const size_t match_length = 256;
+  static const size_t min_period = 32;
+  static const size_t max_period = 1024;
+
+  Mode mode;
+  std::array<float, history_length> history;
+  size_t history_size;
+  bool concealing;
+  size_t extension_position;  // r؂Ă琶Tv
+  size_t period;
+};
@@ -0,0 +1,402 @@
+// beat_analyzer̐xƑx̉Am߂c[BUnityI[fBIfoCXgȂ̂ŁAWindowsȊOłrhłB
+// e|̕ĂNbNƃh[vAe|hȁAAȂ̐؂ւĉ͂A
+// BPM̌덷Äʑ̌덷A܂ł̎ԁA1pPbg̏Ԃ𑪂B
+// ͂AnalyzerƓfeature_graphVU/RMS/e|/̈ʒuƋȂ̐؂ւ̌owǂčsA
+// ؂ւo񐔂ƁAŌ̋Ԃn܂Ă猟o܂ł̎ԂB
+//
+// AnalyzerRegression [--block N] [--max-bpm-error PCT] [--max-phase-ms MS] [--max-lock-seconds S] [--max-ns-per-packet NS] [--strict-octave]
+//                    [--no-track-change] [--csv] [--case NAME]
+//
+// --no-track-change͐؂ւ̌owǂAo񐔂肵ȂBo܂ł̎Ԃǂꂾk߂ׂ鎞ɎgB
+// ؂ւ̃P[X臒l͌oŌ߂Ă̂ŁA--no-track-changeł͂̃P[X͎sB
+//
+// BPM͔{/̎ႦĔׂ(--strict-octaveŋȂ)B
+// 臒l̓P[XɁA̎őlɗ]TČ߂ĂB--max-*tƑSP[X̒lŔ肷B
+// ꂩ̃P[X臒l𒴂ƏIR[h2ŎsB
+//
+// ͎̎̔܂ł̎Ԃ͑(window_size)̐擪琔Ă邽߁A̒̊ԊuŊ؂Ȃe|ł
+// ʑ̌덷傫B臒l͂̒lɂĂ̂ŁA͉邱ƁB
+#include "feature_graph.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace
+{
+const int sampling_rate = 48000;
+const double two_pi = 6.283185307179586;
+
+struct Options
+{
+  int block = 768;
+  // ȂP[X臒lg
+  double max_bpm_error = -1.0;
+  double max_phase_ms = -1.0;
+  double max_lock_seconds = -1.0;
+  double max_ns_per_packet = 60000.0;
+  bool strict_octave = false;
+  bool track_change = true;
+  bool csv = false;
+  std::string only_case;
+};
+
+// e|̋ԁBbpm0Ȃ疳
+struct section
+{
+  double seconds;
+  double start_bpm;
+  double end_bpm;
+  bool drums;
+};
+
+// Ō̋ԂŔ肷臒lBBPM̌덷max_bpm_error [%] ȓɓÂ܂܍Ō܂őuvƂ݂Ȃ
+struct limits
+{
+  double max_bpm_error;
+  double max_lock_seconds;
+  double max_phase_ms;
+};
+
+struct test_case
+{
+  std::string name;
+  std::vector<section> sections;
+  limits limit;
+  // oׂȂ̐؂ւ̉
+  int track_changes;
+};
+
+struct signal
+{
+  std::vector<float> left;
+  std::vector<float> right;
+  // Ō̋Ԃ̊JnƔ̎ [s]
+  double last_section_start = 0.0;
+  std::vector<double> beats;
+  // tł̐e|
+  std::function<double(double)> tempo_at;
+};
+
+class noise_source
+{
+public:
+  float next()
+  {
+    seed = seed * 1103515245 + 12345;
+    return ((seed >> 8) & 0xffff) / 32768.0f - 1.0f;
+  }
+
+private:
+  unsigned int seed = 1;
+};
+
+// ̈ʒuɉuBNbN1kHz̒ZAh̓LbN/XlA/nCnbgƎアpbh
+void render_hit(signal& output, size_t start, bool drums, int beat_in_bar, noise_source& noise)
+{
+  const size_t length = drums ? 9600 : 2400;
+  for (size_t index = 0; index < length && start + index < output.left.size(); ++index) {
+    const double t = static_cast<double>(index) / sampling_rate;
+    float value;
+    if (!drums) {
+      value = static_cast<float>(0.8 * exp(-t * 120.0) * sin(two_pi * 1000.0 * t));
+    } else {
+      // LbN͖AXlA2ڂ4
+      const double pitch = 50.0 + 100.0 * exp(-t * 40.0);
+      value = static_cast<float>(0.7 * exp(-t * 18.0) * sin(two_pi * pitch * t));
+      if (beat_in_bar % 2 == 1) {
+        value += 0.35f * static_cast<float>(exp(-t * 30.0)) * noise.next();
+      }
+    }
+    output.left[start + index] += value;
+    output.right[start + index] += value;
+  }
+}
+
+signal make_signal(const test_case& test)
+{
+  signal output;
+  double total = 0.0;
+  for (const auto& part : test.sections) {
+    total += part.seconds;
+  }
+  const size_t num_frames = static_cast<size_t>(total * sampling_rate);
+  output.left.assign(num_frames, 0.0f);
+  output.right.assign(num_frames, 0.0f);
+
+  noise_source noise;
+  double section_start = 0.0;
+  for (size_t index = 0; index < test.sections.size(); ++index) {
+    const auto& part = test.sections[index];
+    const bool last = index + 1 == test.sections.size();
+    if (last) {
+      output.last_section_start = section_start;
+    }
+    if (part.start_bpm > 0.0) {
+      // e|ϕĔ̎߂
+      double t = 0.0;
+      int beat = 0;
+      while (t < part.seconds) {
+        const double time = section_start + t;
+        if (last) {
+          output.beats.push_back(time);
+        }
+        render_hit(output, static_cast<size_t>(time * sampling_rate), part.drums, beat % 4, noise);
+        // nCnbg8
+        const double bpm = part.start_bpm + (part.end_bpm - part.start_bpm) * t / part.seconds;
+        if (part.drums) {
+          const size_t offbeat = static_cast<size_t>((time + 30.0 / bpm) * sampling_rate);
+          for (size_t frame = 0; frame < 1200 && offbeat + frame < num_frames; ++frame) {
+            const float value = 0.15f * static_cast<float>(exp(-static_cast<double>(frame) / 150.0)) * noise.next();
+            output.left[offbeat + frame] += value;
+            output.right[offbeat + frame] += value;
+          }
+        }
+        t += 60.0 / bpm;
+        ++beat;
+      }
+      if (part.drums) {
+        // Ɩ֌Wɖ葱pbh
+        const size_t begin = static_cast<size_t>(section_start * sampling_rate);
+        const size_t end = (std::min)(static_cast<size_t>((section_start + part.seconds) * sampling_rate), num_frames);
+        for (size_t frame = begin; frame < end; ++frame) {
+          const float value = 0.05f * static_cast<float>(sin(two_pi * 220.0 * frame / sampling_rate) + 0.5 * sin(two_pi * 277.2 * frame / sampling_rate));
+          output.left[frame] += value;
+          output.right[frame] += 0.8f * value;
+        }
+      }
+    }
+    section_start += part.seconds;
+  }
+
+  const auto last_part = test.sections.back();
+  const double last_start = output.last_section_start;
+  output.tempo_at = [last_part, last_start](double time) {
+    const double t = time - last_start;
+    return last_part.start_bpm + (last_part.end_bpm - last_part.start_bpm) * t / last_part.seconds;
+  };
+  return output;
+}
+
+struct result
+{
+  double bpm = 0.0;
+  double bpm_error = 0.0;
+  double octave = 1.0;
+  double lock_seconds = -1.0;
+  double phase_ms = 0.0;
+  double ns_per_packet = 0.0;
+  unsigned long long track_changes = 0;
+  // Ō̋Ԃn܂Ăŏɐ؂ւo܂ [s]BoȂ-1
+  double detect_seconds = -1.0;
+  bool silent_ok = true;
+  bool passed = true;
+  std::string reason;
+};
+
+// BPM̌덷 [%]B{/̎ႦȂAԋ߂̂Ɣׂ
+double bpm_error(double bpm, double truth, bool strict_octave, double& octave)
+{
+  octave = 1.0;
+  double best = fabs(bpm - truth) / truth * 100.0;
+  if (!strict_octave) {
+    for (double factor : {0.5, 2.0}) {
+      const double error = fabs(bpm * factor - truth) / truth * 100.0;
+      if (error < best) {
+        best = error;
+        octave = factor;
+      }
+    }
+  }
+  return best;
+}
+
+// \̎ƁAԋ߂Ƃ̍ [ms]
+double phase_error_ms(double predicted, const std::vector<double>& beats)
+{
+  auto found = std::lower_bound(beats.begin(), beats.end(), predicted);
+  double best = 1.0e9;
+  if (found != beats.end()) {
+    best = *found - predicted;
+  }
+  if (found != beats.begin()) {
+    best = (std::min)(best, predicted - *(found - 1));
+  }
+  return best * 1000.0;
+}
+
+result run_case(const test_case& test, const Options& options)
+{
+  const signal input = make_signal(test);
+  const double max_bpm_error = options.max_bpm_error >= 0.0 ? options.max_bpm_error : test.limit.max_bpm_error;
+  const double max_lock_seconds = options.max_lock_seconds >= 0.0 ? options.max_lock_seconds : test.limit.max_lock_seconds;
+  const double max_phase_ms = options.max_phase_ms >= 0.0 ? options.max_phase_ms : test.limit.max_phase_ms;
+  const bool silent = test.sections.back().start_bpm <= 0.0;
+  feature_graph graph(sampling_rate);
+  for (auto feature : { Feature::Vu, Feature::Rms, Feature::Tempo, Feature::BeatPhase }) {
+    graph.subscribe(feature);
+  }
+  if (options.track_change) {
+    graph.subscribe(Feature::TrackChange);
+  }
+  auto& analysis = graph.get_beat();
+  std::vector<float> left(options.block);
+  std::vector<float> right(options.block);
+
+  result output;
+  double locked_since = -1.0;
+  double phase_total = 0.0;
+  size_t phase_count = 0;
+  double elapsed_ns = 0.0;
+  size_t num_packets = 0;
+  for (size_t start = 0; start + options.block <= input.left.size(); start += options.block) {
+    std::copy(input.left.begin() + start, input.left.begin() + start + options.block, left.begin());
+    std::copy(input.right.begin() + start, input.right.begin() + start + options.block, right.begin());
+    const auto begin = std::chrono::steady_clock::now();
+    graph.process(left, right);
+    elapsed_ns += std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - begin).count();
+    num_packets += options.block / beat_analyzer::packet_size;
+
+    const double now = static_cast<double>(start + options.block) / sampling_rate;
+    if (now < input.last_section_start) {
+      continue;
+    }
+    if (graph.is_track_changed() && output.detect_seconds < 0.0) {
+      output.detect_seconds = now - input.last_section_start;
+    }
+    if (silent) {
+      // ł͔̌₪SďĂ邱
+      continue;
+    }
+    double octave;
+    const double error = bpm_error(analysis.get_bpm(), input.tempo_at(now), options.strict_octave, octave);
+    if (error <= max_bpm_error) {
+      if (locked_since < 0.0) {
+        locked_since = now;
+        phase_total = 0.0;
+        phase_count = 0;
+      }
+      phase_total += phase_error_ms(now + analysis.get_milliseconds_to_next_beat() / 1000.0, input.beats);
+      ++phase_count;
+    } else {
+      locked_since = -1.0;
+    }
+  }
+
+  output.bpm = analysis.get_bpm();
+  output.ns_per_packet = num_packets > 0 ? elapsed_ns / num_packets : 0.0;
+  output.track_changes = graph.get_track_changes();
+  if (silent) {
+    for (int index = 0; index <= beat_analyzer::max_interval - beat_analyzer::min_interval; ++index) {
+      output.silent_ok = output.silent_ok && analysis.get_bpm_score(index) == 0.0f;
+    }
+    output.silent_ok = output.silent_ok && analysis.get_rms(beat_analyzer::window_size - 1) == 0.0f;
+    if (!output.silent_ok) {
+      output.passed = false;
+      output.reason = "scores not cleared on silence";
+    }
+  } else {
+    const double end = static_cast<double>(input.left.size()) / sampling_rate;
+    output.bpm_error = bpm_error(output.bpm, input.tempo_at(end), options.strict_octave, output.octave);
+    output.lock_seconds = locked_since >= 0.0 ? locked_since - input.last_section_start : -1.0;
+    output.phase_ms = phase_count > 0 ? phase_total / phase_count : 0.0;
+    if (locked_since < 0.0) {
+      output.passed = false;
+      output.reason = "never locked";
+    } else if (output.lock_seconds > max_lock_seconds) {
+      output.passed = false;
+      output.reason = "slow lock";
+    } else if (output.phase_ms > max_phase_ms) {
+      output.passed = false;
+      output.reason = "phase error";
+    }
+  }
+  if (output.passed && options.track_change && output.track_changes != static_cast<unsigned long long>(test.track_changes)) {
+    output.passed = false;
+    output.reason = output.track_changes > static_cast<unsigned long long>(test.track_changes) ? "false track change" : "missed track change";
+  }
+  if (output.passed && options.max_ns_per_packet > 0.0 && output.ns_per_packet > options.max_ns_per_packet) {
+    output.passed = false;
+    output.reason = "too slow";
+  }
+  return output;
+}
+
+std::vector<test_case> make_cases()
+{
+  // 臒l--block 768őlɗ]T
+  return {
+    {"click_90", {{30.0, 90.0, 90.0, false}}, {3.0, 3.0, 30.0}, 0},
+    {"click_120", {{30.0, 120.0, 120.0, false}}, {3.0, 3.0, 200.0}, 0},
+    {"click_150", {{30.0, 150.0, 150.0, false}}, {3.0, 3.0, 160.0}, 0},
+    {"drums_100", {{30.0, 100.0, 100.0, true}}, {3.0, 4.0, 130.0}, 0},
+    {"drums_128", {{30.0, 128.0, 128.0, true}}, {3.0, 6.0, 140.0}, 0},
+    {"drums_174", {{30.0, 174.0, 174.0, true}}, {3.0, 4.0, 60.0}, 0},
+    {"drift_110_130", {{60.0, 110.0, 130.0, true}}, {3.0, 50.0, 170.0}, 0},
+    {"silence", {{20.0, 0.0, 0.0, false}}, {0.0, 0.0, 0.0}, 0},
+    {"music_then_silence", {{20.0, 120.0, 120.0, true}, {20.0, 0.0, 0.0, false}}, {0.0, 0.0, 0.0}, 0},
+    // ؂ւođŐȂ̂̕Ă̂ŁAŐȂVU甲̂҂葁
+    {"change_96_140", {{30.0, 96.0, 96.0, true}, {5.0, 0.0, 0.0, false}, {30.0, 140.0, 140.0, true}}, {3.0, 5.0, 40.0}, 1},
+    {"switch_click_90_drums_140", {{30.0, 90.0, 90.0, false}, {30.0, 140.0, 140.0, true}}, {3.0, 4.0, 40.0}, 1},
+  };
+}
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() { return (i + 1 < argc) ? argv[++i] : "0"; };
+    if (arg == "--block") {
+      options.block = atoi(next());
+    } else if (arg == "--max-bpm-error") {
+      options.max_bpm_error = atof(next());
+    } else if (arg == "--max-phase-ms") {
+      options.max_phase_ms = atof(next());
+    } else if (arg == "--max-lock-seconds") {
+      options.max_lock_seconds = atof(next());
+    } else if (arg == "--max-ns-per-packet") {
+      options.max_ns_per_packet = atof(next());
+    } else if (arg == "--strict-octave") {
+      options.strict_octave = true;
+    } else if (arg == "--no-track-change") {
+      options.track_change = false;
+    } else if (arg == "--csv") {
+      options.csv = true;
+    } else if (arg == "--case") {
+      options.only_case = next();
+    }
+  }
+  if (options.block <= 0 || options.block % beat_analyzer::packet_size != 0) {
+    fprintf(stderr, "Block must be a positive multiple of %d.\n", beat_analyzer::packet_size);
+    return 1;
+  }
+
+  if (options.csv) {
+    printf("case,bpm,bpm_error_pct,octave,lock_s,phase_ms,ns_per_packet,track_changes,detect_s,result\n");
+  } else {
+    printf("%-26s %8s %8s %6s %8s %9s %12s %7s %8s  %s\n", "case", "bpm", "err%", "oct", "lock_s", "phase_ms", "ns/packet", "changes", "detect_s", "result");
+  }
+  int failures = 0;
+  for (const auto& test : make_cases()) {
+    if (!options.only_case.empty() && test.name != options.only_case) {
+      continue;
+    }
+    const auto outcome = run_case(test, options);
+    failures += outcome.passed ? 0 : 1;
+    const std::string verdict = outcome.passed ? "ok" : "FAIL (" + outcome.reason + ")";
+    if (options.csv) {
+      printf("%s,%.3f,%.3f,%.1f,%.3f,%.2f,%.0f,%llu,%.3f,%s\n", test.name.c_str(), outcome.bpm, outcome.bpm_error, outcome.octave, outcome.lock_seconds,
+             outcome.phase_ms, outcome.ns_per_packet, outcome.track_changes, outcome.detect_seconds, outcome.passed ? "ok" : outcome.reason.c_str());
+    } else {
+      printf("%-26s %8.2f %8.2f %6.1f %8.2f %9.2f %12.0f %7llu %8.2f  %s\n", test.name.c_str(), outcome.bpm, outcome.bpm_error, outcome.octave, outcome.lock_seconds,
+             outcome.phase_ms, outcome.ns_per_packet, outcome.track_changes, outcome.detect_seconds, verdict.c_str());
+    }
+  }
+  return failures > 0 ? 2 : 0;
+}
@@ -0,0 +1,540 @@
+// ^܂ł̊eiʂɑ}CNx`}[NB
+//
+// iƂɁAOւ݂̏ƓǂݏoAC^[[u̕ATvAcatch_upA
+// get_bufferC^[[uo͂ւ̋lߑւAget_analyzer_dataAubNςČJԂB
+// ʂ1Tv̎(lp99)ŁALinuxłperf_eventŃLbV~Xƕ\~XB
+// WindowsłMFT̃Tv([gϊƃtH[}bgϊ)B
+//
+// CapturePathBench [--stage NAME] [--min-time S] [--csv | --json]
+//
+// --json--csv͐ڂǂ߂̋@BǂȏóBJE^Ȃł͋(JSONłnull)ɂȂB
+// Linuxł͎̂悤Ƀrhł(perf_eventgɂkernel.perf_event_paranoid2ȉł邱)B
+//   g++ -O2 -std=c++14 -Isrc tools/capture_path_bench/main.cpp src/ring_buffer.cpp src/halfband_resampler.cpp
+// capture_bufferʂi(capture_pushAget_bufferAcatch_upAget_analyzer_data)Windowŝ݁B
+#include "ring_buffer.h"
+#include "halfband_resampler.h"
+#ifdef _WIN32
+#include "capture_buffer.h"
+#include "MFT_resampler.h"
+#include <windows.h>
+#include <mmreg.h>
+#endif
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include <vector>
+#include <array>
+#include <chrono>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <stdexcept>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+
+namespace
+{
+// AudioDevice::max_buffer_sizeƓ
+const size_t ring_capacity = 1024 * 10;
+const size_t num_channels = 2;
+const size_t block_sizes[] = { 64, 256, 480, 1024, 4096 };
+
+struct Options
+{
+  std::string stage;
+  double min_time = 0.2;
+  bool csv = false;
+  bool json = false;
+};
+
+// [UԂ̃LbV~Xƕ\~XBJȂłavailable()falseɂȂ
+class hardware_counters
+{
+public:
+  hardware_counters()
+    : leader(-1)
+    , member(-1)
+  {
+#ifdef __linux__
+    leader = open_counter(PERF_COUNT_HW_CACHE_MISSES, -1);
+    if (leader >= 0) {
+      member = open_counter(PERF_COUNT_HW_BRANCH_MISSES, leader);
+    }
+    if (member < 0 && leader >= 0) {
+      close(leader);
+      leader = -1;
+    }
+#endif
+  }
+
+  ~hardware_counters()
+  {
+#ifdef __linux__
+    if (member >= 0) {
+      close(member);
+    }
+    if (leader >= 0) {
+      close(leader);
+    }
+#endif
+  }
+
+  bool available()
+  {
+    return leader >= 0;
+  }
+
+  void start()
+  {
+#ifdef __linux__
+    if (leader >= 0) {
+      ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+  }
+
+  // Ostart()̉
+  void stop(uint64_t* cache_misses, uint64_t* branch_misses)
+  {
+    *cache_misses = 0;
+    *branch_misses = 0;
+#ifdef __linux__
+    if (leader >= 0) {
+      ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+      // PERF_FORMAT_GROUP: AeJE^̒l
+      uint64_t values[3] = {};
+      if (read(leader, values, sizeof(values)) == sizeof(values)) {
+        *cache_misses = values[1];
+        *branch_misses = values[2];
+      }
+    }
+#endif
+  }
+
+private:
+#ifdef __linux__
+  static int open_counter(uint64_t config, int group)
+  {
+    perf_event_attr attribute = {};
+    attribute.size = sizeof(attribute);
+    attribute.type = PERF_TYPE_HARDWARE;
+    attribute.config = config;
+    attribute.disabled = group < 0 ? 1 : 0;
+    attribute.exclude_kernel = 1;
+    attribute.exclude_hv = 1;
+    attribute.read_format = PERF_FORMAT_GROUP;
+    return static_cast<int>(syscall(__NR_perf_event_open, &attribute, 0, -1, group, 0));
+  }
+#endif
+
+  int leader;
+  int member;
+};
+
+struct Result
+{
+  std::string stage;
+  size_t block;
+  size_t batches;
+  double ns_per_sample_median;
+  double ns_per_sample_p99;
+  double ns_per_call;
+  bool counters;
+  double cache_misses_per_ksample;
+  double branch_misses_per_ksample;
+};
+
+// 1̌vPʁBprepare͌vȌArun͌v鏈ŁATvƌĂяo񐔂Ԃ
+struct Batch
+{
+  std::function<void()> prepare;
+  std::function<void(size_t* samples, size_t* calls)> run;
+};
+
+class runner
+{
+public:
+  explicit runner(const Options& options)
+    : options(options)
+  {
+  }
+
+  bool counters_available()
+  {
+    return counters.available();
+  }
+
+  void measure(const std::string& stage, size_t block, const Batch& batch)
+  {
+    if (!options.stage.empty() && options.stage != stage) {
+      return;
+    }
+    // 1ڂ̓LbVƕ\߂邽߂Ɏ̂Ă
+    size_t samples = 0;
+    size_t calls = 0;
+    batch.prepare();
+    batch.run(&samples, &calls);
+
+    std::vector<double> ns_per_sample;
+    double total_ns = 0.0;
+    size_t total_samples = 0;
+    size_t total_calls = 0;
+    uint64_t total_cache_misses = 0;
+    uint64_t total_branch_misses = 0;
+    while (total_ns < options.min_time * 1.0e9 || ns_per_sample.size() < 10) {
+      batch.prepare();
+      uint64_t cache_misses;
+      uint64_t branch_misses;
+      counters.start();
+      const auto begin = std::chrono::steady_clock::now();
+      batch.run(&samples, &calls);
+      const auto end = std::chrono::steady_clock::now();
+      counters.stop(&cache_misses, &branch_misses);
+
+      const double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+      ns_per_sample.push_back(ns / samples);
+      total_ns += ns;
+      total_samples += samples;
+      total_calls += calls;
+      total_cache_misses += cache_misses;
+      total_branch_misses += branch_misses;
+    }
+    std::sort(ns_per_sample.begin(), ns_per_sample.end());
+
+    Result result;
+    result.stage = stage;
+    result.block = block;
+    result.batches = ns_per_sample.size();
+    result.ns_per_sample_median = ns_per_sample[ns_per_sample.size() / 2];
+    result.ns_per_sample_p99 = ns_per_sample[ns_per_sample.size() * 99 / 100];
+    result.ns_per_call = total_ns / total_calls;
+    result.counters = counters.available();
+    result.cache_misses_per_ksample = total_cache_misses * 1000.0 / total_samples;
+    result.branch_misses_per_ksample = total_branch_misses * 1000.0 / total_samples;
+    print(result);
+  }
+
+  void print_header()
+  {
+    if (options.csv) {
+      printf("stage,block,batches,ns_per_sample_median,ns_per_sample_p99,ns_per_call,cache_misses_per_ksample,branch_misses_per_ksample\n");
+    } else if (options.json) {
+      printf("{\"counters\":%s,\"results\":[", counters.available() ? "true" : "false");
+    } else {
+      printf("%-22s %6s %8s %12s %12s %12s %14s %14s\n", "stage", "block", "batches", "ns/sample", "p99", "ns/call", "cache-miss/k", "branch-miss/k");
+    }
+  }
+
+  void print_footer()
+  {
+    if (options.json) {
+      printf("]}\n");
+    } else if (!options.csv && !counters.available()) {
+      printf("Hardware counters are not available on this system.\n");
+    }
+  }
+
+private:
+  void print(const Result& result)
+  {
+    char cache[32] = "";
+    char branch[32] = "";
+    if (result.counters) {
+      snprintf(cache, sizeof(cache), "%.3f", result.cache_misses_per_ksample);
+      snprintf(branch, sizeof(branch), "%.3f", result.branch_misses_per_ksample);
+    }
+    if (options.csv) {
+      printf("%s,%zu,%zu,%.4f,%.4f,%.1f,%s,%s\n", result.stage.c_str(), result.block, result.batches,
+             result.ns_per_sample_median, result.ns_per_sample_p99, result.ns_per_call, cache, branch);
+    } else if (options.json) {
+      printf("%s{\"stage\":\"%s\",\"block\":%zu,\"batches\":%zu,\"ns_per_sample_median\":%.4f,\"ns_per_sample_p99\":%.4f,\"ns_per_call\":%.1f,"
+             "\"cache_misses_per_ksample\":%s,\"branch_misses_per_ksample\":%s}",
+             printed > 0 ? "," : "", result.stage.c_str(), result.block, result.batches,
+             result.ns_per_sample_median, result.ns_per_sample_p99, result.ns_per_call,
+             result.counters ? cache : "null", result.counters ? branch : "null");
+    } else {
+      printf("%-22s %6zu %8zu %12.4f %12.4f %12.1f %14s %14s\n", result.stage.c_str(), result.block, result.batches,
+             result.ns_per_sample_median, result.ns_per_sample_p99, result.ns_per_call,
+             result.counters ? cache : "-", result.counters ? branch : "-");
+    }
+    ++printed;
+    fflush(stdout);
+  }
+
+  Options options;
+  hardware_counters counters;
+  size_t printed = 0;
+};
+
+void fill_signal(std::vector<float>& buffer, size_t stride, float frequency)
+{
+  for (size_t i = 0; i < buffer.size(); ++i) {
+    buffer[i] = 0.5f * static_cast<float>(sin(6.283185307 * frequency * (i / stride) / 48000.0));
+  }
+}
+
+// 1ob`ŃO̔܂ŏAʂǂݏo
+size_t calls_per_batch(size_t block)
+{
+  const size_t calls = ring_capacity / 2 / block;
+  return calls > 0 ? calls : 1;
+}
+
+void bench_ring(runner& bench)
+{
+  for (auto block : block_sizes) {
+    ring_buffer ring(ring_capacity);
+    std::vector<float> input(block);
+    std::vector<float> output(block);
+    fill_signal(input, 1, 440.0f);
+    const size_t calls = calls_per_batch(block);
+
+    bench.measure("ring_push", block, Batch{
+      [&]() { ring.pop_back(ring.size()); },
+      [&](size_t* samples, size_t* count) {
+        for (size_t i = 0; i < calls; ++i) {
+          ring.push_front(segment{input.data(), block});
+        }
+        *samples = calls * block;
+        *count = calls;
+      }});
+
+    bench.measure("ring_pop", block, Batch{
+      [&]() {
+        ring.pop_back(ring.size());
+        for (size_t i = 0; i < calls; ++i) {
+          ring.push_front(segment{input.data(), block});
+        }
+      },
+      [&](size_t* samples, size_t* count) {
+        for (size_t i = 0; i < calls; ++i) {
+          ring.pop_back_to(output.data(), block);
+        }
+        *samples = calls * block;
+        *count = calls;
+      }});
+  }
+}
+
+void bench_deinterleave(runner& bench)
+{
+  for (auto block : block_sizes) {
+    std::vector<float> interleaved(block * num_channels);
+    fill_signal(interleaved, num_channels, 440.0f);
+    std::array<std::vector<float>, num_channels> deinterleave_buffer;
+    for (auto& channel : deinterleave_buffer) {
+      channel.reserve(block);
+    }
+
+    // AudioDevice::runŃTv̏o͂`lɕ镔Ɠ
+    bench.measure("deinterleave", block, Batch{
+      []() {},
+      [&](size_t* samples, size_t* count) {
+        for (size_t channel = 0; channel < num_channels; ++channel) {
+          deinterleave_buffer[channel].resize(block);
+          for (size_t frame = 0; frame < block; ++frame) {
+            deinterleave_buffer[channel][frame] = interleaved[frame * num_channels + channel];
+          }
+        }
+        *samples = block * num_channels;
+        *count = 1;
+      }});
+  }
+}
+
+void bench_halfband(runner& bench)
+{
+  // Spatializer[gœ̊ԈƕԁBUnitỹobt@ő
+  const size_t length = 1024;
+  for (int factor = 2; factor <= 4; factor *= 2) {
+    halfband_resampler resampler(factor, static_cast<int>(num_channels), length);
+    std::vector<float> input(length * num_channels);
+    std::vector<float> output(length * num_channels);
+    fill_signal(input, num_channels, 440.0f);
+
+    bench.measure("halfband_x" + std::to_string(factor), length, Batch{
+      []() {},
+      [&](size_t* samples, size_t* count) {
+        const float* low_rate_input = resampler.decimate(input.data(), static_cast<unsigned int>(length));
+        std::copy(low_rate_input, low_rate_input + length / factor * num_channels, resampler.get_low_rate_output());
+        resampler.interpolate(output.data(), static_cast<unsigned int>(length));
+        *samples = length * num_channels;
+        *count = 1;
+      }});
+  }
+}
+
+#ifdef _WIN32
+void bench_mft(runner& bench)
+{
+  // ̓[gWASAPI̋L[hő́B10ms̃pPbg101ob`
+  const int rates[][2] = { { 48000, 48000 }, { 44100, 48000 }, { 48000, 44100 }, { 96000, 48000 }, { 48000, 96000 } };
+  for (auto& rate : rates) {
+    const int block_align = static_cast<int>(sizeof(float) * num_channels);
+    MFT_resampler resampler(block_align, SPEAKER_FRONT_LEFT | SPEAKER_FRONT_RIGHT, rate[0] * block_align, rate[0], rate[1]);
+    const size_t packet = rate[0] / 100;
+    std::vector<float> input(packet * num_channels);
+    fill_signal(input, num_channels, 440.0f);
+    std::vector<BYTE> output;
+    output.reserve(packet * 4 * block_align);
+
+    bench.measure("mft_" + std::to_string(rate[0]) + "_" + std::to_string(rate[1]), packet, Batch{
+      []() {},
+      [&](size_t* samples, size_t* count) {
+        for (size_t i = 0; i < 10; ++i) {
+          resampler.write_buffer(reinterpret_cast<BYTE*>(input.data()), static_cast<DWORD>(input.size() * sizeof(float)));
+          output.clear();
+          resampler.read_buffer(output);
+        }
+        *samples = 10 * packet * num_channels;
+        *count = 10;
+      }});
+  }
+}
+
+// AudioDeviceƓcapture_bufferA^XbhƃI[fBIXbhAnalyzeȓɒڌĂ
+void bench_consumer(runner& bench)
+{
+  capture_buffer path(ring_capacity);
+  capture_buffer::reader source;
+  path.start(48000, num_channels);
+  // ҋ@ɍŏget_bufferĐɂ
+  path.set_target_buffer_size(0);
+  const size_t analyzer_alignment = 256;
+  const auto clear = [&]() {
+    path.reset_buffer();
+    path.reset_analyzer_data();
+  };
+  for (auto block : block_sizes) {
+    std::array<std::vector<float>, num_channels> packet;
+    for (auto& channel : packet) {
+      channel.resize(block);
+      fill_signal(channel, 1, 440.0f);
+    }
+    std::vector<float> recorded(block);
+    std::vector<float> interleaved(block * num_channels);
+    std::array<std::vector<float>, capture_buffer::max_channels> analyzer_result;
+    for (auto& channel : analyzer_result) {
+      channel.reserve(ring_capacity);
+    }
+    const size_t calls = calls_per_batch(block);
+
+    // ^Xbh̏(̃O)
+    bench.measure("capture_push", block, Batch{
+      clear,
+      [&](size_t* samples, size_t* count) {
+        for (size_t i = 0; i < calls; ++i) {
+          path.push(packet.data(), num_channels, false);
+        }
+        *samples = calls * block * num_channels;
+        *count = calls;
+      }});
+
+    // get_bufferSpatializer̓͂֋lߑւ܂(spatializer_plugin.cppƓ[v)
+    bench.measure("get_buffer", block, Batch{
+      [&]() {
+        clear();
+        for (size_t i = 0; i < calls; ++i) {
+          path.push(packet.data(), num_channels, false);
+        }
+      },
+      [&](size_t* samples, size_t* count) {
+        const unsigned int outchannels = static_cast<unsigned int>(num_channels);
+        for (size_t i = 0; i < calls; ++i) {
+          path.get_buffer(0, source, recorded.data(), block);
+          for (unsigned int j = 0; j < block * outchannels; j += outchannels) {
+            interleaved[j] = recorded[j / outchannels];
+            interleaved[j + 1] = 0.0f;
+          }
+        }
+        *samples = calls * block;
+        *count = calls;
+      }});
+
+    // ^Ԃɍ킸O̔g`Ŗ߂oH
+    bench.measure("get_buffer_underrun", block, Batch{
+      clear,
+      [&](size_t* samples, size_t* count) {
+        for (size_t i = 0; i < calls; ++i) {
+          path.get_buffer(0, source, recorded.data(), block);
+        }
+        *samples = calls * block;
+        *count = calls;
+      }});
+
+    // Е̃`lblockił𑵂̂B`l0ɓǂł炵Ă
+    bench.measure("catch_up", block, Batch{
+      [&]() {
+        clear();
+        path.push(packet.data(), num_channels, false);
+        path.push(packet.data(), num_channels, false);
+        path.get_buffer(0, source, recorded.data(), block);
+      },
+      [&](size_t* samples, size_t* count) {
+        path.catch_up(1);
+        *samples = block;
+        *count = 1;
+      }});
+
+    // Analyzer::updateƓA܂pPbgɑĂ܂Ƃ߂Ďo
+    bench.measure("get_analyzer_data", block, Batch{
+      [&]() {
+        clear();
+        for (size_t i = 0; i < calls; ++i) {
+          path.push(packet.data(), num_channels, false);
+        }
+      },
+      [&](size_t* samples, size_t* count) {
+        *samples = path.get_analyzer_data(analyzer_alignment, analyzer_result) * num_channels;
+        *count = 1;
+      }});
+  }
+}
+#endif
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--stage" && i + 1 < argc) {
+      options.stage = argv[++i];
+    } else if (arg == "--min-time" && i + 1 < argc) {
+      options.min_time = atof(argv[++i]);
+    } else if (arg == "--csv") {
+      options.csv = true;
+    } else if (arg == "--json") {
+      options.json = true;
+    }
+  }
+
+#ifdef _WIN32
+  // MFT̍쐬COMv
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+  runner bench(options);
+  bench.print_header();
+  bench_ring(bench);
+  bench_deinterleave(bench);
+  bench_halfband(bench);
+#ifdef _WIN32
+  try {
+    bench_mft(bench);
+  } catch (const std::exception& error) {
+    fprintf(stderr, "%s\n", error.what());
+  }
+  bench_consumer(bench);
+#endif
+  bench.print_footer();
+#ifdef _WIN32
+  CoUninitialize();
+#endif
+  return 0;
+}
@@ -0,0 +1,298 @@
+// ȏo͏(echo_canceller)̎̑ƏԂAvOCőc[B
+//
+// ł́AQƐMxƒZoHŘc߂̂ɑ̃Av̉𑫂^^gB
+// ^ς݂̃t@Cőꍇ́AStartRecordingŏo^ƁAԂ̃Q[o͂nB
+// x͎Ő肷̂ŁA2̃t@C̐擪͑ĂȂĂ悢(0.3bx܂)B
+//
+// EchoCancellerBench [--seconds S] [--delay D] [--near-gain G] [--packet N] [--capture capture.wav --reference reference.wav] [--min-erle X] [--csv]
+//
+// 1bɐxƏ(ERLE)\B^^ł͎cGR[狁߂^̏ʂoB
+// --min-erletƁAŌ1b̏ʂX dBȂIR[h2ŎsB
+#include "echo_canceller.h"
+#include <windows.h>
+#include <vector>
+#include <chrono>
+#include <algorithm>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace std::chrono;
+
+namespace
+{
+struct Options
+{
+  double seconds = 30.0;
+  int delay = 3000;
+  float near_gain = 0.03f;
+  size_t packet = 480;
+  std::string capture_path;
+  std::string reference_path;
+  double min_erle = -1000.0;
+  bool csv = false;
+};
+
+// 2`l܂łWAVB`lɕĎ
+struct Wave
+{
+  int sampling_rate = 0;
+  std::vector<float> channels[2];
+};
+
+bool read_wave(const std::string& path, Wave& wave)
+{
+  FILE* file = fopen(path.c_str(), "rb");
+  if (!file) {
+    return false;
+  }
+  std::vector<char> bytes;
+  char chunk[4096];
+  size_t read;
+  while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+    bytes.insert(bytes.end(), chunk, chunk + read);
+  }
+  fclose(file);
+  if (bytes.size() < 12 || memcmp(bytes.data(), "RIFF", 4) != 0 || memcmp(bytes.data() + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+
+  int format = 0;
+  int num_channels = 0;
+  int bits = 0;
+  size_t offset = 12;
+  while (offset + 8 <= bytes.size()) {
+    UINT32 size;
+    memcpy(&size, bytes.data() + offset + 4, sizeof(size));
+    const char* body = bytes.data() + offset + 8;
+    if (offset + 8 + size > bytes.size()) {
+      size = static_cast<UINT32>(bytes.size() - offset - 8);
+    }
+    if (memcmp(bytes.data() + offset, "fmt ", 4) == 0 && size >= 16) {
+      UINT16 value;
+      memcpy(&value, body, sizeof(value));
+      format = value;
+      memcpy(&value, body + 2, sizeof(value));
+      num_channels = value;
+      UINT32 rate;
+      memcpy(&rate, body + 4, sizeof(rate));
+      wave.sampling_rate = static_cast<int>(rate);
+      memcpy(&value, body + 14, sizeof(value));
+      bits = value;
+      if (format == 0xFFFE && size >= 26) {
+        // WAVE_FORMAT_EXTENSIBLE̓TutH[}bg̐擪2oCg`
+        memcpy(&value, body + 24, sizeof(value));
+        format = value;
+      }
+    } else if (memcmp(bytes.data() + offset, "data", 4) == 0 && num_channels > 0) {
+      const bool is_float = format == 3 && bits == 32;
+      const bool is_pcm16 = format == 1 && bits == 16;
+      if (!is_float && !is_pcm16) {
+        return false;
+      }
+      const size_t frame_bytes = num_channels * bits / 8;
+      const size_t num_frames = size / frame_bytes;
+      for (size_t channel = 0; channel < 2; ++channel) {
+        wave.channels[channel].resize(num_frames);
+      }
+      for (size_t frame = 0; frame < num_frames; ++frame) {
+        for (size_t channel = 0; channel < 2; ++channel) {
+          const size_t source = (channel < static_cast<size_t>(num_channels) ? channel : 0);
+          const char* sample = body + frame * frame_bytes + source * bits / 8;
+          if (is_float) {
+            memcpy(&wave.channels[channel][frame], sample, sizeof(float));
+          } else {
+            INT16 value;
+            memcpy(&value, sample, sizeof(value));
+            wave.channels[channel][frame] = value / 32768.0f;
+          }
+        }
+      }
+      return true;
+    }
+    offset += 8 + size + (size & 1);
+  }
+  return false;
+}
+
+// ^^BQƂ͉ŷ悤ɉʂhFtGÃAv̉͐gƎG
+void make_synthetic(const Options& options, Wave& reference, Wave& capture, Wave& echo)
+{
+  const int rate = 48000;
+  const size_t num_frames = static_cast<size_t>(options.seconds * rate);
+  reference.sampling_rate = capture.sampling_rate = echo.sampling_rate = rate;
+  for (size_t channel = 0; channel < 2; ++channel) {
+    reference.channels[channel].assign(num_frames, 0.0f);
+    capture.channels[channel].assign(num_frames, 0.0f);
+    echo.channels[channel].assign(num_frames, 0.0f);
+  }
+  unsigned int seed = 1;
+  auto noise = [&]() {
+    seed = seed * 1103515245 + 12345;
+    return ((seed >> 8) & 0xffff) / 32768.0f - 1.0f;
+  };
+  const double two_pi = 6.283185307179586;
+  float lowpass = 0.0f;
+  for (size_t frame = 0; frame < num_frames; ++frame) {
+    const float envelope = 0.5f + 0.5f * static_cast<float>(sin(two_pi * 0.5 * frame / rate));
+    lowpass = 0.7f * lowpass + 0.3f * noise();
+    reference.channels[0][frame] = 0.3f * envelope * lowpass;
+    reference.channels[1][frame] = 0.3f * envelope * (0.5f * lowpass + 0.2f * noise());
+  }
+  // Đ^܂ł̌oH: xƁA~LT[⃊Tvx̒Z
+  for (size_t channel = 0; channel < 2; ++channel) {
+    const auto& x = reference.channels[channel];
+    for (size_t frame = static_cast<size_t>(options.delay) + 3; frame < num_frames; ++frame) {
+      const size_t source = frame - options.delay;
+      echo.channels[channel][frame] = 0.6f * x[source] + 0.2f * x[source - 3] - 0.1f * x[source - 2];
+    }
+    for (size_t frame = 0; frame < num_frames; ++frame) {
+      const float near = options.near_gain * (static_cast<float>(sin(two_pi * 330.0 * frame / rate)) + 0.3f * noise());
+      capture.channels[channel][frame] = echo.channels[channel][frame] + near;
+    }
+  }
+}
+
+double to_db(double numerator, double denominator)
+{
+  return 10.0 * log10((numerator + 1.0e-20) / (denominator + 1.0e-20));
+}
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--seconds" && i + 1 < argc) {
+      options.seconds = atof(argv[++i]);
+    } else if (arg == "--delay" && i + 1 < argc) {
+      options.delay = atoi(argv[++i]);
+    } else if (arg == "--near-gain" && i + 1 < argc) {
+      options.near_gain = static_cast<float>(atof(argv[++i]));
+    } else if (arg == "--packet" && i + 1 < argc) {
+      options.packet = static_cast<size_t>(atoi(argv[++i]));
+    } else if (arg == "--capture" && i + 1 < argc) {
+      options.capture_path = argv[++i];
+    } else if (arg == "--reference" && i + 1 < argc) {
+      options.reference_path = argv[++i];
+    } else if (arg == "--min-erle" && i + 1 < argc) {
+      options.min_erle = atof(argv[++i]);
+    } else if (arg == "--csv") {
+      options.csv = true;
+    }
+  }
+  if (options.packet == 0 || options.packet > 8192) {
+    fprintf(stderr, "Packet size must be between 1 and 8192.\n");
+    return 1;
+  }
+
+  Wave reference;
+  Wave capture;
+  Wave echo;
+  const bool synthetic = options.capture_path.empty();
+  if (synthetic) {
+    make_synthetic(options, reference, capture, echo);
+  } else {
+    if (!read_wave(options.capture_path, capture) || !read_wave(options.reference_path, reference)) {
+      fprintf(stderr, "Failed to read WAV files. 16-bit PCM or 32-bit float is supported.\n");
+      return 1;
+    }
+    if (capture.sampling_rate != reference.sampling_rate) {
+      fprintf(stderr, "Sampling rates differ: capture %d, reference %d.\n", capture.sampling_rate, reference.sampling_rate);
+      return 1;
+    }
+  }
+  const int rate = capture.sampling_rate;
+  const size_t num_frames = (std::min)(capture.channels[0].size(), reference.channels[0].size());
+
+  reference_ring ring(65536);
+  echo_canceller canceller(ring);
+  std::vector<float> interleaved(options.packet * 2);
+  std::vector<float> signal[2];
+  std::vector<double> call_us;
+  call_us.reserve(num_frames / options.packet + 1);
+
+  if (options.csv) {
+    printf("second,delay,erle_estimate_db,erle_db,true_erle_db\n");
+  }
+  double input_energy = 0.0;
+  double output_energy = 0.0;
+  double echo_energy = 0.0;
+  double residual_energy = 0.0;
+  double last_erle = 0.0;
+  size_t next_report = rate;
+  for (size_t start = 0; start + options.packet <= num_frames; start += options.packet) {
+    // @ƓAQƂ̓I[fBIXbhɏA^Xbhォǂ
+    for (size_t frame = 0; frame < options.packet; ++frame) {
+      interleaved[frame * 2] = reference.channels[0][start + frame];
+      interleaved[frame * 2 + 1] = reference.channels[1][start + frame];
+    }
+    ring.push(interleaved.data(), options.packet, 2);
+    for (size_t channel = 0; channel < 2; ++channel) {
+      signal[channel].assign(capture.channels[channel].begin() + start, capture.channels[channel].begin() + start + options.packet);
+    }
+
+    const auto begin = high_resolution_clock::now();
+    canceller.process(signal, 2);
+    call_us.push_back(duration<double, std::micro>(high_resolution_clock::now() - begin).count());
+
+    // o͂block_sizex̂ŁAׂ͂炷
+    for (size_t frame = 0; frame < options.packet; ++frame) {
+      const size_t position = start + frame;
+      if (position < echo_canceller::block_size) {
+        continue;
+      }
+      const size_t source = position - echo_canceller::block_size;
+      for (size_t channel = 0; channel < 2; ++channel) {
+        const float input = capture.channels[channel][source];
+        const float output = signal[channel][frame];
+        input_energy += input * input;
+        output_energy += output * output;
+        if (synthetic) {
+          const float near = input - echo.channels[channel][source];
+          echo_energy += echo.channels[channel][source] * echo.channels[channel][source];
+          residual_energy += (output - near) * (output - near);
+        }
+      }
+    }
+
+    if (start + options.packet >= next_report) {
+      const int second = static_cast<int>(next_report / rate);
+      last_erle = synthetic ? to_db(echo_energy, residual_energy) : to_db(input_energy, output_energy);
+      if (options.csv) {
+        printf("%d,%lld,%.2f,%.2f,%s\n", second, canceller.get_delay(), canceller.get_erle_db(), to_db(input_energy, output_energy),
+               synthetic ? std::to_string(last_erle).c_str() : "");
+      } else if (synthetic) {
+        printf("t=%3ds delay=%6lld erle_estimate=%6.1fdB erle=%6.1fdB true_erle=%6.1fdB\n", second, canceller.get_delay(), canceller.get_erle_db(),
+               to_db(input_energy, output_energy), last_erle);
+      } else {
+        printf("t=%3ds delay=%6lld erle_estimate=%6.1fdB erle=%6.1fdB\n", second, canceller.get_delay(), canceller.get_erle_db(), last_erle);
+      }
+      input_energy = output_energy = echo_energy = residual_energy = 0.0;
+      next_report += rate;
+    }
+  }
+
+  if (call_us.empty()) {
+    fprintf(stderr, "No audio to process.\n");
+    return 1;
+  }
+  std::sort(call_us.begin(), call_us.end());
+  double total_us = 0.0;
+  for (auto value : call_us) {
+    total_us += value;
+  }
+  const double mean_us = total_us / call_us.size();
+  const double packet_us = options.packet * 1.0e6 / rate;
+  fprintf(options.csv ? stderr : stdout, "%zu-frame packets: mean %.1f us, p99 %.1f us, max %.1f us (%.2f%% of real time)\n",
+          options.packet, mean_us, call_us[call_us.size() * 99 / 100], call_us.back(), mean_us / packet_us * 100.0);
+
+  if (last_erle < options.min_erle) {
+    fprintf(stderr, "ERLE %.1f dB is below %.1f dB.\n", last_erle, options.min_erle);
+    return 2;
+  }
+  return 0;
+}
@@ -0,0 +1,510 @@
+// WAVt@CUnityŁAԂ葬beat_analyzerɒʂc[B
+// t@C̓}bvđ傫ȃubNɕϊÃt@CRÃXbhŕɏB
+//
+// OfflineAnalyzer [--threads T] [--format json|csv] [--out DIR] [--hop-ms M] file.wav...
+//
+// t@C<O>.analysis.json(܂csv)ցAM msBPMA̔܂ł̎ԁARMSAVUAш斈̃x̎nƔ̎oB
+// CSVł͔̎<O>.beats.csvɕďB--outȂƓ̓t@CƓtH_ɏB
+#include "beat_analyzer.h"
+#include "fft.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+struct Options
+{
+  int threads = 0;
+  bool csv = false;
+  std::string out_directory;
+  double hop_milliseconds = 50.0;
+  std::vector<std::string> files;
+};
+
+// ǂݎp̃}bv
+class mapped_file
+{
+public:
+  explicit mapped_file(const std::string& path)
+    : data(nullptr)
+    , size(0)
+  {
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+      return;
+    }
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+      return;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+      return;
+    }
+    data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    size = data ? static_cast<size_t>(file_size.QuadPart) : 0;
+#else
+    descriptor = open(path.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+      return;
+    }
+    struct stat status;
+    if (fstat(descriptor, &status) != 0 || status.st_size == 0) {
+      return;
+    }
+    void* view = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+    if (view == MAP_FAILED) {
+      return;
+    }
+    madvise(view, status.st_size, MADV_SEQUENTIAL);
+    data = static_cast<const uint8_t*>(view);
+    size = static_cast<size_t>(status.st_size);
+#endif
+  }
+
+  ~mapped_file()
+  {
+#ifdef _WIN32
+    if (data) {
+      UnmapViewOfFile(data);
+    }
+    if (mapping) {
+      CloseHandle(mapping);
+    }
+    if (file != INVALID_HANDLE_VALUE) {
+      CloseHandle(file);
+    }
+#else
+    if (data) {
+      munmap(const_cast<uint8_t*>(data), size);
+    }
+    if (descriptor >= 0) {
+      close(descriptor);
+    }
+#endif
+  }
+
+  const uint8_t* data;
+  size_t size;
+
+private:
+#ifdef _WIN32
+  HANDLE file = INVALID_HANDLE_VALUE;
+  HANDLE mapping = nullptr;
+#else
+  int descriptor = -1;
+#endif
+};
+
+// }bvWAVdata`N̈ʒuƌ`
+struct wave_view
+{
+  const uint8_t* samples = nullptr;
+  size_t num_frames = 0;
+  int num_channels = 0;
+  int sampling_rate = 0;
+  int bits = 0;
+  bool is_float = false;
+};
+
+uint32_t read_u32(const uint8_t* data)
+{
+  return data[0] | (data[1] << 8) | (data[2] << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+uint16_t read_u16(const uint8_t* data)
+{
+  return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+bool parse_wave(const mapped_file& file, wave_view& wave)
+{
+  if (file.size < 12 || memcmp(file.data, "RIFF", 4) != 0 || memcmp(file.data + 8, "WAVE", 4) != 0) {
+    return false;
+  }
+  int format = 0;
+  size_t offset = 12;
+  while (offset + 8 <= file.size) {
+    const uint8_t* chunk = file.data + offset;
+    size_t size = read_u32(chunk + 4);
+    if (size > file.size - offset - 8) {
+      // or̃t@C̓TCY0̂܂܂̂Ƃ̂ŁAcSƂ݂Ȃ
+      size = file.size - offset - 8;
+    }
+    if (memcmp(chunk, "fmt ", 4) == 0 && size >= 16) {
+      format = read_u16(chunk + 8);
+      wave.num_channels = read_u16(chunk + 10);
+      wave.sampling_rate = static_cast<int>(read_u32(chunk + 12));
+      wave.bits = read_u16(chunk + 22);
+      if (format == 0xFFFE && size >= 26) {
+        // WAVE_FORMAT_EXTENSIBLE̓TutH[}bg̐擪2oCg`
+        format = read_u16(chunk + 32);
+      }
+    } else if (memcmp(chunk, "data", 4) == 0) {
+      wave.is_float = format == 3 && wave.bits == 32;
+      const bool is_pcm = format == 1 && (wave.bits == 16 || wave.bits == 24);
+      if (wave.num_channels <= 0 || wave.sampling_rate <= 0 || (!wave.is_float && !is_pcm)) {
+        return false;
+      }
+      wave.samples = chunk + 8;
+      wave.num_frames = size / (wave.num_channels * wave.bits / 8);
+      return true;
+    }
+    offset += 8 + size + (size & 1);
+  }
+  return false;
+}
+
+float read_sample(const wave_view& wave, const uint8_t* sample)
+{
+  if (wave.is_float) {
+    float value;
+    memcpy(&value, sample, sizeof(value));
+    return value;
+  }
+  if (wave.bits == 16) {
+    return static_cast<int16_t>(read_u16(sample)) / 32768.0f;
+  }
+  const int32_t value = static_cast<int32_t>((sample[0] << 8) | (sample[1] << 16) | (static_cast<uint32_t>(sample[2]) << 24)) >> 8;
+  return value / 8388608.0f;
+}
+
+// packet_sizeɑ|ĕϊA//̃p[𑫂Ă
+class band_meter
+{
+public:
+  static const int num_bands = 3;
+
+  explicit band_meter(int sampling_rate)
+    : fft(beat_analyzer::packet_size)
+    , window(beat_analyzer::packet_size)
+    , frame(beat_analyzer::packet_size)
+    , spectrum(beat_analyzer::packet_size / 2 + 1)
+  {
+    const double two_pi = 6.283185307179586;
+    for (size_t index = 0; index < window.size(); ++index) {
+      window[index] = static_cast<float>(0.5 - 0.5 * cos(two_pi * index / window.size()));
+    }
+    // 250Hz4kHzŕBpPbgZ1r200Hz߂̂ŁA͒ŏ̃rɂȂ
+    const double bin_hz = static_cast<double>(sampling_rate) / beat_analyzer::packet_size;
+    low_end = static_cast<size_t>(ceil(250.0 / bin_hz));
+    mid_end = static_cast<size_t>(ceil(4000.0 / bin_hz));
+    clear();
+  }
+
+  void clear()
+  {
+    power.fill(0.0);
+    num_packets = 0;
+  }
+
+  void add(const float* left, const float* right)
+  {
+    for (size_t index = 0; index < frame.size(); ++index) {
+      frame[index] = 0.5f * (left[index] + right[index]) * window[index];
+    }
+    fft.forward(frame.data(), spectrum.data());
+    for (size_t bin = 1; bin < spectrum.size(); ++bin) {
+      const int band = bin < low_end ? 0 : (bin < mid_end ? 1 : 2);
+      power[band] += std::norm(spectrum[bin]);
+    }
+    ++num_packets;
+  }
+
+  // 1pPbg̕σp[ [dB]
+  double get_level_db(int band) const
+  {
+    const double mean = num_packets > 0 ? power[band] / num_packets / (frame.size() * frame.size()) : 0.0;
+    return 10.0 * log10(mean + 1.0e-20);
+  }
+
+private:
+  real_fft fft;
+  std::vector<float> window;
+  std::vector<float> frame;
+  std::vector<std::complex<float>> spectrum;
+  size_t low_end;
+  size_t mid_end;
+  std::array<double, num_bands> power;
+  size_t num_packets;
+};
+
+struct time_series
+{
+  std::vector<double> time;
+  std::vector<float> bpm;
+  std::vector<float> milliseconds_to_next_beat;
+  std::vector<float> rms;
+  std::vector<float> vu;
+  std::array<std::vector<float>, band_meter::num_bands> bands;
+  std::vector<double> beats;
+};
+
+struct file_result
+{
+  bool succeeded = false;
+  std::string error;
+  double duration = 0.0;
+  double elapsed = 0.0;
+  float final_bpm = 0.0f;
+};
+
+file_result analyze(const std::string& path, const Options& options, time_series& series, int& sampling_rate)
+{
+  file_result result;
+  mapped_file file(path);
+  if (!file.data) {
+    result.error = "Failed to map file.";
+    return result;
+  }
+  wave_view wave;
+  if (!parse_wave(file, wave)) {
+    result.error = "Failed to parse WAV. 16/24-bit PCM or 32-bit float is supported.";
+    return result;
+  }
+  sampling_rate = wave.sampling_rate;
+  const auto start = std::chrono::steady_clock::now();
+
+  beat_analyzer analysis(wave.sampling_rate);
+  band_meter meter(wave.sampling_rate);
+  const size_t packet_size = beat_analyzer::packet_size;
+  // 1s̃pPbgB͂ւ͂̒Pʂœn
+  const size_t hop_packets = (std::max)(static_cast<size_t>(options.hop_milliseconds * wave.sampling_rate / 1000.0 / packet_size + 0.5), static_cast<size_t>(1));
+  const size_t hop_frames = hop_packets * packet_size;
+  // }bvxɕϊ
+  const size_t block_frames = (65536 / hop_frames + 1) * hop_frames;
+  std::vector<float> block_left(block_frames);
+  std::vector<float> block_right(block_frames);
+  std::vector<float> left(hop_frames);
+  std::vector<float> right(hop_frames);
+  const size_t frame_bytes = wave.num_channels * wave.bits / 8;
+  const size_t sample_bytes = wave.bits / 8;
+  const size_t right_offset = wave.num_channels > 1 ? sample_bytes : 0;
+
+  const size_t num_hops = wave.num_frames / hop_frames;
+  series.time.reserve(num_hops);
+  double pending_beat = -1.0;
+  size_t position = 0;
+  while (position + hop_frames <= wave.num_frames) {
+    const size_t length = (std::min)(block_frames, (wave.num_frames - position) / hop_frames * hop_frames);
+    const uint8_t* source = wave.samples + position * frame_bytes;
+    for (size_t frame = 0; frame < length; ++frame) {
+      block_left[frame] = read_sample(wave, source + frame * frame_bytes);
+      block_right[frame] = read_sample(wave, source + frame * frame_bytes + right_offset);
+    }
+
+    for (size_t hop = 0; hop < length; hop += hop_frames) {
+      std::copy(block_left.begin() + hop, block_left.begin() + hop + hop_frames, left.begin());
+      std::copy(block_right.begin() + hop, block_right.begin() + hop + hop_frames, right.begin());
+      analysis.process(left, right);
+      meter.clear();
+      for (size_t packet = 0; packet < hop_frames; packet += packet_size) {
+        meter.add(left.data() + packet, right.data() + packet);
+      }
+
+      const double now = static_cast<double>(position + hop + hop_frames) / wave.sampling_rate;
+      const float next_beat = analysis.get_milliseconds_to_next_beat();
+      // \Ă̎߂A̎𔏂ƂċL^
+      if (pending_beat >= 0.0 && pending_beat <= now) {
+        series.beats.push_back(pending_beat);
+      }
+      pending_beat = analysis.get_bpm() > 0.0f ? now + next_beat / 1000.0 : -1.0;
+
+      series.time.push_back(now);
+      series.bpm.push_back(analysis.get_bpm());
+      series.milliseconds_to_next_beat.push_back(next_beat);
+      series.rms.push_back(analysis.get_rms(beat_analyzer::window_size - 1));
+      series.vu.push_back(analysis.get_bpm_vu(beat_analyzer::window_size - 1));
+      for (int band = 0; band < band_meter::num_bands; ++band) {
+        series.bands[band].push_back(static_cast<float>(meter.get_level_db(band)));
+      }
+    }
+    position += length;
+  }
+
+  result.succeeded = true;
+  result.duration = static_cast<double>(wave.num_frames) / wave.sampling_rate;
+  result.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  result.final_bpm = analysis.get_bpm();
+  return result;
+}
+
+std::string output_stem(const std::string& path, const Options& options)
+{
+  const size_t separator = path.find_last_of("/\\");
+  const std::string directory = separator == std::string::npos ? std::string() : path.substr(0, separator + 1);
+  std::string name = separator == std::string::npos ? path : path.substr(separator + 1);
+  const size_t extension = name.find_last_of('.');
+  if (extension != std::string::npos) {
+    name = name.substr(0, extension);
+  }
+  if (options.out_directory.empty()) {
+    return directory + name;
+  }
+  const char last = options.out_directory.back();
+  return options.out_directory + (last == '/' || last == '\\' ? "" : "/") + name;
+}
+
+std::string escape_json(const std::string& text)
+{
+  std::string result;
+  for (char c : text) {
+    if (c == '"' || c == '\\') {
+      result += '\\';
+    }
+    result += c;
+  }
+  return result;
+}
+
+template <typename T>
+void write_json_array(FILE* file, const char* name, const std::vector<T>& values, const char* format, bool last = false)
+{
+  fprintf(file, "  \"%s\": [", name);
+  for (size_t index = 0; index < values.size(); ++index) {
+    fprintf(file, index == 0 ? "" : ",");
+    fprintf(file, format, static_cast<double>(values[index]));
+  }
+  fprintf(file, last ? "]\n" : "],\n");
+}
+
+bool write_json(const std::string& path, const std::string& source, int sampling_rate, const Options& options, const time_series& series)
+{
+  FILE* file = fopen(path.c_str(), "w");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "{\n");
+  fprintf(file, "  \"file\": \"%s\",\n", escape_json(source).c_str());
+  fprintf(file, "  \"sampling_rate\": %d,\n", sampling_rate);
+  fprintf(file, "  \"hop_ms\": %.3f,\n", options.hop_milliseconds);
+  write_json_array(file, "time", series.time, "%.4f");
+  write_json_array(file, "bpm", series.bpm, "%.3f");
+  write_json_array(file, "ms_to_next_beat", series.milliseconds_to_next_beat, "%.2f");
+  write_json_array(file, "rms", series.rms, "%.6f");
+  write_json_array(file, "vu", series.vu, "%.6f");
+  write_json_array(file, "band_low_db", series.bands[0], "%.2f");
+  write_json_array(file, "band_mid_db", series.bands[1], "%.2f");
+  write_json_array(file, "band_high_db", series.bands[2], "%.2f");
+  write_json_array(file, "beats", series.beats, "%.4f", true);
+  fprintf(file, "}\n");
+  return fclose(file) == 0;
+}
+
+bool write_csv(const std::string& stem, const time_series& series)
+{
+  FILE* file = fopen((stem + ".analysis.csv").c_str(), "w");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "time,bpm,ms_to_next_beat,rms,vu,band_low_db,band_mid_db,band_high_db\n");
+  for (size_t index = 0; index < series.time.size(); ++index) {
+    fprintf(file, "%.4f,%.3f,%.2f,%.6f,%.6f,%.2f,%.2f,%.2f\n", series.time[index], series.bpm[index], series.milliseconds_to_next_beat[index],
+            series.rms[index], series.vu[index], series.bands[0][index], series.bands[1][index], series.bands[2][index]);
+  }
+  bool succeeded = fclose(file) == 0;
+
+  file = fopen((stem + ".beats.csv").c_str(), "w");
+  if (!file) {
+    return false;
+  }
+  fprintf(file, "beat_time\n");
+  for (auto beat : series.beats) {
+    fprintf(file, "%.4f\n", beat);
+  }
+  return fclose(file) == 0 && succeeded;
+}
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--threads" && i + 1 < argc) {
+      options.threads = atoi(argv[++i]);
+    } else if (arg == "--format" && i + 1 < argc) {
+      options.csv = std::string(argv[++i]) == "csv";
+    } else if (arg == "--out" && i + 1 < argc) {
+      options.out_directory = argv[++i];
+    } else if (arg == "--hop-ms" && i + 1 < argc) {
+      options.hop_milliseconds = atof(argv[++i]);
+    } else {
+      options.files.push_back(arg);
+    }
+  }
+  if (options.files.empty()) {
+    fprintf(stderr, "Usage: OfflineAnalyzer [--threads T] [--format json|csv] [--out DIR] [--hop-ms M] file.wav...\n");
+    return 1;
+  }
+  if (options.threads <= 0) {
+    options.threads = static_cast<int>((std::max)(std::thread::hardware_concurrency(), 1u));
+  }
+  const size_t num_threads = (std::min)(static_cast<size_t>(options.threads), options.files.size());
+
+  std::atomic<size_t> next_file(0);
+  std::atomic<int> failures(0);
+  std::mutex output_mutex;
+  const auto start = std::chrono::steady_clock::now();
+  double total_duration = 0.0;
+
+  auto worker = [&]() {
+    for (size_t index = next_file++; index < options.files.size(); index = next_file++) {
+      const std::string& path = options.files[index];
+      time_series series;
+      int sampling_rate = 0;
+      auto result = analyze(path, options, series, sampling_rate);
+      if (result.succeeded) {
+        const std::string stem = output_stem(path, options);
+        const bool written = options.csv ? write_csv(stem, series) : write_json(stem + ".analysis.json", path, sampling_rate, options, series);
+        if (!written) {
+          result.succeeded = false;
+          result.error = "Failed to write results.";
+        }
+      }
+
+      std::lock_guard<std::mutex> lock(output_mutex);
+      if (result.succeeded) {
+        total_duration += result.duration;
+        printf("%s: %.1f s in %.3f s (%.0fx real time), %zu beats, final BPM %.1f\n", path.c_str(), result.duration, result.elapsed,
+               result.duration / (result.elapsed > 0.0 ? result.elapsed : 1.0e-9), series.beats.size(), result.final_bpm);
+      } else {
+        ++failures;
+        fprintf(stderr, "%s: %s\n", path.c_str(), result.error.c_str());
+      }
+    }
+  };
+  std::vector<std::thread> workers;
+  for (size_t thread = 0; thread < num_threads; ++thread) {
+    workers.emplace_back(worker);
+  }
+  for (auto& thread : workers) {
+    thread.join();
+  }
+
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("%zu files, %.1f s of audio in %.2f s on %zu threads (%.0fx real time)\n", options.files.size() - failures, total_duration, elapsed, num_threads,
+         total_duration / (elapsed > 0.0 ? elapsed : 1.0e-9));
+  return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// LɌJꂽ[vobNʃvZXǂފmFpc[B
+// vOCStartSharedExportĂłNB
+//
+// SharedCaptureReader [--name NAME] [--seconds S]
+#include "shared_capture_layout.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+const shared_capture::header* map_shared(const std::string& name)
+{
+#ifdef _WIN32
+  auto handle = OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+  if (!handle) {
+    return nullptr;
+  }
+  return static_cast<const shared_capture::header*>(MapViewOfFile(handle, FILE_MAP_READ, 0, 0, shared_capture::total_bytes()));
+#else
+  const int descriptor = shm_open(name.c_str(), O_RDONLY, 0);
+  if (descriptor < 0) {
+    return nullptr;
+  }
+  void* view = mmap(nullptr, shared_capture::total_bytes(), PROT_READ, MAP_SHARED, descriptor, 0);
+  close(descriptor);
+  return view == MAP_FAILED ? nullptr : static_cast<const shared_capture::header*>(view);
+#endif
+}
+}
+
+int main(int argc, char** argv)
+{
+  std::string name = shared_capture::default_name;
+  double seconds = 10.0;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--name" && i + 1 < argc) {
+      name = argv[++i];
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = atof(argv[++i]);
+    }
+  }
+
+  auto shared = map_shared(name);
+  if (!shared) {
+    fprintf(stderr, "Failed to open shared memory %s.\n", name.c_str());
+    return 1;
+  }
+  if (shared->magic != shared_capture::magic || shared->version != shared_capture::version) {
+    fprintf(stderr, "Shared memory %s has an unexpected layout.\n", name.c_str());
+    return 1;
+  }
+
+  // 100msɒ100ms̃s[NƉ͌ʂ\
+  std::vector<float> samples;
+  const auto start = std::chrono::steady_clock::now();
+  uint64_t previous_frame = shared->write_frame.load();
+  while (std::chrono::steady_clock::now() - start < std::chrono::duration<double>(seconds)) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    const uint32_t sampling_rate = shared->sampling_rate.load();
+    const uint32_t num_channels = shared->num_channels.load();
+    samples.resize(sampling_rate / 10);
+
+    const uint64_t write_frame = shared->write_frame.load();
+    printf("frame %llu (+%llu) rate %u", static_cast<unsigned long long>(write_frame),
+           static_cast<unsigned long long>(write_frame - previous_frame), sampling_rate);
+    previous_frame = write_frame;
+    for (uint32_t channel = 0; channel < num_channels; ++channel) {
+      const size_t num_valid = shared_capture::read_latest(shared, channel, samples.data(), samples.size());
+      float peak = 0.0f;
+      for (size_t i = samples.size() - num_valid; i < samples.size(); ++i) {
+        peak = std::fmax(peak, std::fabs(samples[i]));
+      }
+      printf(" ch%u peak %.3f", channel, peak);
+    }
+
+    shared_capture::analyzer_snapshot snapshot;
+    if (shared_capture::read_analyzer(shared, &snapshot)) {
+      printf(" bpm %.1f next beat %.0f ms", snapshot.bpm, snapshot.milliseconds_to_next_beat);
+    }
+    printf("\n");
+  }
+  return 0;
+}
@@ -0,0 +1,298 @@
+// ^obt@(capture_buffer)ProcessCallback̓ǂݏo^vŒԓAr؂Čc[B
+//
+// ^Xbh͎@Ɠobt@1/2ɋNė܂10ms̃pPbgSď݁A
+// I[fBIXbhDSPobt@Ƀ`l01̃\[XǂށB
+// ^Xbh̋N̒xAR[obN̒xA^foCXƍĐ̃NbN̂A
+// GĈ悤ȃI[fBIXbh̒~włAԕ𐔕bŗB
+//
+// SoakSimulator [--hours H] [--rate R] [--length L] [--target N] [--capture-jitter-ms MS] [--callback-jitter-ms MS]
+//               [--drift-ppm PPM] [--stall-interval S] [--stall-ms MS] [--seed N] [--max-underruns N] [--max-overflows N] [--csv]
+//
+// A_[Ƃӂ̓xɁA̎_̃obt@cʁAO̘^̎ԁAR[obN̒xA~A
+// NbN̂ŗ܂AN̒xŃfoCXŎt[̗݌v1so͂B񐔂--max-underruns/--max-overflows𒴂ƏIR[h2ŎsB
+#include "capture_buffer.h"
+#include <windows.h>
+#include <vector>
+#include <array>
+#include <random>
+#include <chrono>
+#include <string>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace
+{
+// AudioDevice::max_buffer_sizeƓ
+const size_t ring_capacity = 1024 * 10;
+const size_t num_channels = 2;
+// AudioDeviceinitialize֓n^obt@ƁAWASAPĨpPbg
+const double capture_buffer_millisec = 32.0;
+const double packet_millisec = 10.0;
+const long long nanoseconds_per_second = 1000000000LL;
+
+struct Options
+{
+  double hours = 1.0;
+  int rate = 48000;
+  size_t length = 1024;
+  size_t target = 1024 * 3;
+  double capture_jitter_ms = 0.25;
+  double callback_jitter_ms = 0.25;
+  double drift_ppm = 0.0;
+  double stall_interval = 60.0;
+  double stall_ms = 50.0;
+  unsigned int seed = 1;
+  long long max_underruns = 0;
+  long long max_overflows = 0;
+  bool csv = false;
+};
+
+long long to_nanoseconds(double milliseconds)
+{
+  return static_cast<long long>(milliseconds * 1.0e6);
+}
+
+class simulator
+{
+public:
+  explicit simulator(const Options& options)
+    : options(options)
+    , buffer(ring_capacity)
+    , random(options.seed)
+    , device_rate(options.rate * (1.0 + options.drift_ppm * 1.0e-6))
+    , packet_frames(static_cast<size_t>(options.rate * packet_millisec / 1000.0))
+    , device_buffer_frames(static_cast<size_t>(options.rate * capture_buffer_millisec / 1000.0))
+    , capture_period(to_nanoseconds(capture_buffer_millisec / 2.0))
+    , callback_period(static_cast<long long>(static_cast<double>(options.length) * nanoseconds_per_second / options.rate))
+    , device_read_frames(0)
+    , lost_frames(0)
+    , last_capture(0)
+    , next_capture(0)
+    , callback_index(0)
+    , callback_time(0)
+    , callback_late(0)
+    , stalled(false)
+    , next_stall(0)
+    , underruns(0)
+    , overflows(0)
+  {
+    output.resize(options.length);
+    buffer.set_target_buffer_size(options.target);
+    // 1pPbg̐gBpPbgŎ̂ŌqĂr؂Ȃ
+    for (auto& channel : packet) {
+      channel.resize(packet_frames);
+      for (size_t frame = 0; frame < packet_frames; ++frame) {
+        channel[frame] = 0.5f * static_cast<float>(sin(6.283185307 * frame / packet_frames));
+      }
+    }
+    next_stall = options.stall_interval > 0.0 ? draw_stall_interval() : -1;
+  }
+
+  void run()
+  {
+    const long long end = static_cast<long long>(options.hours * 3600.0 * nanoseconds_per_second);
+    buffer.start(options.rate, num_channels);
+    next_capture = capture_period + draw_jitter(options.capture_jitter_ms);
+    schedule_callback();
+    while (next_capture < end || callback_time < end) {
+      if (next_capture <= callback_time) {
+        capture(next_capture);
+        // @͏Ƀobt@1/2̂ŁAx͂̂܂܎̋Nɂ
+        next_capture += capture_period + draw_jitter(options.capture_jitter_ms);
+      } else {
+        process_callback();
+        ++callback_index;
+        schedule_callback();
+      }
+    }
+  }
+
+  long long get_underruns()
+  {
+    return underruns;
+  }
+
+  long long get_overflows()
+  {
+    return overflows;
+  }
+
+  void print_header()
+  {
+    if (options.csv) {
+      printf("time_s,event,channel,samples,state,fill_left,fill_right,since_capture_ms,callback_late_ms,stalled,clock_offset,lost_frames\n");
+    }
+  }
+
+private:
+  // ^Xbh1̋NBfoCX̃obt@ɗ܂pPbgSď
+  void capture(long long now)
+  {
+    last_capture = now;
+    const UINT64 produced = static_cast<UINT64>(static_cast<double>(now) * device_rate / nanoseconds_per_second);
+    if (produced - device_read_frames > device_buffer_frames) {
+      // NxăfoCX̃obt@ӂꂽBÂpPbg͎
+      const UINT64 lost = (produced - device_read_frames - device_buffer_frames + packet_frames - 1) / packet_frames * packet_frames;
+      device_read_frames += lost;
+      lost_frames += lost;
+      report(now, "device_overflow", -1, static_cast<size_t>(lost));
+      ++overflows;
+    }
+    while (produced - device_read_frames >= packet_frames) {
+      device_read_frames += packet_frames;
+      const size_t dropped = buffer.push(packet.data(), num_channels, false);
+      if (dropped > 0) {
+        report(now, "ring_overflow", -1, dropped);
+        ++overflows;
+      }
+    }
+  }
+
+  // I[fBIXbh1̃~bNXB`l01̃\[XProcessCallback𑱂ČĂ
+  void process_callback()
+  {
+    for (size_t channel = 0; channel < num_channels; ++channel) {
+      const UINT64 before = buffer.get_underruns();
+      buffer.read_source(static_cast<int>(channel), true, readers[channel], output.data(), options.length);
+      if (buffer.get_underruns() != before) {
+        report(callback_time, "underrun", static_cast<int>(channel), options.length);
+        ++underruns;
+      }
+    }
+  }
+
+  // ̃R[obN̎B\x邱Ƃ͂ĂAÕR[obNOɂ͂ȂȂB
+  // ~ɗ͂R[obŃA~ɑČĂ΂
+  void schedule_callback()
+  {
+    const long long nominal = callback_index * callback_period;
+    long long time = nominal + draw_jitter(options.callback_jitter_ms);
+    stalled = false;
+    while (next_stall >= 0 && time >= next_stall) {
+      const long long stall_end = next_stall + to_nanoseconds(options.stall_ms);
+      if (time < stall_end) {
+        time = stall_end;
+        stalled = true;
+      }
+      next_stall = stall_end + draw_stall_interval();
+    }
+    callback_time = time > callback_time ? time : callback_time;
+    callback_late = callback_time - nominal;
+  }
+
+  long long draw_jitter(double mean_millisec)
+  {
+    if (mean_millisec <= 0.0) {
+      return 0;
+    }
+    // XPW[̒x͑唼A܂ɑ傫
+    std::exponential_distribution<double> distribution(1.0 / mean_millisec);
+    return to_nanoseconds(distribution(random));
+  }
+
+  long long draw_stall_interval()
+  {
+    std::exponential_distribution<double> distribution(1.0 / options.stall_interval);
+    return static_cast<long long>(distribution(random) * nanoseconds_per_second);
+  }
+
+  void report(long long now, const char* event, int channel, size_t samples)
+  {
+    static const char* state_names[] = { "stopped", "preparing", "playing" };
+    const double seconds = static_cast<double>(now) / nanoseconds_per_second;
+    const char* state = state_names[static_cast<int>(buffer.get_state())];
+    const double since_capture_ms = static_cast<double>(now - last_capture) / 1.0e6;
+    const double late_ms = static_cast<double>(callback_late) / 1.0e6;
+    // NbN̂ōĐ葽(Ȃ班Ȃ)^ꂽTv
+    const double clock_offset = seconds * (device_rate - options.rate);
+    if (options.csv) {
+      printf("%.6f,%s,%d,%zu,%s,%zu,%zu,%.3f,%.3f,%d,%.1f,%llu\n", seconds, event, channel, samples, state,
+             buffer.get_size(0), buffer.get_size(1), since_capture_ms, late_ms, stalled ? 1 : 0, clock_offset, lost_frames);
+    } else {
+      const int total = static_cast<int>(seconds);
+      printf("%02d:%02d:%02d.%03d %-16s ch=%2d samples=%5zu state=%-9s fill=%5zu/%5zu since_capture=%7.3fms callback_late=%7.3fms%s clock_offset=%+.1f lost=%llu\n",
+             total / 3600, total / 60 % 60, total % 60, static_cast<int>((seconds - total) * 1000.0), event, channel, samples, state,
+             buffer.get_size(0), buffer.get_size(1), since_capture_ms, late_ms, stalled ? " stalled" : "", clock_offset, lost_frames);
+    }
+  }
+
+  Options options;
+  capture_buffer buffer;
+  std::mt19937 random;
+  std::array<std::vector<float>, num_channels> packet;
+  // ProcessCallbackǂݏoƁA\[X̓ǂݏȍ
+  std::vector<float> output;
+  std::array<capture_buffer::reader, num_channels> readers;
+  double device_rate;
+  size_t packet_frames;
+  size_t device_buffer_frames;
+  long long capture_period;
+  long long callback_period;
+
+  UINT64 device_read_frames;
+  unsigned long long lost_frames;
+  long long last_capture;
+  long long next_capture;
+  long long callback_index;
+  long long callback_time;
+  long long callback_late;
+  bool stalled;
+  long long next_stall;
+  long long underruns;
+  long long overflows;
+};
+}
+
+int main(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg == "--hours" && i + 1 < argc) {
+      options.hours = atof(argv[++i]);
+    } else if (arg == "--rate" && i + 1 < argc) {
+      options.rate = atoi(argv[++i]);
+    } else if (arg == "--length" && i + 1 < argc) {
+      options.length = static_cast<size_t>(atoi(argv[++i]));
+    } else if (arg == "--target" && i + 1 < argc) {
+      options.target = static_cast<size_t>(atoi(argv[++i]));
+    } else if (arg == "--capture-jitter-ms" && i + 1 < argc) {
+      options.capture_jitter_ms = atof(argv[++i]);
+    } else if (arg == "--callback-jitter-ms" && i + 1 < argc) {
+      options.callback_jitter_ms = atof(argv[++i]);
+    } else if (arg == "--drift-ppm" && i + 1 < argc) {
+      options.drift_ppm = atof(argv[++i]);
+    } else if (arg == "--stall-interval" && i + 1 < argc) {
+      options.stall_interval = atof(argv[++i]);
+    } else if (arg == "--stall-ms" && i + 1 < argc) {
+      options.stall_ms = atof(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed = static_cast<unsigned int>(atoi(argv[++i]));
+    } else if (arg == "--max-underruns" && i + 1 < argc) {
+      options.max_underruns = atoll(argv[++i]);
+    } else if (arg == "--max-overflows" && i + 1 < argc) {
+      options.max_overflows = atoll(argv[++i]);
+    } else if (arg == "--csv") {
+      options.csv = true;
+    }
+  }
+  if (options.rate < 8000 || options.length == 0 || options.length > ring_capacity || options.hours <= 0.0) {
+    fprintf(stderr, "Invalid rate, length or duration.\n");
+    return 1;
+  }
+
+  simulator simulation(options);
+  simulation.print_header();
+  const auto begin = std::chrono::steady_clock::now();
+  simulation.run();
+  const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+
+  fprintf(options.csv ? stderr : stdout, "Simulated %.2f h in %.2f s: %lld underruns, %lld overflows.\n",
+          options.hours, elapsed, simulation.get_underruns(), simulation.get_overflows());
+  if (simulation.get_underruns() > options.max_underruns || simulation.get_overflows() > options.max_overflows) {
+    fprintf(stderr, "Exceeded limits: at most %lld underruns and %lld overflows are allowed.\n", options.max_underruns, options.max_overflows);
+    return 2;
+  }
+  return 0;
+}
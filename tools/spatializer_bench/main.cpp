@@ -0,0 +1,444 @@
+// UnityGfB^SpatializervOC̃R[obNvzXgB
+// AudioPlugin_LoopbackAudioSource.dllAudioPluginOculusSpatializer.dll(stub)𓯂tH_ɒuĎsB
+//
+// ł͋^^gBfoCXőꍇ--wasapitB
+//
+// SpatializerBench [--sources N] [--threads T] [--seconds S] [--samplerate R] [--length L] [--max-p99-us X] [--csv] [--wasapi] [--record out.wav] [--allocation-guard] [--migrate-interval S] [--endpoints N]
+//
+// --allocation-guardLOOPBACK_ALLOCATION_GUARD`ărhvOCŎgB
+// EH[Abvɘ^[vProcessCallbackŃq[vmۂΏIR[h3ŎsB
+//
+// --migrate-intervaltSbɊfoCX̐؂ւ͋[AŌGetStats̓e\B
+// ؂ւ̌Ԃmigration_gap_usAł̏Ԃmigration_build_time_usɏoB
+//
+// --endpointstƁANbN+/-100ppm炵^foCXNǉēɘ^A
+// ŌɊefoCX̃NbN␳ʂ\B
+#include "AudioPluginInterface.h"
+#include <windows.h>
+#include <mmsystem.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <memory>
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+
+#pragma comment(lib, "winmm")
+
+using namespace std::chrono;
+
+namespace
+{
+typedef void (*UnityPluginLoadFunc)(void*);
+typedef void (*UnityPluginUnloadFunc)();
+typedef void (*UseSyntheticCaptureFunc)(int);
+typedef int (*StartRecordingFunc)(const char*);
+typedef void (*StopRecordingFunc)();
+typedef long long (*GetRecordedFramesFunc)();
+typedef void (*ArmAllocationGuardFunc)(int);
+typedef long long (*GetAllocationViolationsFunc)();
+typedef void (*SimulateDeviceChangeFunc)();
+typedef int (*GetStatsFunc)(char*, int);
+typedef int (*AddCaptureEndpointFunc)(const char*, float);
+typedef float (*GetCaptureEndpointDriftFunc)(const char*);
+typedef int (*UnityGetAudioEffectDefinitionsFunc)(UnityAudioEffectDefinition*** descptr);
+
+// spatializer_plugin.cppParametersƍ킹
+const int loopback_enabled_parameter = 5;
+const int loopback_channel_parameter = 6;
+const int latency_parameter = 7;
+
+struct Options
+{
+  int sources = 32;
+  int threads = 4;
+  double seconds = 10.0;
+  int samplerate = 48000;
+  int length = 1024;
+  double max_p99_us = 0.0;
+  bool csv = false;
+  bool wasapi = false;
+  std::string record_path;
+  bool allocation_guard = false;
+  double migrate_interval = 0.0;
+  int endpoints = 0;
+};
+
+struct Source
+{
+  UnityAudioEffectState state;
+  UnityAudioSpatializerData spatializer_data;
+  std::vector<float> inbuffer;
+  std::vector<float> outbuffer;
+};
+
+struct Result
+{
+  std::vector<double> process_us;
+  std::vector<double> parameter_us;
+  size_t ticks = 0;
+  size_t late_ticks = 0;
+  double wall_seconds = 0.0;
+};
+
+double percentile(std::vector<double>& values, double p)
+{
+  if (values.empty()) {
+    return 0.0;
+  }
+  auto index = static_cast<size_t>(p / 100.0 * (values.size() - 1));
+  std::nth_element(values.begin(), values.begin() + index, values.end());
+  return values[index];
+}
+
+double mean(const std::vector<double>& values)
+{
+  if (values.empty()) {
+    return 0.0;
+  }
+  return std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+}
+
+Options parse_options(int argc, char** argv)
+{
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto next = [&]() { return (i + 1 < argc) ? argv[++i] : "0"; };
+    if (arg == "--sources") {
+      options.sources = atoi(next());
+    } else if (arg == "--threads") {
+      options.threads = atoi(next());
+    } else if (arg == "--seconds") {
+      options.seconds = atof(next());
+    } else if (arg == "--samplerate") {
+      options.samplerate = atoi(next());
+    } else if (arg == "--length") {
+      options.length = atoi(next());
+    } else if (arg == "--max-p99-us") {
+      options.max_p99_us = atof(next());
+    } else if (arg == "--csv") {
+      options.csv = true;
+    } else if (arg == "--wasapi") {
+      options.wasapi = true;
+    } else if (arg == "--record") {
+      options.record_path = next();
+    } else if (arg == "--allocation-guard") {
+      options.allocation_guard = true;
+    } else if (arg == "--migrate-interval") {
+      options.migrate_interval = atof(next());
+    } else if (arg == "--endpoints") {
+      options.endpoints = atoi(next());
+    }
+  }
+  options.sources = (std::max)(options.sources, 1);
+  options.threads = (std::max)((std::min)(options.threads, options.sources), 1);
+  return options;
+}
+
+// DSPXbhV~[gBS\[XDSP tickɏԂɏ
+void run_mixer_thread(
+  UnityAudioEffectDefinition* definition,
+  std::vector<std::unique_ptr<Source>>& sources,
+  size_t first,
+  size_t last,
+  const Options& options,
+  steady_clock::time_point start,
+  size_t num_ticks,
+  Result& result)
+{
+  const auto period = duration_cast<steady_clock::duration>(duration<double>((double)options.length / options.samplerate));
+  auto deadline = start;
+  for (size_t tick = 0; tick < num_ticks; ++tick) {
+    deadline += period;
+    for (size_t index = first; index < last; ++index) {
+      auto& source = *sources[index];
+      source.state.prevdsptick = source.state.currdsptick;
+      source.state.currdsptick += options.length;
+      const auto begin = steady_clock::now();
+      definition->process(&source.state, source.inbuffer.data(), source.outbuffer.data(), options.length, 2, 2);
+      const auto end = steady_clock::now();
+      result.process_us.push_back(duration<double, std::micro>(end - begin).count());
+    }
+    ++result.ticks;
+    if (steady_clock::now() > deadline) {
+      ++result.late_ticks;
+    } else {
+      std::this_thread::sleep_until(deadline);
+    }
+  }
+}
+
+Result run(UnityAudioEffectDefinition* definition, std::vector<std::unique_ptr<Source>>& sources, const Options& options, int num_threads)
+{
+  const auto num_ticks = static_cast<size_t>(options.seconds * options.samplerate / options.length);
+  std::vector<Result> thread_results(num_threads);
+  for (auto& thread_result : thread_results) {
+    thread_result.process_us.reserve(num_ticks * sources.size() / num_threads + num_ticks);
+  }
+
+  // CXbhSetSpatializerFloatsė
+  std::atomic<bool> running(true);
+  Result parameter_result;
+  parameter_result.parameter_us.reserve(static_cast<size_t>(options.seconds * 1000.0 * 2.0));
+  std::thread parameter_thread([&]() {
+    size_t index = 0;
+    while (running) {
+      auto& source = *sources[index % sources.size()];
+      float value;
+      const auto begin = steady_clock::now();
+      definition->setfloatparameter(&source.state, loopback_enabled_parameter, 1.0f);
+      definition->getfloatparameter(&source.state, loopback_channel_parameter, &value, nullptr);
+      const auto end = steady_clock::now();
+      parameter_result.parameter_us.push_back(duration<double, std::micro>(end - begin).count());
+      ++index;
+      std::this_thread::sleep_for(milliseconds(1));
+    }
+  });
+
+  const auto start = steady_clock::now();
+  std::vector<std::thread> mixer_threads;
+  const size_t per_thread = (sources.size() + num_threads - 1) / num_threads;
+  for (int thread_index = 0; thread_index < num_threads; ++thread_index) {
+    const size_t first = (std::min)(sources.size(), thread_index * per_thread);
+    const size_t last = (std::min)(sources.size(), first + per_thread);
+    mixer_threads.emplace_back(run_mixer_thread, definition, std::ref(sources), first, last, std::cref(options), start, num_ticks, std::ref(thread_results[thread_index]));
+  }
+  for (auto& thread : mixer_threads) {
+    thread.join();
+  }
+  running = false;
+  parameter_thread.join();
+
+  Result result;
+  result.wall_seconds = duration<double>(steady_clock::now() - start).count();
+  for (auto& thread_result : thread_results) {
+    result.process_us.insert(result.process_us.end(), thread_result.process_us.begin(), thread_result.process_us.end());
+    result.ticks += thread_result.ticks;
+    result.late_ticks += thread_result.late_ticks;
+  }
+  result.parameter_us = std::move(parameter_result.parameter_us);
+  return result;
+}
+
+void report(const char* label, Result& result, const Options& options, int num_threads, double contention)
+{
+  const double tick_us = 1.0e6 * options.length / options.samplerate;
+  const double process_mean = mean(result.process_us);
+  const double sources_per_core = process_mean > 0.0 ? tick_us / process_mean : 0.0;
+  const double p50 = percentile(result.process_us, 50.0);
+  const double p90 = percentile(result.process_us, 90.0);
+  const double p99 = percentile(result.process_us, 99.0);
+  const double p999 = percentile(result.process_us, 99.9);
+  const double max = percentile(result.process_us, 100.0);
+  const double parameter_p99 = percentile(result.parameter_us, 99.0);
+
+  if (options.csv) {
+    printf("%s,%d,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%.3f,%.3f,%.1f,%zu,%zu,%.3f,%.3f\n",
+           label, options.sources, num_threads, options.samplerate, options.length,
+           process_mean, p50, p90, p99, p999, max, sources_per_core,
+           result.ticks, result.late_ticks, parameter_p99, contention);
+  } else {
+    printf("[%s] sources=%d threads=%d samplerate=%d length=%d\n", label, options.sources, num_threads, options.samplerate, options.length);
+    printf("  ProcessCallback us: mean=%.3f p50=%.3f p90=%.3f p99=%.3f p99.9=%.3f max=%.3f\n", process_mean, p50, p90, p99, p999, max);
+    printf("  throughput: %.1f sources/core (tick budget %.1f us)\n", sources_per_core, tick_us);
+    printf("  late ticks: %zu / %zu\n", result.late_ticks, result.ticks);
+    printf("  Set/GetFloatParameter p99 us: %.3f\n", parameter_p99);
+    printf("  contention (mean slowdown vs 1 thread): %.3f\n", contention);
+  }
+}
+}
+
+int main(int argc, char** argv)
+{
+  const auto options = parse_options(argc, argv);
+
+  auto plugin = LoadLibrary(L"AudioPlugin_LoopbackAudioSource");
+  if (!plugin) {
+    fprintf(stderr, "Failed to load AudioPlugin_LoopbackAudioSource.\n");
+    return 1;
+  }
+  auto plugin_load = reinterpret_cast<UnityPluginLoadFunc>(GetProcAddress(plugin, "UnityPluginLoad"));
+  auto plugin_unload = reinterpret_cast<UnityPluginUnloadFunc>(GetProcAddress(plugin, "UnityPluginUnload"));
+  auto get_definitions = reinterpret_cast<UnityGetAudioEffectDefinitionsFunc>(GetProcAddress(plugin, "UnityGetAudioEffectDefinitions"));
+  auto use_synthetic_capture = reinterpret_cast<UseSyntheticCaptureFunc>(GetProcAddress(plugin, "UseSyntheticCapture"));
+  auto start_recording = reinterpret_cast<StartRecordingFunc>(GetProcAddress(plugin, "StartRecording"));
+  auto stop_recording = reinterpret_cast<StopRecordingFunc>(GetProcAddress(plugin, "StopRecording"));
+  auto get_recorded_frames = reinterpret_cast<GetRecordedFramesFunc>(GetProcAddress(plugin, "GetRecordedFrames"));
+  auto arm_allocation_guard = reinterpret_cast<ArmAllocationGuardFunc>(GetProcAddress(plugin, "ArmAllocationGuard"));
+  auto get_allocation_violations = reinterpret_cast<GetAllocationViolationsFunc>(GetProcAddress(plugin, "GetAllocationViolations"));
+  auto simulate_device_change = reinterpret_cast<SimulateDeviceChangeFunc>(GetProcAddress(plugin, "SimulateDeviceChange"));
+  auto get_stats = reinterpret_cast<GetStatsFunc>(GetProcAddress(plugin, "GetStats"));
+  auto add_capture_endpoint = reinterpret_cast<AddCaptureEndpointFunc>(GetProcAddress(plugin, "AddCaptureEndpoint"));
+  auto get_capture_endpoint_drift = reinterpret_cast<GetCaptureEndpointDriftFunc>(GetProcAddress(plugin, "GetCaptureEndpointDrift"));
+  if (!plugin_load || !plugin_unload || !get_definitions || !use_synthetic_capture ||
+      !start_recording || !stop_recording || !get_recorded_frames ||
+      !arm_allocation_guard || !get_allocation_violations ||
+      !simulate_device_change || !get_stats ||
+      !add_capture_endpoint || !get_capture_endpoint_drift) {
+    fprintf(stderr, "Plugin entry points are missing.\n");
+    return 1;
+  }
+
+  CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+  timeBeginPeriod(1);
+  plugin_load(nullptr);
+  use_synthetic_capture(options.wasapi ? 0 : 1);
+
+  UnityAudioEffectDefinition** definitions = nullptr;
+  if (get_definitions(&definitions) < 1) {
+    fprintf(stderr, "Plugin returned no effect definitions.\n");
+    return 1;
+  }
+  auto definition = definitions[0];
+
+  static int host_internal;
+  std::vector<std::unique_ptr<Source>> sources;
+  for (int index = 0; index < options.sources; ++index) {
+    std::unique_ptr<Source> source(new Source);
+    ZeroMemory(&source->state, sizeof(source->state));
+    ZeroMemory(&source->spatializer_data, sizeof(source->spatializer_data));
+    source->spatializer_data.listenermatrix[0] = source->spatializer_data.listenermatrix[5] = 1.0f;
+    source->spatializer_data.listenermatrix[10] = source->spatializer_data.listenermatrix[15] = 1.0f;
+    source->spatializer_data.sourcematrix[0] = source->spatializer_data.sourcematrix[5] = 1.0f;
+    source->spatializer_data.sourcematrix[10] = source->spatializer_data.sourcematrix[15] = 1.0f;
+    source->spatializer_data.sourcematrix[12] = static_cast<float>(index % 7) - 3.0f;
+    source->spatializer_data.sourcematrix[14] = 2.0f;
+    source->spatializer_data.spatialblend = 1.0f;
+    source->state.structsize = sizeof(UnityAudioEffectState);
+    source->state.samplerate = options.samplerate;
+    source->state.flags = UnityAudioEffectStateFlags_IsPlaying;
+    source->state.internal = &host_internal;
+    source->state.spatializerdata = &source->spatializer_data;
+    source->state.dspbuffersize = options.length;
+    source->state.hostapiversion = UNITY_AUDIO_PLUGIN_API_VERSION;
+    source->inbuffer.assign(options.length * 2, 0.0f);
+    source->outbuffer.assign(options.length * 2, 0.0f);
+
+    if (definition->create(&source->state) != UNITY_AUDIODSP_OK) {
+      fprintf(stderr, "CreateCallback failed for source %d.\n", index);
+      return 1;
+    }
+    definition->setfloatparameter(&source->state, loopback_enabled_parameter, 1.0f);
+    definition->setfloatparameter(&source->state, loopback_channel_parameter, static_cast<float>(index % 2));
+    sources.push_back(std::move(source));
+  }
+
+  float latency_ms = 0.0f;
+  definition->getfloatparameter(&sources[0]->state, latency_parameter, &latency_ms, nullptr);
+  if (!options.csv) {
+    printf("rate conversion latency: %.3f ms\n", latency_ms);
+  }
+
+  // ^^bv𓯎ɓAvւ̉eƏoʂmF
+  if (!options.record_path.empty() && !start_recording(options.record_path.c_str())) {
+    fprintf(stderr, "Failed to start recording to %s.\n", options.record_path.c_str());
+    return 1;
+  }
+
+  if (options.allocation_guard) {
+    // ̊mۂς܂ĂĎn߂
+    auto warmup = options;
+    warmup.seconds = 0.5;
+    run(definition, sources, warmup, 1);
+    arm_allocation_guard(1);
+  }
+
+  // ͘^XbhŐiނ̂ŁAǉł悤ɂȂ܂ő҂
+  std::vector<std::string> endpoint_ids;
+  for (int index = 0; index < options.endpoints; ++index) {
+    const int ppm = (index % 2 == 0 ? 1 : -1) * 100 * (index / 2 + 1);
+    endpoint_ids.push_back("synthetic:" + std::to_string(ppm));
+    const auto give_up = steady_clock::now() + seconds(2);
+    while (!add_capture_endpoint(endpoint_ids.back().c_str(), 0.5f)) {
+      if (steady_clock::now() > give_up) {
+        fprintf(stderr, "Failed to add capture endpoint %s.\n", endpoint_ids.back().c_str());
+        return 1;
+      }
+      std::this_thread::sleep_for(milliseconds(10));
+    }
+  }
+
+  // vɊfoCX̐؂ւJԂAProcessCallbackւ̉e
+  std::atomic<bool> migrating(options.migrate_interval > 0.0);
+  std::thread migrator;
+  if (migrating) {
+    migrator = std::thread([&]() {
+      const auto interval = duration_cast<steady_clock::duration>(duration<double>(options.migrate_interval));
+      auto next_change = steady_clock::now() + interval;
+      while (migrating) {
+        std::this_thread::sleep_for(milliseconds(10));
+        if (steady_clock::now() >= next_change) {
+          simulate_device_change();
+          next_change += interval;
+        }
+      }
+    });
+  }
+
+  if (options.csv) {
+    printf("label,sources,threads,samplerate,length,mean_us,p50_us,p90_us,p99_us,p999_us,max_us,sources_per_core,ticks,late_ticks,parameter_p99_us,contention\n");
+  }
+  auto baseline = run(definition, sources, options, 1);
+  const double baseline_mean = mean(baseline.process_us);
+  report("1-thread", baseline, options, 1, 1.0);
+
+  int exit_code = 0;
+  if (options.threads > 1) {
+    auto parallel = run(definition, sources, options, options.threads);
+    const double contention = baseline_mean > 0.0 ? mean(parallel.process_us) / baseline_mean : 0.0;
+    report("parallel", parallel, options, options.threads, contention);
+    if (options.max_p99_us > 0.0 && percentile(parallel.process_us, 99.0) > options.max_p99_us) {
+      exit_code = 2;
+    }
+  }
+  if (options.max_p99_us > 0.0 && percentile(baseline.process_us, 99.0) > options.max_p99_us) {
+    exit_code = 2;
+  }
+
+  if (migrator.joinable()) {
+    migrating = false;
+    migrator.join();
+    std::vector<char> stats(get_stats(nullptr, 0) + 1);
+    get_stats(stats.data(), static_cast<int>(stats.size()));
+    printf("stats: %s\n", stats.data());
+  }
+
+  for (const auto& id : endpoint_ids) {
+    printf("endpoint %s: drift correction %.1f ppm\n", id.c_str(), get_capture_endpoint_drift(id.c_str()));
+  }
+
+  if (options.allocation_guard) {
+    arm_allocation_guard(0);
+    const long long violations = get_allocation_violations();
+    if (violations < 0) {
+      fprintf(stderr, "Plugin was built without LOOPBACK_ALLOCATION_GUARD.\n");
+      exit_code = exit_code == 0 ? 1 : exit_code;
+    } else {
+      printf("allocations on capture/audio threads after warm-up: %lld\n", violations);
+      if (violations > 0) {
+        exit_code = 3;
+      }
+    }
+  }
+
+  if (!options.record_path.empty()) {
+    stop_recording();
+    if (!options.csv) {
+      printf("recorded frames: %lld\n", get_recorded_frames());
+    }
+  }
+
+  for (auto& source : sources) {
+    definition->release(&source->state);
+  }
+  plugin_unload();
+  timeEndPeriod(1);
+  FreeLibrary(plugin);
+  CoUninitialize();
+  return exit_code;
+}
@@ -0,0 +1,125 @@
+// x`}[NpOculus SpatializerpiB
+// AudioPluginOculusSpatializer.dllƓOŃrhASpatializerBenchׂ̗ɒuĎgB
+#include "AudioPluginInterface.h"
+#include <windows.h>
+#include <cmath>
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+const int num_parameters = 5;
+
+struct StubEffectData
+{
+  float parameters[num_parameters];
+};
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK DistanceAttenuationCallback(UnityAudioEffectState* state, float distanceIn, float attenuationIn, float* attenuationOut)
+{
+  *attenuationOut = 1.0f / (std::max)(1.0f, distanceIn);
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK CreateCallback(UnityAudioEffectState* state)
+{
+  auto data = new StubEffectData;
+  std::fill(std::begin(data->parameters), std::end(data->parameters), 0.0f);
+  state->effectdata = data;
+  if (state->spatializerdata) {
+    state->spatializerdata->distanceattenuationcallback = DistanceAttenuationCallback;
+  }
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ReleaseCallback(UnityAudioEffectState* state)
+{
+  delete state->GetEffectData<StubEffectData>();
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK ProcessCallback(UnityAudioEffectState* state, float* inbuffer, float* outbuffer, unsigned int length, int inchannels, int outchannels)
+{
+  // {ɋ߂ׂɂȂ悤A\[Xʒu瓙p[pvZĊ|
+  float pan = 0.0f;
+  if (state->spatializerdata) {
+    const float* m = state->spatializerdata->sourcematrix;
+    const float x = m[12];
+    const float z = m[14];
+    pan = atan2f(x, (std::max)(fabsf(z), 1.0e-3f)) / 3.14159265f + 0.5f;
+  }
+  const float left_gain = cosf(pan * 1.5707963f);
+  const float right_gain = sinf(pan * 1.5707963f);
+  for (unsigned int frame = 0; frame < length; ++frame) {
+    const float mono = inbuffer[frame * inchannels];
+    outbuffer[frame * outchannels] = mono * left_gain;
+    outbuffer[frame * outchannels + 1] = mono * right_gain;
+  }
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK SetFloatParameterCallback(UnityAudioEffectState* state, int index, float value)
+{
+  if (index < 0 || index >= num_parameters) {
+    return UNITY_AUDIODSP_ERR_UNSUPPORTED;
+  }
+  state->GetEffectData<StubEffectData>()->parameters[index] = value;
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatParameterCallback(UnityAudioEffectState* state, int index, float* value, char *valuestr)
+{
+  if (index < 0 || index >= num_parameters) {
+    return UNITY_AUDIODSP_ERR_UNSUPPORTED;
+  }
+  if (value != NULL) {
+    *value = state->GetEffectData<StubEffectData>()->parameters[index];
+  }
+  if (valuestr != NULL) {
+    valuestr[0] = 0;
+  }
+  return UNITY_AUDIODSP_OK;
+}
+
+UNITY_AUDIODSP_RESULT UNITY_AUDIODSP_CALLBACK GetFloatBufferCallback(UnityAudioEffectState* state, const char* name, float* buffer, int numsamples)
+{
+  return UNITY_AUDIODSP_OK;
+}
+}
+
+extern "C" UNITY_AUDIODSP_EXPORT_API int UnityGetAudioEffectDefinitions(UnityAudioEffectDefinition*** definitionptr)
+{
+  static UnityAudioEffectDefinition definition;
+  static UnityAudioEffectDefinition* definition_array[1];
+  static UnityAudioParameterDefinition paramdefs[num_parameters];
+  ZeroMemory(&definition, sizeof(UnityAudioEffectDefinition));
+  ZeroMemory(paramdefs, sizeof(paramdefs));
+
+  strcpy_s(definition.name, "Stub Oculus Spatializer");
+  definition.structsize = sizeof(UnityAudioEffectDefinition);
+  definition.paramstructsize = sizeof(UnityAudioParameterDefinition);
+  definition.apiversion = UNITY_AUDIO_PLUGIN_API_VERSION;
+  definition.pluginversion = 0x010000;
+  definition.create = CreateCallback;
+  definition.release = ReleaseCallback;
+  definition.process = ProcessCallback;
+  definition.setfloatparameter = SetFloatParameterCallback;
+  definition.getfloatparameter = GetFloatParameterCallback;
+  definition.getfloatbuffer = GetFloatBufferCallback;
+  definition.flags |= UnityAudioEffectDefinitionFlags_IsSpatializer;
+
+  for (int index = 0; index < num_parameters; ++index) {
+    paramdefs[index].name[0] = 'P';
+    paramdefs[index].name[1] = static_cast<char>('0' + index);
+    paramdefs[index].min = 0.0f;
+    paramdefs[index].max = 1.0f;
+    paramdefs[index].displayscale = 1.0f;
+    paramdefs[index].displayexponent = 1.0f;
+  }
+  definition.paramdefs = paramdefs;
+  definition.numparameters = num_parameters;
+
+  definition_array[0] = &definition;
+  *definitionptr = definition_array;
+  return 1;
+}